@@ -0,0 +1,76 @@
+#!/bin/sh
+# Builds the interpreter with several GC pacing policies and times every benchmark script with each of them. Every
+# policy is a growth factor, a minimum and maximum heap threshold in kilobytes (0 means no maximum), and a CPU target
+# in percent (0 means the growth factor is fixed). These are the defaults of 'risa_vm_set_gc_pacing', set with
+# RISA_GC_GROWTH_FACTOR, RISA_GC_MIN_THRESHOLD, RISA_GC_MAX_THRESHOLD and RISA_GC_CPU_TARGET. Extra compiler flags,
+# such as -DRISA_GC_GENERATIONAL, can be passed in CFLAGS to sweep the pacing of another collector.
+#
+# Usage: bench/pacing.sh [runs]
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=$(mktemp -d)
+RUNS=${1:-3}
+
+trap 'rm -rf "$BUILD"' EXIT
+
+# growth min max cpu
+POLICIES="
+2.0 64 0 0
+1.5 64 0 0
+4.0 64 0 0
+2.0 1024 0 0
+2.0 64 16384 0
+2.0 64 0 5
+2.0 64 0 25
+2.0 1024 65536 10
+"
+
+build() {
+    cmake -S "$ROOT" -B "$BUILD/$1" -DCMAKE_BUILD_TYPE=Release -DCMAKE_C_FLAGS="$CFLAGS $2" > /dev/null
+    cmake --build "$BUILD/$1" -j > /dev/null 2>&1
+}
+
+measure() {
+    best=""
+
+    for i in $(seq "$RUNS"); do
+        start=$(date +%s%N)
+        "$1" "$2" > /dev/null
+        end=$(date +%s%N)
+
+        elapsed=$(( (end - start) / 1000000 ))
+
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+
+    echo "$best"
+}
+
+echo "$POLICIES" | while read -r growth min max cpu; do
+    [ -z "$growth" ] && continue
+
+    build "$growth-$min-$max-$cpu" "-DRISA_GC_GROWTH_FACTOR=$growth -DRISA_GC_MIN_THRESHOLD=$((min * 1024)) -DRISA_GC_MAX_THRESHOLD=$((max * 1024)) -DRISA_GC_CPU_TARGET=$cpu"
+done
+
+# The columns are named growth-min-max-cpu, and hold the best time of every script in milliseconds.
+printf "%-24s" "script"
+
+for policy in $(echo "$POLICIES" | tr ' ' '-'); do
+    printf " %20s" "$policy"
+done
+
+printf "\n"
+
+for script in "$ROOT"/bench/*.risa; do
+    printf "%-24s" "$(basename "$script")"
+
+    for policy in $(echo "$POLICIES" | tr ' ' '-'); do
+        printf " %20s" "$(measure "$BUILD/$policy/risa" "$script")"
+    done
+
+    printf "\n"
+done
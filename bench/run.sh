@@ -0,0 +1,78 @@
+#!/bin/sh
+# Builds the interpreter with both dispatch modes and times every benchmark script. The scripts are also compiled
+# with and without the optimizer ('risa -c' and 'risa -c -O'), and the compiled bytecode is timed on the threaded build.
+# Use 'risa -d -O <script>' to see what the optimizer did. The 'jit' column is the threaded build with the baseline JIT
+# (RISA_VM_JIT, x86-64 Linux only), which should print the same output as the interpreter. The 'nan-box' column uses
+# 8-byte NaN-boxed values (RISA_VALUE_NAN_BOXING), the 'gen-gc' column the generational collector (RISA_GC_GENERATIONAL),
+# the 'inc-gc' column the incremental collector (RISA_GC_INCREMENTAL), the 'par-gc' column parallel marking
+# (RISA_GC_PARALLEL, one thread per core), the 'lazy-sweep' column lazy sweeping (RISA_GC_LAZY_SWEEP), and the 'slabs'
+# column the per-VM slab allocator (RISA_VM_SLABS). heap.risa keeps a large heap alive and collects it repeatedly, and
+# strings.risa churns through short-lived strings. reflect.risa reads a global through 'reflect()', whose object has more
+# properties than a shape can hold, so it ends up in dictionary mode. closures.risa calls lambdas whose captures use the
+# registers directly ('local direct' in 'risa -d'), through a local and through 'foreach', and passes one to a script
+# function, which moves its captures to the heap.
+#
+# Usage: bench/run.sh [runs]
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=$(mktemp -d)
+RUNS=${1:-3}
+
+trap 'rm -rf "$BUILD"' EXIT
+
+build() {
+    cmake -S "$ROOT" -B "$BUILD/$1" -DCMAKE_BUILD_TYPE=Release -DCMAKE_C_FLAGS="$2" > /dev/null
+    cmake --build "$BUILD/$1" -j > /dev/null 2>&1
+}
+
+measure() {
+    best=""
+
+    for i in $(seq "$RUNS"); do
+        start=$(date +%s%N)
+        "$1" "$2" > /dev/null
+        end=$(date +%s%N)
+
+        elapsed=$(( (end - start) / 1000000 ))
+
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+
+    echo "$best"
+}
+
+build switch "-DRISA_VM_SWITCH_DISPATCH"
+build threaded ""
+build jit "-DRISA_VM_JIT"
+build nanbox "-DRISA_VALUE_NAN_BOXING"
+build gen "-DRISA_GC_GENERATIONAL"
+build inc "-DRISA_GC_INCREMENTAL"
+build par "-DRISA_GC_PARALLEL"
+build lazy "-DRISA_GC_LAZY_SWEEP"
+build slabs "-DRISA_VM_SLABS"
+
+printf "%-24s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s\n" "script" "switch (ms)" "threaded (ms)" "-c (ms)" "-c -O (ms)" "jit (ms)" "nan-box (ms)" "gen-gc (ms)" "inc-gc (ms)" "par-gc (ms)" "lazy-sweep (ms)" "slabs (ms)"
+
+for script in "$ROOT"/bench/*.risa; do
+    name=$(basename "$script" .risa)
+
+    "$BUILD/threaded/risa" -c "$script" "$BUILD/$name.rbc"
+    "$BUILD/threaded/risa" -c -O "$script" "$BUILD/$name.O.rbc"
+
+    printf "%-24s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s\n" "$name.risa" \
+        "$(measure "$BUILD/switch/risa" "$script")" \
+        "$(measure "$BUILD/threaded/risa" "$script")" \
+        "$(measure "$BUILD/threaded/risa" "$BUILD/$name.rbc")" \
+        "$(measure "$BUILD/threaded/risa" "$BUILD/$name.O.rbc")" \
+        "$(measure "$BUILD/jit/risa" "$script")" \
+        "$(measure "$BUILD/nanbox/risa" "$script")" \
+        "$(measure "$BUILD/gen/risa" "$script")" \
+        "$(measure "$BUILD/inc/risa" "$script")" \
+        "$(measure "$BUILD/par/risa" "$script")" \
+        "$(measure "$BUILD/lazy/risa" "$script")" \
+        "$(measure "$BUILD/slabs/risa" "$script")"
+done
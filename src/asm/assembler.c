@@ -270,6 +270,7 @@ static void risa_assembler_assemble_code_line(RisaAssembler* assembler) {
             risa_assembler_assemble_jump(assembler);
             break;
         case RISA_ASM_TOKEN_CALL:
+        case RISA_ASM_TOKEN_TCALL:
             risa_assembler_assemble_call(assembler);
             break;
         case RISA_ASM_TOKEN_RET:
@@ -890,6 +891,8 @@ static void risa_assembler_assemble_consumer(RisaAssembler* assembler) {
 }
 
 static void risa_assembler_assemble_call(RisaAssembler* assembler) {
+    uint8_t op = risa_asm_token_to_opcode(assembler->parser->current.type);
+
     risa_asm_parser_advance(assembler->parser);
 
     if(assembler->parser->current.type != RISA_ASM_TOKEN_REGISTER) {
@@ -921,7 +924,11 @@ static void risa_assembler_assemble_call(RisaAssembler* assembler) {
 
     risa_asm_parser_advance(assembler->parser);
 
-    risa_assembler_emit_byte(assembler, RISA_OP_CALL);
+    // The arguments are placed in the registers after the callee.
+    if(dest + left + 1 > assembler->cluster.registerCount)
+        assembler->cluster.registerCount = (uint8_t) (dest + left + 1 > RISA_TODLR_REGISTER_COUNT ? RISA_TODLR_REGISTER_COUNT : dest + left + 1);
+
+    risa_assembler_emit_byte(assembler, op);
     risa_assembler_emit_byte(assembler, dest);
     risa_assembler_emit_byte(assembler, (uint8_t) left);
     risa_assembler_emit_byte(assembler, 0);
@@ -1277,6 +1284,9 @@ static uint8_t risa_assembler_read_reg(RisaAssembler* assembler) {
         return RISA_TODLR_REGISTER_NULL;
     }
 
+    if(num + 1 > assembler->cluster.registerCount)
+        assembler->cluster.registerCount = (uint8_t) (num + 1);
+
     return (uint8_t) num;
 }
 
@@ -1301,7 +1311,7 @@ static uint16_t risa_assembler_read_byte(RisaAssembler* assembler) {
         } else {
             RisaValue* value = &assembler->cluster.constants.values[index];
 
-            if(value->type != RISA_VAL_BYTE) {
+            if(!risa_value_is_byte(*value)) {
                 risa_asm_parser_error_at_current(assembler->parser, "Expected byte");
                 return UINT16_MAX;
             }
@@ -1330,7 +1340,7 @@ static uint16_t risa_assembler_read_int(RisaAssembler* assembler) {
         } else {
             RisaValue* value = &assembler->cluster.constants.values[index];
 
-            if(value->type != RISA_VAL_INT) {
+            if(!risa_value_is_int(*value)) {
                 risa_asm_parser_error_at_current(assembler->parser, "Expected int");
                 return UINT16_MAX;
             }
@@ -1346,6 +1356,14 @@ static uint16_t risa_assembler_read_int(RisaAssembler* assembler) {
         return UINT16_MAX;
     }
 
+    #ifdef RISA_VALUE_NAN_BOXING
+        // Boxed ints only have 48 bits.
+        if(num < RISA_VALUE_NAN_INT_MIN || num > RISA_VALUE_NAN_INT_MAX) {
+            risa_asm_parser_error_at_current(assembler->parser, "Number is too large for type 'int'");
+            return UINT16_MAX;
+        }
+    #endif
+
     return risa_assembler_create_constant(assembler, risa_value_from_int(num));
 }
 
@@ -1359,7 +1377,7 @@ static uint16_t risa_assembler_read_float(RisaAssembler* assembler) {
         } else {
             RisaValue* value = &assembler->cluster.constants.values[index];
 
-            if(value->type != RISA_VAL_FLOAT) {
+            if(!risa_value_is_float(*value)) {
                 risa_asm_parser_error_at_current(assembler->parser, "Expected float");
                 return UINT16_MAX;
             }
@@ -1524,7 +1542,7 @@ static int64_t risa_assembler_read_number(RisaAssembler* assembler) {
         } else {
             RisaValue* value = &assembler->cluster.constants.values[index];
 
-            if(value->type == RISA_VAL_INT)
+            if(risa_value_is_int(*value))
                 return risa_value_as_int(*value);
             return risa_value_as_byte(*value);
         }
@@ -27,6 +27,7 @@ static void risa_disassembler_disassemble_array_push_instruction    (RisaDisasse
 static void risa_disassembler_disassemble_array_length_instruction  (RisaDisassembler*, const char*);
 static void risa_disassembler_disassemble_get_instruction           (RisaDisassembler*, const char*, uint8_t);
 static void risa_disassembler_disassemble_set_instruction           (RisaDisassembler*, const char*, uint8_t);
+static void risa_disassembler_disassemble_block_header             (RisaDisassembler*, RisaClusterBlock*, uint32_t);
 static void risa_disassembler_disassembler_process_instruction      (RisaDisassembler*);
 
 RisaDisassembler* risa_disassembler_create() {
@@ -41,20 +42,40 @@ void risa_disassembler_init(RisaDisassembler* disassembler) {
     risa_io_init(&disassembler->io);
     disassembler->cluster = NULL;
     disassembler->offset = 0;
+    disassembler->blocks = false;
 }
 
 void risa_disassembler_load(RisaDisassembler* disassembler, RisaCluster* cluster) {
     disassembler->cluster = cluster;
 }
 
+void risa_disassembler_blocks(RisaDisassembler* disassembler, bool blocks) {
+    disassembler->blocks = blocks;
+}
+
 void risa_disassembler_run(RisaDisassembler* disassembler) {
     if(disassembler->cluster != NULL) {
         RISA_OUT(disassembler->io, "\nOFFS INDX OP\n");
 
+        RisaClusterBlock* blocks = NULL;
+        uint32_t blockCount = 0;
+        uint32_t block = 0;
+
+        if(disassembler->blocks)
+            blocks = risa_cluster_get_blocks(disassembler->cluster, &blockCount);
+
         while(disassembler->offset < disassembler->cluster->size) {
+            if(block < blockCount && blocks[block].start == disassembler->offset) {
+                risa_disassembler_disassemble_block_header(disassembler, blocks, block);
+                ++block;
+            }
+
             risa_disassembler_disassembler_process_instruction(disassembler);
         }
 
+        if(blocks != NULL)
+            RISA_MEM_FREE(blocks);
+
         // Decompile all of the functions contained in the cluster.
         for(size_t i = 0; i < disassembler->cluster->constants.size; ++i) {
             RisaDenseFunction* function;
@@ -70,6 +91,7 @@ void risa_disassembler_run(RisaDisassembler* disassembler) {
             RisaDisassembler disasm;
             risa_disassembler_init(&disasm);
             risa_io_clone(&disasm.io, &disassembler->io);
+            risa_disassembler_blocks(&disasm, disassembler->blocks);
 
             risa_disassembler_load(&disasm, &function->cluster);
             risa_disassembler_run(&disasm);
@@ -91,6 +113,18 @@ void risa_disassembler_free(RisaDisassembler* disassembler) {
     RISA_MEM_FREE(disassembler);
 }
 
+static void risa_disassembler_disassemble_block_header(RisaDisassembler* disassembler, RisaClusterBlock* blocks, uint32_t block) {
+    RISA_OUT(disassembler->io, "B%u", block);
+
+    for(uint8_t i = 0; i < 2; ++i)
+        if(blocks[block].successors[i] != UINT32_MAX)
+            RISA_OUT(disassembler->io, i == 0 ? " -> B%u" : ", B%u", blocks[block].successors[i]);
+
+    if(blocks[block].idom == UINT32_MAX)
+        RISA_OUT(disassembler->io, " (unreachable)\n");
+    else RISA_OUT(disassembler->io, " (idom B%u)\n", blocks[block].idom);
+}
+
 static void risa_disassembler_disassembler_process_instruction(RisaDisassembler* disassembler) {
     RISA_OUT(disassembler->io, "%04u %4u ", RISA_DISASM_OFFSET, RISA_DISASM_CLUSTER->indices[RISA_DISASM_OFFSET]);
 
@@ -240,6 +274,9 @@ static void risa_disassembler_disassembler_process_instruction(RisaDisassembler*
         case RISA_OP_CALL:
             risa_disassembler_disassemble_call_instruction(disassembler, "CALL");
             break;
+        case RISA_OP_TCALL:
+            risa_disassembler_disassemble_call_instruction(disassembler, "TCALL");
+            break;
         case RISA_OP_RET:
             risa_disassembler_disassemble_byte_instruction(disassembler, "RET");
             break;
@@ -249,6 +286,42 @@ static void risa_disassembler_disassembler_process_instruction(RisaDisassembler*
         case RISA_OP_DIS:
             risa_disassembler_disassemble_byte_instruction(disassembler, "DIS");
             break;
+        case RISA_OP_ADD_INT_INT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "ADD_INT_INT", types);
+            break;
+        case RISA_OP_SUB_INT_INT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "SUB_INT_INT", types);
+            break;
+        case RISA_OP_MUL_INT_INT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "MUL_INT_INT", types);
+            break;
+        case RISA_OP_LT_INT_INT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "LT_INT_INT", types);
+            break;
+        case RISA_OP_LTE_INT_INT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "LTE_INT_INT", types);
+            break;
+        case RISA_OP_ADD_FLOAT_FLOAT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "ADD_FLOAT_FLOAT", types);
+            break;
+        case RISA_OP_SUB_FLOAT_FLOAT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "SUB_FLOAT_FLOAT", types);
+            break;
+        case RISA_OP_MUL_FLOAT_FLOAT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "MUL_FLOAT_FLOAT", types);
+            break;
+        case RISA_OP_LT_FLOAT_FLOAT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "LT_FLOAT_FLOAT", types);
+            break;
+        case RISA_OP_LTE_FLOAT_FLOAT:
+            risa_disassembler_disassemble_binary_instruction(disassembler, "LTE_FLOAT_FLOAT", types);
+            break;
+        case RISA_OP_GGLOB_SLOT:
+            risa_disassembler_disassemble_global_get_instruction(disassembler, "GGLOB_SLOT");
+            break;
+        case RISA_OP_SGLOB_SLOT:
+            risa_disassembler_disassemble_global_set_instruction(disassembler, "SGLOB_SLOT", types);
+            break;
         default:
             RISA_OUT(disassembler->io, "<UNK>");
     }
@@ -305,9 +378,10 @@ void risa_disassembler_disassemble_mov_instruction(RisaDisassembler* disassemble
 }
 
 void risa_disassembler_disassemble_call_instruction(RisaDisassembler* disassembler, const char* name) {
-    RISA_OUT(disassembler->io, "%-16s %4d %4d\n", name,
+    RISA_OUT(disassembler->io, "%-16s %4d %4d%s\n", name,
              RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 1],
-             RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 2]);
+             RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 2],
+             (RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 3] == 0 ? "" : "    direct"));
 }
 
 void risa_disassembler_disassemble_global_define_instruction(RisaDisassembler* disassembler, const char* name, uint8_t types) {
@@ -346,7 +420,8 @@ void risa_disassembler_disassemble_upvalue_instruction(RisaDisassembler* disasse
     RISA_OUT(disassembler->io, "%-16s %4d %4d    %s\n", name,
              RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 1],
              RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 2],
-             RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 2] == 0 ? "upvalue" : "local");
+             RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 2] == 0 ? "upvalue" :
+             (RISA_DISASM_CLUSTER->bytecode[RISA_DISASM_OFFSET + 3] == 0 ? "local" : "local direct"));
 }
 
 void risa_disassembler_disassemble_upvalue_get_instruction(RisaDisassembler* disassembler, const char* name) {
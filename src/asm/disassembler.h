@@ -10,11 +10,14 @@ typedef struct {
     RisaIO io;
     RisaCluster* cluster;
     uint32_t offset;
+
+    bool blocks; // Whether or not to show the basic blocks and their dominators.
 } RisaDisassembler;
 
 RISA_API RisaDisassembler* risa_disassembler_create ();
 RISA_API void              risa_disassembler_init   (RisaDisassembler* disassembler);
 RISA_API void              risa_disassembler_load   (RisaDisassembler* disassembler, RisaCluster* cluster);
+RISA_API void              risa_disassembler_blocks (RisaDisassembler* disassembler, bool blocks);
 RISA_API void              risa_disassembler_run    (RisaDisassembler* disassembler);
 RISA_API void              risa_disassembler_reset  (RisaDisassembler* disassembler);
 RISA_API void              risa_disassembler_delete (RisaDisassembler* disassembler);
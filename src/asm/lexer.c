@@ -66,6 +66,7 @@ RisaOpCode risa_asm_token_to_opcode(RisaAsmTokenType token) {
         case RISA_ASM_TOKEN_BJMP   : return RISA_OP_BJMP   ;
         case RISA_ASM_TOKEN_BJMPW  : return RISA_OP_BJMPW  ;
         case RISA_ASM_TOKEN_CALL   : return RISA_OP_CALL   ;
+        case RISA_ASM_TOKEN_TCALL  : return RISA_OP_TCALL  ;
         case RISA_ASM_TOKEN_RET    : return RISA_OP_RET    ;
         case RISA_ASM_TOKEN_ACC    : return RISA_OP_ACC    ;
         case RISA_ASM_TOKEN_DIS    : return RISA_OP_DIS    ;
@@ -321,6 +322,7 @@ static RisaAsmToken risa_asm_lexer_next_identifier(RisaAsmLexer* lexer) {
         case 't': case 'T':
             if(lexer->current - lexer->start > 1) {
                 switch(lexer->start[1]) {
+                    case 'c': case 'C': return risa_asm_lexer_emit(lexer, CLASSIFY_INSENS(2, 3, "all", RISA_ASM_TOKEN_TCALL));
                     case 'e': case 'E': return risa_asm_lexer_emit(lexer, CLASSIFY_INSENS(2, 2, "st", RISA_ASM_TOKEN_TEST));
                     case 'r': case 'R': return risa_asm_lexer_emit(lexer, CLASSIFY_INSENS(2, 2, "ue", RISA_ASM_TOKEN_TRUE));
                     default: return risa_asm_lexer_emit(lexer, RISA_ASM_TOKEN_IDENTIFIER);
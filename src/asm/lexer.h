@@ -38,7 +38,7 @@ typedef enum {
     RISA_ASM_TOKEN_TEST, RISA_ASM_TOKEN_NTEST,
 
     RISA_ASM_TOKEN_JMP, RISA_ASM_TOKEN_JMPW, RISA_ASM_TOKEN_BJMP, RISA_ASM_TOKEN_BJMPW,
-    RISA_ASM_TOKEN_CALL, RISA_ASM_TOKEN_RET,
+    RISA_ASM_TOKEN_CALL, RISA_ASM_TOKEN_TCALL, RISA_ASM_TOKEN_RET,
 
     RISA_ASM_TOKEN_ACC, RISA_ASM_TOKEN_DIS,
 
@@ -36,3 +36,44 @@ bool risa_op_has_direct_dest(RisaOpCode op) {
             return false;
     }
 }
+
+
+RisaOpCode risa_op_dequicken(RisaOpCode op) {
+    switch(op) {
+        case RISA_OP_ADD_INT_INT:
+        case RISA_OP_ADD_FLOAT_FLOAT:
+            return RISA_OP_ADD;
+        case RISA_OP_SUB_INT_INT:
+        case RISA_OP_SUB_FLOAT_FLOAT:
+            return RISA_OP_SUB;
+        case RISA_OP_MUL_INT_INT:
+        case RISA_OP_MUL_FLOAT_FLOAT:
+            return RISA_OP_MUL;
+        case RISA_OP_LT_INT_INT:
+        case RISA_OP_LT_FLOAT_FLOAT:
+            return RISA_OP_LT;
+        case RISA_OP_LTE_INT_INT:
+        case RISA_OP_LTE_FLOAT_FLOAT:
+            return RISA_OP_LTE;
+        case RISA_OP_GGLOB_SLOT:
+            return RISA_OP_GGLOB;
+        case RISA_OP_SGLOB_SLOT:
+            return RISA_OP_SGLOB;
+        default:
+            return op;
+    }
+}
+
+uint16_t risa_op_read_word(const uint8_t* bytes) {
+    uint16_t word;
+
+    ((uint8_t*) &word)[0] = bytes[0];
+    ((uint8_t*) &word)[1] = bytes[1];
+
+    return word;
+}
+
+void risa_op_write_word(uint8_t* bytes, uint16_t word) {
+    bytes[0] = ((uint8_t*) &word)[0];
+    bytes[1] = ((uint8_t*) &word)[1];
+}
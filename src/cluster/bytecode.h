@@ -71,11 +71,32 @@ typedef enum {
     RISA_OP_CALL,
     RISA_OP_RET,
     RISA_OP_ACC,
-    RISA_OP_DIS
+    RISA_OP_DIS,
+    RISA_OP_TCALL, // Like CALL, but the callee replaces the current frame. Always followed by a RET.
+
+    // Quickened variants. The VM rewrites generic instructions into these at runtime, and turns them back into
+    // the generic ones when their guards fail (e.g. the operand types change). They are never emitted nor serialized.
+    RISA_OP_ADD_INT_INT,
+    RISA_OP_SUB_INT_INT,
+    RISA_OP_MUL_INT_INT,
+    RISA_OP_LT_INT_INT,
+    RISA_OP_LTE_INT_INT,
+    RISA_OP_ADD_FLOAT_FLOAT,
+    RISA_OP_SUB_FLOAT_FLOAT,
+    RISA_OP_MUL_FLOAT_FLOAT,
+    RISA_OP_LT_FLOAT_FLOAT,
+    RISA_OP_LTE_FLOAT_FLOAT,
+    RISA_OP_GGLOB_SLOT,
+    RISA_OP_SGLOB_SLOT
 } RisaOpCode;
 
 // Whether or not an operation has a direct register destination (e.g. MOV, ADD, ...)
 // Used for optimizations (e.g. to move the result directly in a local variable without an extra MOV)
-RISA_API bool risa_op_has_direct_dest (RisaOpCode op);
+RISA_API bool       risa_op_has_direct_dest (RisaOpCode op);
+// Returns the generic operation of a quickened operation, or the operation itself if it is not quickened.
+RISA_API RisaOpCode risa_op_dequicken       (RisaOpCode op);
+// Words (CNSTW indices, wide jump amounts) take two operand bytes, in the native byte order.
+RISA_API uint16_t   risa_op_read_word       (const uint8_t* bytes);
+RISA_API void       risa_op_write_word      (uint8_t* bytes, uint16_t word);
 
 #endif
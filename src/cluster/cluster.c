@@ -2,6 +2,8 @@
 
 #include "../mem/mem.h"
 
+#include <string.h>
+
 RisaCluster* risa_cluster_create() {
     RisaCluster* cluster = RISA_MEM_ALLOC(sizeof(RisaCluster));
 
@@ -15,6 +17,7 @@ void risa_cluster_init(RisaCluster* cluster) {
     cluster->capacity = 0;
     cluster->bytecode = NULL;
     cluster->indices = NULL;
+    cluster->registerCount = 0;
 
     risa_value_array_init(&cluster->constants);
 }
@@ -44,9 +47,19 @@ void risa_cluster_write(RisaCluster* cluster, uint8_t byte, uint32_t index) {
 }
 
 uint32_t risa_cluster_write_constant(RisaCluster* cluster, RisaValue constant) {
-    for(uint32_t i = 0; i < cluster->constants.size; ++i)
-        if(risa_value_strict_equals(constant, cluster->constants.values[i]))
+    for(uint32_t i = 0; i < cluster->constants.size; ++i) {
+        RisaValue value = cluster->constants.values[i];
+
+        // Floats are compared bit by bit, so 0.0 and -0.0 don't share a constant.
+        if(risa_value_is_float(constant) && risa_value_is_float(value)) {
+            double left = risa_value_as_float(constant);
+            double right = risa_value_as_float(value);
+
+            if(memcmp(&left, &right, sizeof(double)) == 0)
+                return i;
+        } else if(risa_value_strict_equals(constant, value))
             return i;
+    }
 
     risa_value_array_write(&cluster->constants, constant);
     return cluster->constants.size - 1;
@@ -76,6 +89,8 @@ void risa_cluster_clone(RisaCluster* dest, RisaCluster* src) {
     for(uint32_t i = 0; i < src->constants.size; ++i) {
         risa_cluster_write_constant(dest, src->constants.values[i]);
     }
+
+    dest->registerCount = src->registerCount;
 }
 
 void risa_cluster_delete(RisaCluster* cluster) {
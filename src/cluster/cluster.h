@@ -18,8 +18,18 @@ typedef struct {
     uint32_t* indices;
 
     RisaValueArray constants;
+
+    uint8_t registerCount; // How many registers the bytecode uses; this is the size of the frame.
 } RisaCluster;
 
+// A basic block of the bytecode, as seen by the optimizer. Blocks are numbered in the order they appear.
+typedef struct {
+    uint32_t start;         // The offset of the first instruction.
+    uint32_t end;           // The offset after the last instruction.
+    uint32_t successors[2]; // UINT32_MAX if missing.
+    uint32_t idom;          // The immediate dominator. The entry block dominates itself; unreachable blocks have UINT32_MAX.
+} RisaClusterBlock;
+
 typedef struct {
     RisaMap strings;
 
@@ -62,6 +72,8 @@ RISA_API RisaValue                         risa_cluster_get_constant_at
 RISA_API void                              risa_cluster_clone                        (RisaCluster* dest, RisaCluster* src);
 RISA_API void                              risa_cluster_delete                       (RisaCluster* cluster);
 RISA_API void                              risa_cluster_free                         (RisaCluster* cluster);
+RISA_API void                              risa_cluster_optimize                     (RisaCluster* cluster, bool inlining); // Also optimizes the functions in the constants.
+RISA_API RisaClusterBlock*                 risa_cluster_get_blocks                   (RisaCluster* cluster, uint32_t* count); // Free with RISA_MEM_FREE.
 
 RISA_API void                              risa_cluster_serializer_init              (RisaClusterSerializer* serializer);
 RISA_API void                              risa_cluster_serializer_delete            (RisaClusterSerializer* serializer);
@@ -121,6 +121,10 @@ static bool risa_cluster_deserialize(RisaClusterDeserializer* deserializer, Risa
 
     risa_cluster_init(cluster);
 
+    if(!risa_const_buffer_read_uint8(&deserializer->input, &cluster->registerCount)) {
+        return false;
+    }
+
     uint32_t size;
 
     if(!risa_const_buffer_read_uint32(&deserializer->input, &size)) {
@@ -159,7 +163,7 @@ static bool risa_cluster_deserialize_string(RisaClusterDeserializer* deserialize
     RisaDenseStringPtr str = risa_vm_string_create(deserializer->vm, (const char*) (deserializer->input.data + start), length);
 
     if(deserializer->strings.size == deserializer->strings.capacity) {
-        deserializer->strings.data = RISA_MEM_EXPAND(deserializer->strings.data, &deserializer->strings.capacity, sizeof(uint8_t));
+        deserializer->strings.data = RISA_MEM_EXPAND(deserializer->strings.data, &deserializer->strings.capacity, sizeof(RisaDenseStringPtr));
     }
 
     deserializer->strings.data[deserializer->strings.size++] = str;
@@ -230,6 +234,13 @@ static bool risa_cluster_deserialize_value(RisaClusterDeserializer* deserializer
                 return false;
             }
 
+            #ifdef RISA_VALUE_NAN_BOXING
+                // Clusters compiled with 16-byte values can hold ints that boxed values would wrap around.
+                if(val < RISA_VALUE_NAN_INT_MIN || val > RISA_VALUE_NAN_INT_MAX) {
+                    return false;
+                }
+            #endif
+
             *value = risa_value_from_int(val);
             return true;
         }
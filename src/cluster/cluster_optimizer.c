@@ -0,0 +1,2432 @@
+#include "cluster.h"
+#include "bytecode.h"
+#include "../def/def.h"
+#include "../mem/mem.h"
+#include "../value/dense.h"
+
+// Operand bytes that hold constant indices.
+#define RISA_OPTIMIZER_OPERAND_DEST  0x01
+#define RISA_OPTIMIZER_OPERAND_LEFT  0x02
+#define RISA_OPTIMIZER_OPERAND_RIGHT 0x04
+#define RISA_OPTIMIZER_OPERAND_WORD  0x08 // LEFT and RIGHT as a word.
+
+#define RISA_OPTIMIZER_MAX_PASSES    16
+#define RISA_OPTIMIZER_NO_BLOCK      UINT32_MAX
+
+// Register sets, as bits in 64-bit words.
+#define RISA_OPTIMIZER_REGISTER_WORDS ((RISA_TODLR_REGISTER_COUNT + 63) / 64)
+#define RISA_OPTIMIZER_REGISTER_HAS(set, reg) (((set)[(reg) / 64] >> ((reg) % 64)) & 1)
+#define RISA_OPTIMIZER_REGISTER_ADD(set, reg) ((set)[(reg) / 64] |= (uint64_t) 1 << ((reg) % 64))
+#define RISA_OPTIMIZER_REGISTER_DEL(set, reg) ((set)[(reg) / 64] &= ~((uint64_t) 1 << ((reg) % 64)))
+
+typedef struct {
+    uint32_t first;         // The first live instruction.
+    uint32_t last;          // The last live instruction.
+    uint32_t successors[2];
+    uint32_t idom;
+} RisaClusterOptimizerBlock;
+
+// An expression seen by value numbering. Register operands are replaced by their value numbers.
+typedef struct {
+    uint8_t op;     // The opcode and operand types. Empty slots have 0, which is CNST and never numbered.
+    uint32_t left;
+    uint32_t right;
+    uint32_t value;
+    uint32_t block;  // A block where the expression was computed.
+} RisaClusterOptimizerExpression;
+
+// The working state of the optimizer. Instructions are never moved while optimizing; they are only marked as dead,
+// and the bytecode is compacted at the end. Jumps are kept as target instruction indices until then.
+typedef struct {
+    RisaCluster* cluster;
+    uint32_t count;
+
+    bool* live;
+    bool* reached;
+    bool* labels;       // Instructions that are reached from somewhere other than the previous instruction.
+    bool* guarded;      // Instructions that can be skipped by a TEST, or that belong to the previous instruction.
+    bool* proven;       // Instructions that can't fail, because they were already computed on every path to them.
+    uint32_t* targets;  // The target of every jump.
+    uint32_t* next;     // The first live instruction after every instruction.
+    uint32_t* prev;     // The last live instruction before every instruction.
+    uint32_t* resolved; // The first live instruction at or after every instruction.
+    uint32_t* worklist;
+
+    bool analyzable;    // Whether or not the registers of every instruction are known. Inline asm can break this.
+    uint64_t* liveness; // The registers that are live before every instruction.
+    uint64_t captured[RISA_OPTIMIZER_REGISTER_WORDS]; // Registers captured by closures, which are always live.
+
+    // The control flow graph, built from the live instructions by 'build_blocks'.
+    RisaClusterOptimizerBlock* blocks;
+    uint32_t blockCount;
+    uint32_t* blockOf;           // The block of every live instruction.
+    uint32_t* order;             // The reachable blocks in reverse postorder, so every block comes after its dominator.
+    uint32_t orderCount;
+    uint32_t* ranks;             // The position of every block in the order.
+    uint32_t* predecessors;
+    uint32_t* predecessorStarts; // Where the predecessors of every block start.
+    uint64_t* defs;              // The registers written by every block.
+} RisaClusterOptimizer;
+
+static void     risa_cluster_optimizer_optimize          (RisaCluster* cluster, uint8_t arity, const RisaValueArray* written);
+static void     risa_cluster_optimizer_run               (RisaClusterOptimizer* optimizer);
+static void     risa_cluster_optimizer_init              (RisaClusterOptimizer* optimizer, RisaCluster* cluster);
+static void     risa_cluster_optimizer_delete            (RisaClusterOptimizer* optimizer);
+static void     risa_cluster_optimizer_refresh           (RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_remove_unreachable(RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_thread_jumps      (RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_fold_tests        (RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_remove_movs       (RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_propagate_copies  (RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_number_values     (RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_coalesce_registers(RisaClusterOptimizer* optimizer);
+static bool     risa_cluster_optimizer_hoist_invariants  (RisaClusterOptimizer* optimizer, const RisaValueArray* written);
+static bool     risa_cluster_optimizer_rename_register   (RisaClusterOptimizer* optimizer, uint32_t instruction, uint8_t reg);
+static void     risa_cluster_optimizer_compute_liveness  (RisaClusterOptimizer* optimizer);
+static void     risa_cluster_optimizer_live_after        (RisaClusterOptimizer* optimizer, uint32_t instruction, uint64_t* live);
+static void     risa_cluster_optimizer_build_blocks      (RisaClusterOptimizer* optimizer);
+static uint32_t risa_cluster_optimizer_intersect         (RisaClusterOptimizer* optimizer, uint32_t left, uint32_t right);
+static bool     risa_cluster_optimizer_dominates         (RisaClusterOptimizer* optimizer, uint32_t dominator, uint32_t block);
+static RisaClusterOptimizerExpression* risa_cluster_optimizer_find_expression(RisaClusterOptimizerExpression* expressions, uint32_t capacity, uint8_t op, uint32_t left, uint32_t right);
+static void     risa_cluster_optimizer_emit              (RisaClusterOptimizer* optimizer);
+static void     risa_cluster_optimizer_encode_jump       (uint8_t* instruction, uint32_t from, uint32_t to);
+static void     risa_cluster_optimizer_allocate_registers(RisaCluster* cluster, uint8_t arity);
+static void     risa_cluster_optimizer_compact_constants (RisaCluster* cluster);
+static void     risa_cluster_optimizer_collect_globals   (RisaCluster* cluster, RisaValueArray* written);
+static bool     risa_cluster_optimizer_has_global        (const RisaValueArray* globals, RisaValue name);
+static void     risa_cluster_optimizer_find_inlinable    (RisaCluster* cluster, const RisaValueArray* written, RisaValueArray* names, RisaValueArray* functions);
+static void     risa_cluster_optimizer_inline_calls      (RisaCluster* cluster, const RisaValueArray* names, const RisaValueArray* functions);
+static bool     risa_cluster_optimizer_inline_body       (RisaCluster* cluster, uint32_t call, RisaCluster* callee, uint8_t* bytecode, uint32_t* indices, uint32_t* size);
+static RisaDenseFunction* risa_cluster_optimizer_find_callee(RisaClusterOptimizer* optimizer, uint32_t call, const RisaValueArray* names, const RisaValueArray* functions);
+static void     risa_cluster_optimizer_copy_instruction  (RisaCluster* cluster, uint32_t from, uint8_t* bytecode, uint32_t* indices, uint32_t to);
+static uint8_t  risa_cluster_optimizer_constant_operands (const uint8_t* instruction);
+static bool     risa_cluster_optimizer_register_operands (const uint8_t* instruction, uint8_t* reads, uint8_t* writes);
+static bool     risa_cluster_optimizer_is_analyzable     (RisaCluster* cluster);
+static bool     risa_cluster_optimizer_is_jump           (uint8_t op);
+static bool     risa_cluster_optimizer_is_pure           (uint8_t op);
+static bool     risa_cluster_optimizer_is_repeatable     (uint8_t op);
+static bool     risa_cluster_optimizer_is_inlinable      (RisaDenseFunction* function);
+static bool     risa_cluster_optimizer_is_known          (RisaCluster* cluster, uint32_t instruction, uint8_t reg, bool* truthy);
+
+void risa_cluster_optimize(RisaCluster* cluster, bool inlining) {
+    // The globals written by functions, which are the only ones that can change during a call.
+    RisaValueArray written;
+    risa_value_array_init(&written);
+
+    for(uint32_t i = 0; i < cluster->constants.size; ++i)
+        if(risa_value_is_dense_of_type(cluster->constants.values[i], RISA_DVAL_FUNCTION))
+            risa_cluster_optimizer_collect_globals(&((RisaDenseFunction*) risa_value_as_dense(cluster->constants.values[i]))->cluster, &written);
+
+    #ifdef RISA_OPTIMIZER_NO_INLINE
+        inlining = false;
+    #endif
+
+    if(inlining) {
+        // Small functions that the script defines once, and which are called by name.
+        RisaValueArray names;
+        RisaValueArray functions;
+
+        risa_value_array_init(&names);
+        risa_value_array_init(&functions);
+
+        risa_cluster_optimizer_find_inlinable(cluster, &written, &names, &functions);
+        risa_cluster_optimizer_inline_calls(cluster, &names, &functions);
+
+        risa_value_array_delete(&names);
+        risa_value_array_delete(&functions);
+    }
+
+    risa_cluster_optimizer_optimize(cluster, 0, &written);
+
+    risa_value_array_delete(&written);
+}
+
+RisaClusterBlock* risa_cluster_get_blocks(RisaCluster* cluster, uint32_t* count) {
+    *count = 0;
+
+    if(cluster->size < RISA_TODLR_INSTRUCTION_SIZE)
+        return NULL;
+
+    RisaClusterOptimizer optimizer;
+    risa_cluster_optimizer_init(&optimizer, cluster);
+
+    risa_cluster_optimizer_refresh(&optimizer);
+    risa_cluster_optimizer_build_blocks(&optimizer);
+
+    RisaClusterBlock* blocks = (RisaClusterBlock*) RISA_MEM_ALLOC(optimizer.blockCount * sizeof(RisaClusterBlock));
+
+    for(uint32_t i = 0; i < optimizer.blockCount; ++i) {
+        blocks[i].start = optimizer.blocks[i].first * RISA_TODLR_INSTRUCTION_SIZE;
+        blocks[i].end = (optimizer.blocks[i].last + 1) * RISA_TODLR_INSTRUCTION_SIZE;
+        blocks[i].successors[0] = optimizer.blocks[i].successors[0];
+        blocks[i].successors[1] = optimizer.blocks[i].successors[1];
+        blocks[i].idom = optimizer.blocks[i].idom;
+    }
+
+    *count = optimizer.blockCount;
+
+    risa_cluster_optimizer_delete(&optimizer);
+
+    return blocks;
+}
+
+static void risa_cluster_optimizer_optimize(RisaCluster* cluster, uint8_t arity, const RisaValueArray* written) {
+    if(cluster->size >= RISA_TODLR_INSTRUCTION_SIZE) {
+        RisaClusterOptimizer optimizer;
+        risa_cluster_optimizer_init(&optimizer, cluster);
+        risa_cluster_optimizer_run(&optimizer);
+
+        // Hoisting adds instructions, so it works on the compacted bytecode. The other passes run again afterwards,
+        // and the next round can move the instructions out of the enclosing loop.
+        for(uint32_t round = 0; optimizer.analyzable && round < RISA_OPTIMIZER_MAX_PASSES; ++round) {
+            risa_cluster_optimizer_delete(&optimizer);
+            risa_cluster_optimizer_init(&optimizer, cluster);
+
+            if(!risa_cluster_optimizer_hoist_invariants(&optimizer, written))
+                break;
+
+            risa_cluster_optimizer_delete(&optimizer);
+            risa_cluster_optimizer_init(&optimizer, cluster);
+            risa_cluster_optimizer_run(&optimizer);
+        }
+
+        if(optimizer.analyzable)
+            risa_cluster_optimizer_allocate_registers(cluster, arity);
+
+        risa_cluster_optimizer_delete(&optimizer);
+    }
+
+    risa_cluster_optimizer_compact_constants(cluster);
+
+    for(uint32_t i = 0; i < cluster->constants.size; ++i) {
+        if(risa_value_is_dense_of_type(cluster->constants.values[i], RISA_DVAL_FUNCTION)) {
+            RisaDenseFunction* function = (RisaDenseFunction*) risa_value_as_dense(cluster->constants.values[i]);
+            risa_cluster_optimizer_optimize(&function->cluster, function->arity, written);
+        }
+    }
+}
+
+static void risa_cluster_optimizer_run(RisaClusterOptimizer* optimizer) {
+    for(uint32_t pass = 0; pass < RISA_OPTIMIZER_MAX_PASSES; ++pass) {
+        bool changed = false;
+
+        risa_cluster_optimizer_refresh(optimizer);
+        changed |= risa_cluster_optimizer_remove_unreachable(optimizer);
+
+        risa_cluster_optimizer_refresh(optimizer);
+        changed |= risa_cluster_optimizer_thread_jumps(optimizer);
+
+        risa_cluster_optimizer_refresh(optimizer);
+        changed |= risa_cluster_optimizer_fold_tests(optimizer);
+
+        risa_cluster_optimizer_refresh(optimizer);
+        changed |= risa_cluster_optimizer_remove_movs(optimizer);
+
+        if(optimizer->analyzable) {
+            risa_cluster_optimizer_refresh(optimizer);
+            changed |= risa_cluster_optimizer_number_values(optimizer);
+
+            risa_cluster_optimizer_refresh(optimizer);
+            changed |= risa_cluster_optimizer_propagate_copies(optimizer);
+
+            risa_cluster_optimizer_refresh(optimizer);
+            changed |= risa_cluster_optimizer_coalesce_registers(optimizer);
+        }
+
+        if(!changed)
+            break;
+    }
+
+    risa_cluster_optimizer_refresh(optimizer);
+    risa_cluster_optimizer_emit(optimizer);
+}
+
+static void risa_cluster_optimizer_init(RisaClusterOptimizer* optimizer, RisaCluster* cluster) {
+    uint32_t count = cluster->size / RISA_TODLR_INSTRUCTION_SIZE;
+
+    optimizer->cluster = cluster;
+    optimizer->count = count;
+
+    optimizer->live = (bool*) RISA_MEM_ALLOC(count * sizeof(bool));
+    optimizer->reached = (bool*) RISA_MEM_ALLOC(count * sizeof(bool));
+    optimizer->labels = (bool*) RISA_MEM_ALLOC((count + 1) * sizeof(bool));
+    optimizer->guarded = (bool*) RISA_MEM_ALLOC((count + 1) * sizeof(bool));
+    optimizer->proven = (bool*) RISA_MEM_ALLOC(count * sizeof(bool));
+    optimizer->targets = (uint32_t*) RISA_MEM_ALLOC(count * sizeof(uint32_t));
+    optimizer->next = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+    optimizer->prev = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+    optimizer->resolved = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+    optimizer->worklist = (uint32_t*) RISA_MEM_ALLOC((2 * count + 1) * sizeof(uint32_t));
+
+    optimizer->analyzable = risa_cluster_optimizer_is_analyzable(cluster);
+    optimizer->liveness = (uint64_t*) RISA_MEM_ALLOC(count * RISA_OPTIMIZER_REGISTER_WORDS * sizeof(uint64_t));
+
+    for(uint32_t i = 0; i < RISA_OPTIMIZER_REGISTER_WORDS; ++i)
+        optimizer->captured[i] = 0;
+
+    optimizer->blocks = (RisaClusterOptimizerBlock*) RISA_MEM_ALLOC(count * sizeof(RisaClusterOptimizerBlock));
+    optimizer->blockCount = 0;
+    optimizer->blockOf = (uint32_t*) RISA_MEM_ALLOC(count * sizeof(uint32_t));
+    optimizer->order = (uint32_t*) RISA_MEM_ALLOC(count * sizeof(uint32_t));
+    optimizer->orderCount = 0;
+    optimizer->ranks = (uint32_t*) RISA_MEM_ALLOC(count * sizeof(uint32_t));
+    optimizer->predecessors = (uint32_t*) RISA_MEM_ALLOC(2 * count * sizeof(uint32_t));
+    optimizer->predecessorStarts = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+    optimizer->defs = (uint64_t*) RISA_MEM_ALLOC(count * RISA_OPTIMIZER_REGISTER_WORDS * sizeof(uint64_t));
+
+    for(uint32_t i = 0; i < count; ++i) {
+        uint8_t* instruction = &cluster->bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+
+        optimizer->live[i] = true;
+        optimizer->proven[i] = false;
+        optimizer->targets[i] = count;
+
+        switch(instruction[0] & RISA_TODLR_INSTRUCTION_MASK) {
+            case RISA_OP_JMP:
+                optimizer->targets[i] = i + 1 + instruction[1];
+                break;
+            case RISA_OP_JMPW:
+                optimizer->targets[i] = i + 1 + risa_op_read_word(instruction + 1);
+                break;
+            case RISA_OP_BJMP:
+                optimizer->targets[i] = i >= instruction[1] ? i - instruction[1] : count;
+                break;
+            case RISA_OP_BJMPW: {
+                uint16_t amount = risa_op_read_word(instruction + 1);
+                optimizer->targets[i] = i >= amount ? i - amount : count;
+                break;
+            }
+            default:
+                break;
+        }
+
+        // Malformed jumps (e.g. from inline asm) are left alone.
+        if(optimizer->targets[i] > count)
+            optimizer->targets[i] = count;
+
+        // The closure can read and write the register at any time, e.g. during a call.
+        if(optimizer->analyzable && instruction[0] == RISA_OP_UPVAL && instruction[2])
+            RISA_OPTIMIZER_REGISTER_ADD(optimizer->captured, instruction[1]);
+    }
+}
+
+static void risa_cluster_optimizer_delete(RisaClusterOptimizer* optimizer) {
+    RISA_MEM_FREE(optimizer->live);
+    RISA_MEM_FREE(optimizer->reached);
+    RISA_MEM_FREE(optimizer->labels);
+    RISA_MEM_FREE(optimizer->guarded);
+    RISA_MEM_FREE(optimizer->proven);
+    RISA_MEM_FREE(optimizer->targets);
+    RISA_MEM_FREE(optimizer->next);
+    RISA_MEM_FREE(optimizer->prev);
+    RISA_MEM_FREE(optimizer->resolved);
+    RISA_MEM_FREE(optimizer->worklist);
+    RISA_MEM_FREE(optimizer->liveness);
+    RISA_MEM_FREE(optimizer->blocks);
+    RISA_MEM_FREE(optimizer->blockOf);
+    RISA_MEM_FREE(optimizer->order);
+    RISA_MEM_FREE(optimizer->ranks);
+    RISA_MEM_FREE(optimizer->predecessors);
+    RISA_MEM_FREE(optimizer->predecessorStarts);
+    RISA_MEM_FREE(optimizer->defs);
+}
+
+static void risa_cluster_optimizer_refresh(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    uint32_t nextLive = count;
+
+    optimizer->next[count] = count;
+    optimizer->resolved[count] = count;
+
+    for(uint32_t i = count; i > 0; --i) {
+        optimizer->next[i - 1] = nextLive;
+
+        if(optimizer->live[i - 1])
+            nextLive = i - 1;
+
+        optimizer->resolved[i - 1] = nextLive;
+    }
+
+    uint32_t prevLive = count;
+
+    for(uint32_t i = 0; i <= count; ++i) {
+        optimizer->prev[i] = prevLive;
+
+        if(i < count && optimizer->live[i])
+            prevLive = i;
+    }
+
+    for(uint32_t i = 0; i <= count; ++i) {
+        optimizer->labels[i] = false;
+        optimizer->guarded[i] = false;
+    }
+
+    optimizer->labels[optimizer->resolved[0]] = true;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i])
+            continue;
+
+        uint8_t* instruction = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t op = instruction[0] & RISA_TODLR_INSTRUCTION_MASK;
+
+        if(risa_cluster_optimizer_is_jump(op)) {
+            optimizer->labels[optimizer->resolved[optimizer->targets[i]]] = true;
+        } else if(op == RISA_OP_TEST || op == RISA_OP_NTEST) {
+            uint32_t skipped = optimizer->next[i];
+
+            optimizer->guarded[skipped] = true;
+            optimizer->labels[optimizer->next[skipped]] = true;
+        } else if(op == RISA_OP_CLSR) {
+            uint32_t upvalue = i;
+
+            for(uint8_t j = 0; j < instruction[3]; ++j) {
+                upvalue = optimizer->next[upvalue];
+                optimizer->guarded[upvalue] = true;
+            }
+        } else if(op == RISA_OP_TCALL) {
+            optimizer->guarded[optimizer->next[i]] = true;
+        }
+    }
+}
+
+static bool risa_cluster_optimizer_remove_unreachable(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    uint32_t size = 0;
+
+    for(uint32_t i = 0; i < count; ++i)
+        optimizer->reached[i] = false;
+
+    optimizer->worklist[size++] = optimizer->resolved[0];
+
+    while(size > 0) {
+        uint32_t i = optimizer->worklist[--size];
+
+        if(i >= count || optimizer->reached[i])
+            continue;
+
+        optimizer->reached[i] = true;
+
+        uint8_t* instruction = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+
+        switch(instruction[0] & RISA_TODLR_INSTRUCTION_MASK) {
+            case RISA_OP_RET:
+                break;
+            case RISA_OP_JMP:
+            case RISA_OP_JMPW:
+            case RISA_OP_BJMP:
+            case RISA_OP_BJMPW:
+                optimizer->worklist[size++] = optimizer->resolved[optimizer->targets[i]];
+                break;
+            case RISA_OP_TEST:
+            case RISA_OP_NTEST:
+                optimizer->worklist[size++] = optimizer->next[i];
+                optimizer->worklist[size++] = optimizer->next[optimizer->next[i]];
+                break;
+            case RISA_OP_CLSR: {
+                uint32_t upvalue = i;
+
+                for(uint8_t j = 0; j < instruction[3] && upvalue < count; ++j) {
+                    upvalue = optimizer->next[upvalue];
+
+                    if(upvalue < count)
+                        optimizer->reached[upvalue] = true;
+                }
+
+                optimizer->worklist[size++] = optimizer->next[upvalue];
+                break;
+            }
+            default:
+                optimizer->worklist[size++] = optimizer->next[i];
+                break;
+        }
+    }
+
+    bool changed = false;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        if(optimizer->live[i] && !optimizer->reached[i]) {
+            optimizer->live[i] = false;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_thread_jumps(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    bool changed = false;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i] || !risa_cluster_optimizer_is_jump(bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK))
+            continue;
+
+        uint32_t target = optimizer->resolved[optimizer->targets[i]];
+
+        // A jump to the next instruction does nothing. If it follows a TEST, it is folded together with the TEST.
+        if(target == optimizer->next[i] && !optimizer->guarded[i]) {
+            optimizer->live[i] = false;
+            changed = true;
+            continue;
+        }
+
+        // Follow chains of jumps. The hop count stops cycles.
+        for(uint32_t hops = 0; target < count && hops < count; ++hops) {
+            if(!risa_cluster_optimizer_is_jump(bytecode[target * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK))
+                break;
+
+            uint32_t next = optimizer->resolved[optimizer->targets[target]];
+
+            // Compaction never makes a jump longer, so staying within the original range keeps it encodable.
+            if(next == target || (next > i ? next - i : i - next) > UINT16_MAX)
+                break;
+
+            target = next;
+        }
+
+        if(target != optimizer->resolved[optimizer->targets[i]]) {
+            optimizer->targets[i] = target;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_fold_tests(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    RisaCluster* cluster = optimizer->cluster;
+    uint8_t* bytecode = cluster->bytecode;
+
+    bool changed = false;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i] || optimizer->guarded[i])
+            continue;
+
+        uint8_t op = bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK;
+
+        if(op != RISA_OP_TEST && op != RISA_OP_NTEST)
+            continue;
+
+        uint32_t jump = optimizer->next[i];
+
+        if(jump >= count || !risa_cluster_optimizer_is_jump(bytecode[jump * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK))
+            continue;
+
+        uint8_t reg = bytecode[i * RISA_TODLR_INSTRUCTION_SIZE + 1];
+        uint32_t target = optimizer->resolved[optimizer->targets[jump]];
+
+        // The jump goes where the TEST would skip to, so neither does anything.
+        if(target == optimizer->next[jump]) {
+            optimizer->live[i] = false;
+            optimizer->live[jump] = false;
+            changed = true;
+            continue;
+        }
+
+        // The tested register was just set to a constant (e.g. 'while(true)').
+        bool truthy;
+        uint32_t prev = optimizer->prev[i];
+
+        if(prev < count && !optimizer->labels[i] && !optimizer->guarded[prev] && risa_cluster_optimizer_is_known(cluster, prev, reg, &truthy)) {
+            // TEST jumps when the value is falsy, NTEST when it is truthy.
+            bool taken = (op == RISA_OP_TEST) != truthy;
+
+            optimizer->live[i] = false;
+
+            if(!taken)
+                optimizer->live[jump] = false;
+
+            changed = true;
+            continue;
+        }
+
+        // The jump lands on another test of the same register, whose outcome is already known (e.g. 'a && b && c').
+        if(target < count) {
+            uint8_t targetOp = bytecode[target * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK;
+            uint32_t targetJump = optimizer->next[target];
+
+            if((targetOp == RISA_OP_TEST || targetOp == RISA_OP_NTEST)
+            && bytecode[target * RISA_TODLR_INSTRUCTION_SIZE + 1] == reg
+            && targetJump < count
+            && risa_cluster_optimizer_is_jump(bytecode[targetJump * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK)) {
+                uint32_t threaded = targetOp == op ? optimizer->resolved[optimizer->targets[targetJump]] : optimizer->next[targetJump];
+
+                if(threaded != target && (threaded > jump ? threaded - jump : jump - threaded) <= UINT16_MAX) {
+                    optimizer->targets[jump] = threaded;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_remove_movs(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    bool changed = false;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i] || optimizer->guarded[i] || bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] != RISA_OP_MOV)
+            continue;
+
+        uint8_t dest = bytecode[i * RISA_TODLR_INSTRUCTION_SIZE + 1];
+        uint8_t src = bytecode[i * RISA_TODLR_INSTRUCTION_SIZE + 2];
+
+        if(dest == src) {
+            optimizer->live[i] = false;
+            changed = true;
+            continue;
+        }
+
+        uint32_t next = optimizer->next[i];
+
+        if(next >= count || bytecode[next * RISA_TODLR_INSTRUCTION_SIZE] != RISA_OP_MOV)
+            continue;
+
+        uint8_t nextDest = bytecode[next * RISA_TODLR_INSTRUCTION_SIZE + 1];
+        uint8_t nextSrc = bytecode[next * RISA_TODLR_INSTRUCTION_SIZE + 2];
+
+        if(nextDest == src && nextSrc == dest && !optimizer->labels[next] && !optimizer->guarded[next]) {
+            // MOV a b; MOV b a
+            optimizer->live[next] = false;
+            changed = true;
+        } else if(nextDest == dest && nextSrc != dest) {
+            // MOV a b; MOV a c
+            optimizer->live[i] = false;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_propagate_copies(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    bool changed = false;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i] || optimizer->guarded[i] || bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] != RISA_OP_MOV)
+            continue;
+
+        uint8_t dest = bytecode[i * RISA_TODLR_INSTRUCTION_SIZE + 1];
+        uint8_t src = bytecode[i * RISA_TODLR_INSTRUCTION_SIZE + 2];
+
+        // Read the source instead of the copy, until the block ends or either register changes. Calls end the
+        // search too, as they read their arguments implicitly and can change captured registers.
+        for(uint32_t j = optimizer->next[i]; j < count && !optimizer->labels[j]; j = optimizer->next[j]) {
+            uint8_t* instruction = &bytecode[j * RISA_TODLR_INSTRUCTION_SIZE];
+            uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+            if(op == RISA_OP_CALL || op == RISA_OP_TCALL || op == RISA_OP_UPVAL)
+                break;
+
+            uint8_t reads;
+            uint8_t writes;
+
+            risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+            for(uint8_t k = 1; k <= 3; ++k) {
+                uint8_t operand = 1 << (k - 1);
+
+                if((reads & operand) && !(writes & operand) && instruction[k] == dest) {
+                    instruction[k] = src;
+                    changed = true;
+                }
+            }
+
+            if(((writes & RISA_OPTIMIZER_OPERAND_DEST) && (instruction[1] == dest || instruction[1] == src))
+            || risa_cluster_optimizer_is_jump(op) || op == RISA_OP_RET)
+                break;
+        }
+    }
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_number_values(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    risa_cluster_optimizer_build_blocks(optimizer);
+
+    uint32_t blockCount = optimizer->blockCount;
+    uint32_t capacity = 16;
+
+    // Every instruction adds at most one expression, so the table never fills up.
+    while(capacity < 2 * count)
+        capacity *= 2;
+
+    // Every register holds a value number, and equal numbers mean equal values. A block starts with the numbers from
+    // the end of its immediate dominator, and new numbers for the registers that can be written on the way from there.
+    uint32_t* exits = (uint32_t*) RISA_MEM_ALLOC(blockCount * RISA_TODLR_REGISTER_COUNT * sizeof(uint32_t));
+    uint32_t* marks = (uint32_t*) RISA_MEM_ALLOC(blockCount * sizeof(uint32_t));
+    RisaClusterOptimizerExpression* expressions = (RisaClusterOptimizerExpression*) RISA_MEM_ALLOC(capacity * sizeof(RisaClusterOptimizerExpression));
+
+    uint32_t numbers[RISA_TODLR_REGISTER_COUNT];
+    uint64_t killed[RISA_OPTIMIZER_REGISTER_WORDS];
+    uint32_t nextNumber = 0;
+
+    bool changed = false;
+
+    for(uint32_t i = 0; i < blockCount; ++i)
+        marks[i] = RISA_OPTIMIZER_NO_BLOCK;
+
+    for(uint32_t i = 0; i < capacity; ++i)
+        expressions[i].op = 0;
+
+    for(uint32_t i = 0; i < optimizer->orderCount; ++i) {
+        uint32_t block = optimizer->order[i];
+
+        for(uint32_t j = 0; j < RISA_OPTIMIZER_REGISTER_WORDS; ++j)
+            killed[j] = i == 0 ? UINT64_MAX : 0;
+
+        if(i > 0) {
+            uint32_t idom = optimizer->blocks[block].idom;
+            uint32_t stackSize = 0;
+
+            for(uint32_t j = 0; j < RISA_TODLR_REGISTER_COUNT; ++j)
+                numbers[j] = exits[idom * RISA_TODLR_REGISTER_COUNT + j];
+
+            // Every path from the dominator to the block only goes through blocks that are reached by walking back
+            // from the block without crossing the dominator. Inside loops, this includes the block itself.
+            optimizer->worklist[stackSize++] = block;
+
+            while(stackSize > 0) {
+                uint32_t current = optimizer->worklist[--stackSize];
+
+                for(uint32_t j = optimizer->predecessorStarts[current]; j < optimizer->predecessorStarts[current + 1]; ++j) {
+                    uint32_t predecessor = optimizer->predecessors[j];
+
+                    if(predecessor == idom || marks[predecessor] == block)
+                        continue;
+
+                    marks[predecessor] = block;
+                    optimizer->worklist[stackSize++] = predecessor;
+
+                    for(uint32_t k = 0; k < RISA_OPTIMIZER_REGISTER_WORDS; ++k)
+                        killed[k] |= optimizer->defs[predecessor * RISA_OPTIMIZER_REGISTER_WORDS + k];
+                }
+            }
+        }
+
+        for(uint32_t j = 0; j < RISA_TODLR_REGISTER_COUNT; ++j)
+            if(RISA_OPTIMIZER_REGISTER_HAS(killed, j))
+                numbers[j] = nextNumber++;
+
+        for(uint32_t j = optimizer->blocks[block].first; j < count; j = optimizer->next[j]) {
+            uint8_t* instruction = &bytecode[j * RISA_TODLR_INSTRUCTION_SIZE];
+            uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+            uint8_t reads;
+            uint8_t writes;
+
+            risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+            // Closures can change captured registers at any time, so their values are never known.
+            optimizer->proven[j] = false;
+
+            bool captured = (writes & RISA_OPTIMIZER_OPERAND_DEST) && RISA_OPTIMIZER_REGISTER_HAS(optimizer->captured, instruction[1]);
+
+            for(uint8_t k = 2; k <= 3; ++k)
+                if((reads & (1 << (k - 1))) && RISA_OPTIMIZER_REGISTER_HAS(optimizer->captured, instruction[k]))
+                    captured = true;
+
+            if(risa_cluster_optimizer_is_pure(op) && !optimizer->guarded[j] && !captured) {
+                bool unary = op == RISA_OP_NOT || op == RISA_OP_BNOT || op == RISA_OP_NEG;
+
+                uint32_t left = (reads & RISA_OPTIMIZER_OPERAND_LEFT) ? numbers[instruction[2]] : instruction[2];
+                uint32_t right = unary ? 0 : (reads & RISA_OPTIMIZER_OPERAND_RIGHT) ? numbers[instruction[3]] : instruction[3];
+
+                RisaClusterOptimizerExpression* expression = risa_cluster_optimizer_find_expression(expressions, capacity, instruction[0], left, right);
+
+                if(expression->op == 0) {
+                    expression->op = instruction[0];
+                    expression->left = left;
+                    expression->right = right;
+                    expression->value = nextNumber++;
+                    expression->block = block;
+                } else {
+                    // The operands are the same as when it was computed, so it would have failed there already.
+                    if(risa_cluster_optimizer_dominates(optimizer, expression->block, block))
+                        optimizer->proven[j] = true;
+                    else expression->block = block;
+
+                    if(numbers[instruction[1]] == expression->value) {
+                        // The dest already holds the value.
+                        optimizer->live[j] = false;
+                        changed = true;
+                    } else {
+                        uint32_t holder = RISA_TODLR_REGISTER_COUNT;
+
+                        for(uint32_t k = 0; k < RISA_TODLR_REGISTER_COUNT; ++k) {
+                            if(numbers[k] == expression->value && !RISA_OPTIMIZER_REGISTER_HAS(optimizer->captured, k)) {
+                                holder = k;
+                                break;
+                            }
+                        }
+
+                        if(holder < RISA_TODLR_REGISTER_COUNT) {
+                            instruction[0] = RISA_OP_MOV;
+                            instruction[2] = (uint8_t) holder;
+                            instruction[3] = 0;
+
+                            changed = true;
+                        }
+                    }
+                }
+
+                numbers[instruction[1]] = expression->value;
+            } else if(op == RISA_OP_MOV && !captured) {
+                numbers[instruction[1]] = numbers[instruction[2]];
+            } else if(writes & RISA_OPTIMIZER_OPERAND_DEST) {
+                numbers[instruction[1]] = nextNumber++;
+            }
+
+            // The callee uses the registers after the callee register as its own.
+            if(op == RISA_OP_CALL || op == RISA_OP_TCALL)
+                for(uint16_t k = instruction[1]; k < RISA_TODLR_REGISTER_COUNT; ++k)
+                    numbers[k] = nextNumber++;
+
+            if(j == optimizer->blocks[block].last)
+                break;
+        }
+
+        for(uint32_t j = 0; j < RISA_TODLR_REGISTER_COUNT; ++j)
+            exits[block * RISA_TODLR_REGISTER_COUNT + j] = numbers[j];
+    }
+
+    RISA_MEM_FREE(exits);
+    RISA_MEM_FREE(marks);
+    RISA_MEM_FREE(expressions);
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_coalesce_registers(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    bool changed = false;
+    uint64_t live[RISA_OPTIMIZER_REGISTER_WORDS];
+
+    risa_cluster_optimizer_compute_liveness(optimizer);
+
+    // Remove the values that are never read. Only instructions that can't fail are removed.
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i] || optimizer->guarded[i])
+            continue;
+
+        uint8_t* instruction = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+        bool removable = optimizer->proven[i];
+
+        switch(op) {
+            case RISA_OP_CNST:
+            case RISA_OP_CNSTW:
+            case RISA_OP_MOV:
+            case RISA_OP_NULL:
+            case RISA_OP_TRUE:
+            case RISA_OP_FALSE:
+            case RISA_OP_ARR:
+            case RISA_OP_OBJ:
+            case RISA_OP_NOT:
+            case RISA_OP_EQ:
+            case RISA_OP_NEQ:
+                removable = true;
+                break;
+            default:
+                break;
+        }
+
+        if(removable) {
+            risa_cluster_optimizer_live_after(optimizer, i, live);
+
+            if(!RISA_OPTIMIZER_REGISTER_HAS(live, instruction[1])) {
+                optimizer->live[i] = false;
+                changed = true;
+            }
+        }
+    }
+
+    // Removing instructions only shortens the live ranges, so the liveness can still be used to coalesce
+    // 'OP a ...; MOV b a' into 'OP b ...' when 'a' is not read afterwards.
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i] || optimizer->guarded[i])
+            continue;
+
+        uint8_t* instruction = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint32_t next = optimizer->next[i];
+
+        if(!risa_op_has_direct_dest(risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK)) || next >= count)
+            continue;
+
+        uint8_t* mov = &bytecode[next * RISA_TODLR_INSTRUCTION_SIZE];
+
+        if(mov[0] != RISA_OP_MOV || mov[2] != instruction[1] || mov[1] == instruction[1] || optimizer->labels[next] || optimizer->guarded[next])
+            continue;
+
+        risa_cluster_optimizer_live_after(optimizer, next, live);
+
+        if(RISA_OPTIMIZER_REGISTER_HAS(live, instruction[1]))
+            continue;
+
+        instruction[1] = mov[1];
+        optimizer->live[next] = false;
+        changed = true;
+    }
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_hoist_invariants(RisaClusterOptimizer* optimizer, const RisaValueArray* written) {
+    uint32_t count = optimizer->count;
+    RisaCluster* cluster = optimizer->cluster;
+    uint8_t* bytecode = cluster->bytecode;
+
+    risa_cluster_optimizer_refresh(optimizer);
+    risa_cluster_optimizer_build_blocks(optimizer);
+    risa_cluster_optimizer_compute_liveness(optimizer);
+
+    RisaClusterOptimizerBlock* blocks = optimizer->blocks;
+    uint32_t blockCount = optimizer->blockCount;
+
+    uint32_t* marks = (uint32_t*) RISA_MEM_ALLOC(blockCount * sizeof(uint32_t));   // The header of the loop being analyzed.
+    uint32_t* latches = (uint32_t*) RISA_MEM_ALLOC(blockCount * sizeof(uint32_t)); // The blocks that jump back to the header.
+    uint32_t* exits = (uint32_t*) RISA_MEM_ALLOC(blockCount * sizeof(uint32_t));   // The blocks that can leave the loop.
+    uint8_t* plans = (uint8_t*) RISA_MEM_ALLOC(blockCount * sizeof(uint8_t));      // 1 if instructions go before the header, 2 if guarded too.
+    uint32_t* hoists = (uint32_t*) RISA_MEM_ALLOC(count * sizeof(uint32_t));       // The header every instruction goes before.
+    bool* behind = (bool*) RISA_MEM_ALLOC(count * sizeof(bool));                   // Whether the instruction goes after the guard.
+
+    bool changed = false;
+
+    // The registers that appear anywhere in the function.
+    uint64_t used[RISA_OPTIMIZER_REGISTER_WORDS] = { 0 };
+
+    for(uint32_t i = 0; i < RISA_OPTIMIZER_REGISTER_WORDS; ++i)
+        used[i] = optimizer->captured[i];
+
+    for(uint32_t i = 0; i < count; ++i) {
+        uint8_t* instruction = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+        uint8_t reads;
+        uint8_t writes;
+
+        risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if((reads | writes) & (1 << (j - 1)))
+                RISA_OPTIMIZER_REGISTER_ADD(used, instruction[j]);
+
+        if(op == RISA_OP_CALL || op == RISA_OP_TCALL)
+            for(uint16_t j = instruction[1]; j <= instruction[1] + instruction[2] && j < RISA_TODLR_REGISTER_COUNT; ++j)
+                RISA_OPTIMIZER_REGISTER_ADD(used, j);
+    }
+
+    for(uint32_t i = 0; i < blockCount; ++i) {
+        marks[i] = RISA_OPTIMIZER_NO_BLOCK;
+        plans[i] = 0;
+    }
+
+    for(uint32_t i = 0; i < count; ++i) {
+        hoists[i] = RISA_OPTIMIZER_NO_BLOCK;
+        behind[i] = false;
+    }
+
+    for(uint32_t header = 0; header < blockCount; ++header) {
+        uint32_t latchCount = 0;
+        uint32_t exitCount = 0;
+        uint32_t outside = RISA_OPTIMIZER_NO_BLOCK;
+        uint32_t outsideCount = 0;
+
+        for(uint32_t i = optimizer->predecessorStarts[header]; i < optimizer->predecessorStarts[header + 1]; ++i) {
+            uint32_t predecessor = optimizer->predecessors[i];
+
+            if(risa_cluster_optimizer_dominates(optimizer, header, predecessor)) {
+                latches[latchCount++] = predecessor;
+            } else {
+                outside = predecessor;
+                ++outsideCount;
+            }
+        }
+
+        // The instructions are placed right before the header, so the loop must only be entered by falling into it.
+        if(latchCount == 0 || outsideCount != 1 || outside + 1 != header || optimizer->guarded[blocks[header].first])
+            continue;
+
+        uint8_t outsideOp = bytecode[blocks[outside].last * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK;
+
+        if(risa_cluster_optimizer_is_jump(outsideOp) || outsideOp == RISA_OP_TEST || outsideOp == RISA_OP_NTEST || outsideOp == RISA_OP_RET)
+            continue;
+
+        // The loop is made of the blocks that reach a latch without going through the header.
+        uint32_t stackSize = 0;
+
+        marks[header] = header;
+
+        for(uint32_t i = 0; i < latchCount; ++i) {
+            if(marks[latches[i]] != header) {
+                marks[latches[i]] = header;
+                optimizer->worklist[stackSize++] = latches[i];
+            }
+        }
+
+        while(stackSize > 0) {
+            uint32_t block = optimizer->worklist[--stackSize];
+
+            for(uint32_t i = optimizer->predecessorStarts[block]; i < optimizer->predecessorStarts[block + 1]; ++i) {
+                if(marks[optimizer->predecessors[i]] != header) {
+                    marks[optimizer->predecessors[i]] = header;
+                    optimizer->worklist[stackSize++] = optimizer->predecessors[i];
+                }
+            }
+        }
+
+        bool calls = false;
+        bool stores = false;
+        uint16_t lowestCall = RISA_TODLR_REGISTER_COUNT;
+        bool exiting = false; // Whether or not the header can leave the loop.
+
+        uint64_t once[RISA_OPTIMIZER_REGISTER_WORDS] = { 0 };
+        uint64_t many[RISA_OPTIMIZER_REGISTER_WORDS] = { 0 };
+        uint64_t exitLive[RISA_OPTIMIZER_REGISTER_WORDS] = { 0 };
+
+        for(uint32_t block = 0; block < blockCount; ++block) {
+            if(marks[block] != header)
+                continue;
+
+            bool leaves = blocks[block].successors[0] == RISA_OPTIMIZER_NO_BLOCK;
+
+            for(uint8_t i = 0; i < 2; ++i) {
+                uint32_t successor = blocks[block].successors[i];
+
+                if(successor != RISA_OPTIMIZER_NO_BLOCK && marks[successor] != header) {
+                    leaves = true;
+
+                    for(uint32_t j = 0; j < RISA_OPTIMIZER_REGISTER_WORDS; ++j)
+                        exitLive[j] |= optimizer->liveness[blocks[successor].first * RISA_OPTIMIZER_REGISTER_WORDS + j];
+                }
+            }
+
+            if(leaves) {
+                exits[exitCount++] = block;
+                exiting |= block == header;
+            }
+
+            for(uint32_t i = blocks[block].first; i <= blocks[block].last; ++i) {
+                uint8_t* instruction = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+                uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+                uint8_t reads;
+                uint8_t writes;
+
+                risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+                if(writes & RISA_OPTIMIZER_OPERAND_DEST) {
+                    if(RISA_OPTIMIZER_REGISTER_HAS(once, instruction[1]))
+                        RISA_OPTIMIZER_REGISTER_ADD(many, instruction[1]);
+                    else RISA_OPTIMIZER_REGISTER_ADD(once, instruction[1]);
+                }
+
+                // The callee can change any global or array, and uses the registers after the callee as its own.
+                if(op == RISA_OP_CALL || op == RISA_OP_TCALL) {
+                    calls = true;
+
+                    if(instruction[1] < lowestCall)
+                        lowestCall = instruction[1];
+
+                    for(uint16_t j = instruction[1]; j < RISA_TODLR_REGISTER_COUNT; ++j)
+                        RISA_OPTIMIZER_REGISTER_ADD(many, j);
+                }
+
+                if(op == RISA_OP_PARR || op == RISA_OP_SET)
+                    stores = true;
+            }
+        }
+
+        // A header that ends with 'TEST; JMP exit' can be copied in front of the loop, so the instructions that can
+        // fail are only reached when the loop runs at least once.
+        uint32_t skipped = blocks[header].successors[0];
+        uint8_t headerOp = bytecode[blocks[header].last * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK;
+
+        bool guardable = (headerOp == RISA_OP_TEST || headerOp == RISA_OP_NTEST)
+                      && skipped != RISA_OPTIMIZER_NO_BLOCK && marks[skipped] != header
+                      && blocks[skipped].first == blocks[skipped].last
+                      && risa_cluster_optimizer_is_jump(bytecode[blocks[skipped].first * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK)
+                      && blocks[header].successors[1] != RISA_OPTIMIZER_NO_BLOCK && marks[blocks[header].successors[1]] == header;
+
+        for(uint32_t i = blocks[header].first; guardable && i <= blocks[header].last; ++i)
+            guardable = risa_cluster_optimizer_is_repeatable(risa_op_dequicken(bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK));
+
+        const uint64_t* headerLive = &optimizer->liveness[blocks[header].first * RISA_OPTIMIZER_REGISTER_WORDS];
+
+        for(uint32_t block = 0; block < blockCount; ++block) {
+            if(marks[block] != header)
+                continue;
+
+            // Whether or not the block runs in every iteration, before the loop can be left. The header always does.
+            bool always = true;
+
+            for(uint32_t i = 0; block != header && i < latchCount; ++i)
+                always &= risa_cluster_optimizer_dominates(optimizer, block, latches[i]);
+
+            for(uint32_t i = 0; block != header && i < exitCount; ++i)
+                if(exits[i] != header || !guardable)
+                    always &= risa_cluster_optimizer_dominates(optimizer, block, exits[i]);
+
+            for(uint32_t i = blocks[block].first; i <= blocks[block].last; ++i) {
+                uint8_t* instruction = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+                uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+                uint8_t dest = instruction[1];
+
+                if(optimizer->guarded[i] || hoists[i] != RISA_OPTIMIZER_NO_BLOCK)
+                    continue;
+
+                if(op != RISA_OP_CNST && op != RISA_OP_CNSTW && op != RISA_OP_GGLOB && op != RISA_OP_LEN)
+                    continue;
+
+                if(RISA_OPTIMIZER_REGISTER_HAS(optimizer->captured, dest))
+                    continue;
+
+                bool invariant = true;
+
+                if(op == RISA_OP_GGLOB) {
+                    RisaValue name = cluster->constants.values[instruction[2]];
+
+                    invariant = !calls || !risa_cluster_optimizer_has_global(written, name);
+
+                    for(uint32_t j = 0; invariant && j < blockCount; ++j) {
+                        if(marks[j] != header)
+                            continue;
+
+                        for(uint32_t k = blocks[j].first; invariant && k <= blocks[j].last; ++k) {
+                            uint8_t* store = &bytecode[k * RISA_TODLR_INSTRUCTION_SIZE];
+                            uint8_t storeOp = store[0] & RISA_TODLR_INSTRUCTION_MASK;
+
+                            if((storeOp == RISA_OP_SGLOB || storeOp == RISA_OP_DGLOB) && risa_value_equals(cluster->constants.values[store[1]], name))
+                                invariant = false;
+                        }
+                    }
+                } else if(op == RISA_OP_LEN) {
+                    uint8_t array = instruction[2];
+
+                    invariant = !calls && !stores
+                             && !RISA_OPTIMIZER_REGISTER_HAS(once, array) && !RISA_OPTIMIZER_REGISTER_HAS(many, array)
+                             && !RISA_OPTIMIZER_REGISTER_HAS(optimizer->captured, array);
+                }
+
+                // Constants can't fail, so they can always be hoisted.
+                bool fails = op == RISA_OP_GGLOB || op == RISA_OP_LEN;
+
+                if(!invariant || (fails && !always))
+                    continue;
+
+                // The register must keep the value for the whole loop, and nothing may need its previous value.
+                // Otherwise, the value is moved to an unused register that the calls in the loop don't overwrite.
+                if(RISA_OPTIMIZER_REGISTER_HAS(many, dest) || RISA_OPTIMIZER_REGISTER_HAS(headerLive, dest) || RISA_OPTIMIZER_REGISTER_HAS(exitLive, dest)) {
+                    uint16_t fresh = 0;
+
+                    while(fresh < lowestCall && RISA_OPTIMIZER_REGISTER_HAS(used, fresh))
+                        ++fresh;
+
+                    if(fresh >= lowestCall || !risa_cluster_optimizer_rename_register(optimizer, i, (uint8_t) fresh))
+                        continue;
+
+                    RISA_OPTIMIZER_REGISTER_ADD(used, fresh);
+
+                    if(fresh + 1 > cluster->registerCount)
+                        cluster->registerCount = (uint8_t) (fresh + 1);
+                }
+
+                hoists[i] = header;
+                behind[i] = fails && block != header && exiting;
+
+                plans[header] = behind[i] ? 2 : plans[header] > 0 ? plans[header] : 1;
+                changed = true;
+            }
+        }
+    }
+
+    if(changed) {
+        uint32_t extra = 0;
+
+        for(uint32_t i = 0; i < blockCount; ++i) {
+            if(plans[i] != 2)
+                continue;
+
+            // The guard is a copy of the header, without the hoisted instructions, and of the jump out of the loop.
+            for(uint32_t j = blocks[i].first; j <= blocks[i].last; ++j)
+                if(hoists[j] == RISA_OPTIMIZER_NO_BLOCK)
+                    ++extra;
+
+            ++extra;
+        }
+
+        uint8_t* newBytecode = (uint8_t*) RISA_MEM_ALLOC((count + extra) * RISA_TODLR_INSTRUCTION_SIZE);
+        uint32_t* newIndices = (uint32_t*) RISA_MEM_ALLOC((count + extra) * RISA_TODLR_INSTRUCTION_SIZE * sizeof(uint32_t));
+        uint32_t* newTargets = (uint32_t*) RISA_MEM_ALLOC((count + extra) * sizeof(uint32_t));
+        uint32_t* positions = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+
+        uint32_t size = 0;
+
+        for(uint32_t i = 0; i < count; ++i) {
+            uint32_t header = optimizer->blockOf[i];
+
+            if(blocks[header].first == i && plans[header] > 0) {
+                for(uint32_t j = 0; j < count; ++j) {
+                    if(hoists[j] == header && !behind[j]) {
+                        newTargets[size] = count + 1;
+                        risa_cluster_optimizer_copy_instruction(cluster, j, newBytecode, newIndices, size++);
+                    }
+                }
+
+                if(plans[header] == 2) {
+                    for(uint32_t j = blocks[header].first; j <= blocks[header].last; ++j) {
+                        if(hoists[j] == RISA_OPTIMIZER_NO_BLOCK) {
+                            newTargets[size] = count + 1;
+                            risa_cluster_optimizer_copy_instruction(cluster, j, newBytecode, newIndices, size++);
+                        }
+                    }
+
+                    uint32_t jump = blocks[blocks[header].successors[0]].first;
+
+                    newTargets[size] = optimizer->targets[jump];
+                    risa_cluster_optimizer_copy_instruction(cluster, jump, newBytecode, newIndices, size++);
+                }
+
+                for(uint32_t j = 0; j < count; ++j) {
+                    if(hoists[j] == header && behind[j]) {
+                        newTargets[size] = count + 1;
+                        risa_cluster_optimizer_copy_instruction(cluster, j, newBytecode, newIndices, size++);
+                    }
+                }
+            }
+
+            if(hoists[i] != RISA_OPTIMIZER_NO_BLOCK) {
+                positions[i] = UINT32_MAX;
+                continue;
+            }
+
+            newTargets[size] = risa_cluster_optimizer_is_jump(bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK) ? optimizer->targets[i] : count + 1;
+            positions[i] = size;
+
+            risa_cluster_optimizer_copy_instruction(cluster, i, newBytecode, newIndices, size++);
+        }
+
+        // Jumps to a hoisted instruction go to whatever followed it.
+        positions[count] = size;
+
+        for(uint32_t i = count; i > 0; --i)
+            if(positions[i - 1] == UINT32_MAX)
+                positions[i - 1] = positions[i];
+
+        for(uint32_t i = 0; i < size && changed; ++i) {
+            if(newTargets[i] > count)
+                continue;
+
+            uint32_t target = positions[newTargets[i]];
+
+            // The jumps only get longer by the size of the guards, but they still have to fit in a word.
+            if((target > i ? target - i - 1 : i - target) > UINT16_MAX)
+                changed = false;
+            else risa_cluster_optimizer_encode_jump(&newBytecode[i * RISA_TODLR_INSTRUCTION_SIZE], i, target);
+        }
+
+        if(changed) {
+            RISA_MEM_FREE(cluster->bytecode);
+            RISA_MEM_FREE(cluster->indices);
+
+            cluster->bytecode = newBytecode;
+            cluster->indices = newIndices;
+            cluster->size = size * RISA_TODLR_INSTRUCTION_SIZE;
+            cluster->capacity = cluster->size;
+        } else {
+            RISA_MEM_FREE(newBytecode);
+            RISA_MEM_FREE(newIndices);
+        }
+
+        RISA_MEM_FREE(newTargets);
+        RISA_MEM_FREE(positions);
+    }
+
+    RISA_MEM_FREE(marks);
+    RISA_MEM_FREE(latches);
+    RISA_MEM_FREE(exits);
+    RISA_MEM_FREE(plans);
+    RISA_MEM_FREE(hoists);
+    RISA_MEM_FREE(behind);
+
+    return changed;
+}
+
+static bool risa_cluster_optimizer_rename_register(RisaClusterOptimizer* optimizer, uint32_t instruction, uint8_t reg) {
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+    uint8_t dest = bytecode[instruction * RISA_TODLR_INSTRUCTION_SIZE + 1];
+
+    RisaClusterOptimizerBlock* block = &optimizer->blocks[optimizer->blockOf[instruction]];
+
+    // The value may only be read in the rest of its block, and never as a call argument.
+    uint32_t end = block->last + 1;
+
+    for(uint32_t i = instruction + 1; i <= block->last && end > block->last; ++i) {
+        uint8_t* current = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t op = risa_op_dequicken(current[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+        uint8_t reads;
+        uint8_t writes;
+
+        risa_cluster_optimizer_register_operands(current, &reads, &writes);
+
+        if((op == RISA_OP_CALL || op == RISA_OP_TCALL) && dest >= current[1] && dest <= current[1] + current[2])
+            return false;
+
+        if((writes & RISA_OPTIMIZER_OPERAND_DEST) && current[1] == dest)
+            end = i;
+    }
+
+    if(end > block->last) {
+        for(uint8_t i = 0; i < 2; ++i) {
+            uint32_t successor = block->successors[i];
+
+            if(successor != RISA_OPTIMIZER_NO_BLOCK && RISA_OPTIMIZER_REGISTER_HAS(&optimizer->liveness[optimizer->blocks[successor].first * RISA_OPTIMIZER_REGISTER_WORDS], dest))
+                return false;
+        }
+
+        end = block->last;
+    }
+
+    for(uint32_t i = instruction + 1; i <= end; ++i) {
+        uint8_t* current = &bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+
+        uint8_t reads;
+        uint8_t writes;
+
+        risa_cluster_optimizer_register_operands(current, &reads, &writes);
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if((reads & (1 << (j - 1))) && current[j] == dest)
+                current[j] = reg;
+    }
+
+    bytecode[instruction * RISA_TODLR_INSTRUCTION_SIZE + 1] = reg;
+    return true;
+}
+
+static void risa_cluster_optimizer_compute_liveness(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    uint64_t live[RISA_OPTIMIZER_REGISTER_WORDS];
+
+    for(uint32_t i = 0; i < count * RISA_OPTIMIZER_REGISTER_WORDS; ++i)
+        optimizer->liveness[i] = 0;
+
+    // A register is live before an instruction if the instruction reads it, or if it is live after the instruction
+    // and the instruction doesn't overwrite it. Loops need more than one pass.
+    for(bool changed = true; changed; ) {
+        changed = false;
+
+        for(uint32_t i = count; i > 0; --i) {
+            if(!optimizer->live[i - 1])
+                continue;
+
+            uint8_t* instruction = &bytecode[(i - 1) * RISA_TODLR_INSTRUCTION_SIZE];
+            uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+            uint8_t reads;
+            uint8_t writes;
+
+            risa_cluster_optimizer_live_after(optimizer, i - 1, live);
+            risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+            if(writes & RISA_OPTIMIZER_OPERAND_DEST)
+                RISA_OPTIMIZER_REGISTER_DEL(live, instruction[1]);
+
+            for(uint8_t j = 1; j <= 3; ++j)
+                if(reads & (1 << (j - 1)))
+                    RISA_OPTIMIZER_REGISTER_ADD(live, instruction[j]);
+
+            // Calls also read their arguments, which follow the callee.
+            if(op == RISA_OP_CALL || op == RISA_OP_TCALL)
+                for(uint16_t j = instruction[1]; j <= instruction[1] + instruction[2]; ++j)
+                    RISA_OPTIMIZER_REGISTER_ADD(live, j);
+
+            uint64_t* before = &optimizer->liveness[(i - 1) * RISA_OPTIMIZER_REGISTER_WORDS];
+
+            for(uint32_t j = 0; j < RISA_OPTIMIZER_REGISTER_WORDS; ++j) {
+                if(before[j] != live[j]) {
+                    before[j] = live[j];
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+static void risa_cluster_optimizer_live_after(RisaClusterOptimizer* optimizer, uint32_t instruction, uint64_t* live) {
+    uint32_t count = optimizer->count;
+    uint32_t successors[2] = { count, count };
+
+    switch(optimizer->cluster->bytecode[instruction * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK) {
+        case RISA_OP_RET:
+            break;
+        case RISA_OP_JMP:
+        case RISA_OP_JMPW:
+        case RISA_OP_BJMP:
+        case RISA_OP_BJMPW:
+            successors[0] = optimizer->resolved[optimizer->targets[instruction]];
+            break;
+        case RISA_OP_TEST:
+        case RISA_OP_NTEST:
+            successors[0] = optimizer->next[instruction];
+            successors[1] = optimizer->next[successors[0]];
+            break;
+        default:
+            successors[0] = optimizer->next[instruction];
+            break;
+    }
+
+    for(uint32_t i = 0; i < RISA_OPTIMIZER_REGISTER_WORDS; ++i) {
+        live[i] = optimizer->captured[i];
+
+        for(uint8_t j = 0; j < 2; ++j)
+            if(successors[j] < count)
+                live[i] |= optimizer->liveness[successors[j] * RISA_OPTIMIZER_REGISTER_WORDS + i];
+    }
+}
+
+static void risa_cluster_optimizer_build_blocks(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    uint8_t* bytecode = optimizer->cluster->bytecode;
+
+    RisaClusterOptimizerBlock* blocks = optimizer->blocks;
+    uint32_t blockCount = 0;
+
+    // A block starts at every label, and after every instruction that doesn't fall through.
+    bool leader = true;
+
+    for(uint32_t i = optimizer->resolved[0]; i < count; i = optimizer->next[i]) {
+        uint8_t op = bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK;
+
+        if(leader || optimizer->labels[i]) {
+            if(blockCount > 0)
+                blocks[blockCount - 1].last = optimizer->prev[i];
+
+            blocks[blockCount++].first = i;
+        }
+
+        optimizer->blockOf[i] = blockCount - 1;
+        leader = risa_cluster_optimizer_is_jump(op) || op == RISA_OP_TEST || op == RISA_OP_NTEST || op == RISA_OP_RET;
+    }
+
+    if(blockCount > 0)
+        blocks[blockCount - 1].last = optimizer->prev[count];
+
+    optimizer->blockCount = blockCount;
+
+    for(uint32_t i = 0; i <= blockCount; ++i)
+        optimizer->predecessorStarts[i] = 0;
+
+    for(uint32_t i = 0; i < blockCount; ++i) {
+        uint32_t last = blocks[i].last;
+        uint32_t successors[2] = { count, count };
+
+        switch(bytecode[last * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK) {
+            case RISA_OP_RET:
+                break;
+            case RISA_OP_JMP:
+            case RISA_OP_JMPW:
+            case RISA_OP_BJMP:
+            case RISA_OP_BJMPW:
+                successors[0] = optimizer->resolved[optimizer->targets[last]];
+                break;
+            case RISA_OP_TEST:
+            case RISA_OP_NTEST:
+                successors[0] = optimizer->next[last];
+                successors[1] = optimizer->next[successors[0]];
+                break;
+            default:
+                successors[0] = optimizer->next[last];
+                break;
+        }
+
+        for(uint8_t j = 0; j < 2; ++j) {
+            blocks[i].successors[j] = successors[j] < count ? optimizer->blockOf[successors[j]] : RISA_OPTIMIZER_NO_BLOCK;
+
+            if(blocks[i].successors[j] != RISA_OPTIMIZER_NO_BLOCK)
+                ++optimizer->predecessorStarts[blocks[i].successors[j] + 1];
+        }
+
+        blocks[i].idom = RISA_OPTIMIZER_NO_BLOCK;
+        optimizer->ranks[i] = RISA_OPTIMIZER_NO_BLOCK;
+
+        uint64_t* defs = &optimizer->defs[i * RISA_OPTIMIZER_REGISTER_WORDS];
+
+        for(uint32_t j = 0; j < RISA_OPTIMIZER_REGISTER_WORDS; ++j)
+            defs[j] = 0;
+
+        for(uint32_t j = blocks[i].first; j < count; j = optimizer->next[j]) {
+            uint8_t* instruction = &bytecode[j * RISA_TODLR_INSTRUCTION_SIZE];
+            uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+            uint8_t reads;
+            uint8_t writes;
+
+            risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+            if(writes & RISA_OPTIMIZER_OPERAND_DEST)
+                RISA_OPTIMIZER_REGISTER_ADD(defs, instruction[1]);
+
+            if(op == RISA_OP_CALL || op == RISA_OP_TCALL)
+                for(uint16_t k = instruction[1]; k < RISA_TODLR_REGISTER_COUNT; ++k)
+                    RISA_OPTIMIZER_REGISTER_ADD(defs, k);
+
+            if(j == blocks[i].last)
+                break;
+        }
+    }
+
+    for(uint32_t i = 0; i < blockCount; ++i)
+        optimizer->predecessorStarts[i + 1] += optimizer->predecessorStarts[i];
+
+    // Fill the predecessors, using the ranks to count the ones already written.
+    for(uint32_t i = 0; i < blockCount; ++i)
+        optimizer->ranks[i] = 0;
+
+    for(uint32_t i = 0; i < blockCount; ++i) {
+        for(uint8_t j = 0; j < 2; ++j) {
+            uint32_t successor = blocks[i].successors[j];
+
+            if(successor != RISA_OPTIMIZER_NO_BLOCK)
+                optimizer->predecessors[optimizer->predecessorStarts[successor] + optimizer->ranks[successor]++] = i;
+        }
+    }
+
+    // Depth-first search from the entry for the postorder. The ranks hold how many successors were visited + 1.
+    uint32_t* stack = optimizer->worklist;
+    uint32_t stackSize = 0;
+
+    optimizer->orderCount = 0;
+
+    for(uint32_t i = 0; i < blockCount; ++i)
+        optimizer->ranks[i] = 0;
+
+    if(blockCount > 0) {
+        stack[stackSize++] = 0;
+        optimizer->ranks[0] = 1;
+    }
+
+    while(stackSize > 0) {
+        uint32_t block = stack[stackSize - 1];
+
+        if(optimizer->ranks[block] <= 2) {
+            uint32_t successor = blocks[block].successors[optimizer->ranks[block]++ - 1];
+
+            if(successor != RISA_OPTIMIZER_NO_BLOCK && optimizer->ranks[successor] == 0) {
+                optimizer->ranks[successor] = 1;
+                stack[stackSize++] = successor;
+            }
+        } else {
+            optimizer->order[optimizer->orderCount++] = block;
+            --stackSize;
+        }
+    }
+
+    for(uint32_t i = 0; i < optimizer->orderCount / 2; ++i) {
+        uint32_t swap = optimizer->order[i];
+
+        optimizer->order[i] = optimizer->order[optimizer->orderCount - 1 - i];
+        optimizer->order[optimizer->orderCount - 1 - i] = swap;
+    }
+
+    for(uint32_t i = 0; i < blockCount; ++i)
+        optimizer->ranks[i] = RISA_OPTIMIZER_NO_BLOCK;
+
+    for(uint32_t i = 0; i < optimizer->orderCount; ++i)
+        optimizer->ranks[optimizer->order[i]] = i;
+
+    // Dominators, as described in 'A Simple, Fast Dominance Algorithm' by Cooper, Harvey and Kennedy.
+    if(optimizer->orderCount > 0)
+        blocks[optimizer->order[0]].idom = optimizer->order[0];
+
+    for(bool changed = true; changed; ) {
+        changed = false;
+
+        for(uint32_t i = 1; i < optimizer->orderCount; ++i) {
+            uint32_t block = optimizer->order[i];
+            uint32_t idom = RISA_OPTIMIZER_NO_BLOCK;
+
+            for(uint32_t j = optimizer->predecessorStarts[block]; j < optimizer->predecessorStarts[block + 1]; ++j) {
+                uint32_t predecessor = optimizer->predecessors[j];
+
+                if(blocks[predecessor].idom == RISA_OPTIMIZER_NO_BLOCK)
+                    continue;
+
+                idom = idom == RISA_OPTIMIZER_NO_BLOCK ? predecessor : risa_cluster_optimizer_intersect(optimizer, predecessor, idom);
+            }
+
+            if(blocks[block].idom != idom) {
+                blocks[block].idom = idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+static bool risa_cluster_optimizer_dominates(RisaClusterOptimizer* optimizer, uint32_t dominator, uint32_t block) {
+    // Only the entry block dominates itself.
+    while(block != dominator && block != RISA_OPTIMIZER_NO_BLOCK && optimizer->blocks[block].idom != block)
+        block = optimizer->blocks[block].idom;
+
+    return block == dominator;
+}
+
+static uint32_t risa_cluster_optimizer_intersect(RisaClusterOptimizer* optimizer, uint32_t left, uint32_t right) {
+    while(left != right) {
+        while(optimizer->ranks[left] > optimizer->ranks[right])
+            left = optimizer->blocks[left].idom;
+        while(optimizer->ranks[right] > optimizer->ranks[left])
+            right = optimizer->blocks[right].idom;
+    }
+
+    return left;
+}
+
+static RisaClusterOptimizerExpression* risa_cluster_optimizer_find_expression(RisaClusterOptimizerExpression* expressions, uint32_t capacity, uint8_t op, uint32_t left, uint32_t right) {
+    uint32_t index = ((op * 31 + left) * 2654435761u ^ right * 2246822519u) & (capacity - 1);
+
+    // Returns the matching expression, or the empty slot where it should go.
+    while(expressions[index].op != 0) {
+        if(expressions[index].op == op && expressions[index].left == left && expressions[index].right == right)
+            break;
+
+        index = (index + 1) & (capacity - 1);
+    }
+
+    return &expressions[index];
+}
+
+static void risa_cluster_optimizer_emit(RisaClusterOptimizer* optimizer) {
+    uint32_t count = optimizer->count;
+    RisaCluster* cluster = optimizer->cluster;
+
+    // Reuse the worklist to map old instruction indices to new ones.
+    uint32_t* positions = optimizer->worklist;
+    uint32_t size = 0;
+
+    for(uint32_t i = 0; i < count; ++i)
+        positions[i] = optimizer->live[i] ? size++ : 0;
+
+    positions[count] = size;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!optimizer->live[i])
+            continue;
+
+        uint32_t from = i * RISA_TODLR_INSTRUCTION_SIZE;
+        uint32_t to = positions[i] * RISA_TODLR_INSTRUCTION_SIZE;
+
+        // The indices travel with their instructions, so errors still point at the right source.
+        for(uint32_t j = 0; j < RISA_TODLR_INSTRUCTION_SIZE; ++j) {
+            cluster->bytecode[to + j] = cluster->bytecode[from + j];
+            cluster->indices[to + j] = cluster->indices[from + j];
+        }
+
+        uint8_t* instruction = &cluster->bytecode[to];
+
+        if(!risa_cluster_optimizer_is_jump(instruction[0] & RISA_TODLR_INSTRUCTION_MASK))
+            continue;
+
+        risa_cluster_optimizer_encode_jump(instruction, positions[i], positions[optimizer->resolved[optimizer->targets[i]]]);
+    }
+
+    cluster->size = size * RISA_TODLR_INSTRUCTION_SIZE;
+}
+
+static void risa_cluster_optimizer_encode_jump(uint8_t* instruction, uint32_t from, uint32_t to) {
+    uint32_t amount = to > from ? to - from - 1 : from - to;
+    bool forward = to > from;
+
+    instruction[1] = 0;
+    instruction[2] = 0;
+    instruction[3] = 0;
+
+    if(amount <= UINT8_MAX) {
+        instruction[0] = forward ? RISA_OP_JMP : RISA_OP_BJMP;
+        instruction[1] = (uint8_t) amount;
+    } else {
+        instruction[0] = forward ? RISA_OP_JMPW : RISA_OP_BJMPW;
+        risa_op_write_word(instruction + 1, (uint16_t) amount);
+    }
+}
+
+static void risa_cluster_optimizer_allocate_registers(RisaCluster* cluster, uint8_t arity) {
+    // After the MOVs are coalesced, some registers are no longer used. The remaining ones are renumbered in order,
+    // which keeps the arguments of every call after its callee, and every value that lives across a call below it.
+    // This only shrinks the frames of clusters that already compiled. Registers are reused while compiling, where the
+    // locals that are never read again give theirs to the ones declared after them.
+    uint64_t used[RISA_OPTIMIZER_REGISTER_WORDS] = { 0 };
+    uint8_t remap[RISA_TODLR_REGISTER_COUNT];
+
+    for(uint8_t i = 0; i < arity && i < RISA_TODLR_REGISTER_COUNT; ++i)
+        RISA_OPTIMIZER_REGISTER_ADD(used, i);
+
+    for(uint32_t i = 0; i + RISA_TODLR_INSTRUCTION_SIZE <= cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        uint8_t* instruction = &cluster->bytecode[i];
+        uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+        uint8_t reads;
+        uint8_t writes;
+
+        risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if((reads | writes) & (1 << (j - 1)))
+                RISA_OPTIMIZER_REGISTER_ADD(used, instruction[j]);
+
+        if(op == RISA_OP_CALL || op == RISA_OP_TCALL)
+            for(uint16_t j = instruction[1]; j <= instruction[1] + instruction[2]; ++j)
+                RISA_OPTIMIZER_REGISTER_ADD(used, j);
+    }
+
+    uint8_t registerCount = 0;
+
+    for(uint8_t i = 0; i < RISA_TODLR_REGISTER_COUNT; ++i) {
+        remap[i] = registerCount;
+
+        if(RISA_OPTIMIZER_REGISTER_HAS(used, i))
+            ++registerCount;
+    }
+
+    for(uint32_t i = 0; i + RISA_TODLR_INSTRUCTION_SIZE <= cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        uint8_t* instruction = &cluster->bytecode[i];
+
+        uint8_t reads;
+        uint8_t writes;
+
+        risa_cluster_optimizer_register_operands(instruction, &reads, &writes);
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if((reads | writes) & (1 << (j - 1)))
+                instruction[j] = remap[instruction[j]];
+
+        // CUPVAL closes every upvalue at or above its register, which is exactly where the next used register goes.
+        if(instruction[0] == RISA_OP_CUPVAL && instruction[1] < RISA_TODLR_REGISTER_COUNT)
+            instruction[1] = remap[instruction[1]];
+    }
+
+    if(registerCount < cluster->registerCount)
+        cluster->registerCount = registerCount;
+}
+
+static void risa_cluster_optimizer_compact_constants(RisaCluster* cluster) {
+    uint32_t constantCount = cluster->constants.size;
+
+    if(constantCount == 0)
+        return;
+
+    uint32_t* remap = (uint32_t*) RISA_MEM_ALLOC(constantCount * sizeof(uint32_t));
+
+    for(uint32_t i = 0; i < constantCount; ++i)
+        remap[i] = UINT32_MAX;
+
+    for(uint32_t i = 0; i + RISA_TODLR_INSTRUCTION_SIZE <= cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        uint8_t* instruction = &cluster->bytecode[i];
+        uint8_t operands = risa_cluster_optimizer_constant_operands(instruction);
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if((operands & (1 << (j - 1))) && instruction[j] < constantCount)
+                remap[instruction[j]] = 0;
+
+        if((operands & RISA_OPTIMIZER_OPERAND_WORD) && risa_op_read_word(instruction + 2) < constantCount)
+            remap[risa_op_read_word(instruction + 2)] = 0;
+    }
+
+    RisaValueArray constants;
+    risa_value_array_init(&constants);
+
+    for(uint32_t i = 0; i < constantCount; ++i) {
+        if(remap[i] != UINT32_MAX) {
+            remap[i] = constants.size;
+            risa_value_array_write(&constants, cluster->constants.values[i]);
+        }
+    }
+
+    for(uint32_t i = 0; i + RISA_TODLR_INSTRUCTION_SIZE <= cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        uint8_t* instruction = &cluster->bytecode[i];
+        uint8_t operands = risa_cluster_optimizer_constant_operands(instruction);
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if((operands & (1 << (j - 1))) && instruction[j] < constantCount)
+                instruction[j] = (uint8_t) remap[instruction[j]];
+
+        if((operands & RISA_OPTIMIZER_OPERAND_WORD) && risa_op_read_word(instruction + 2) < constantCount) {
+            uint32_t index = remap[risa_op_read_word(instruction + 2)];
+
+            // The constant may now fit in a regular CNST.
+            if(index <= UINT8_MAX) {
+                instruction[0] = RISA_OP_CNST;
+                instruction[2] = (uint8_t) index;
+                instruction[3] = 0;
+            } else risa_op_write_word(instruction + 2, (uint16_t) index);
+        }
+    }
+
+    risa_value_array_delete(&cluster->constants);
+    cluster->constants = constants;
+
+    RISA_MEM_FREE(remap);
+}
+
+static void risa_cluster_optimizer_collect_globals(RisaCluster* cluster, RisaValueArray* written) {
+    for(uint32_t i = 0; i + RISA_TODLR_INSTRUCTION_SIZE <= cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        uint8_t* instruction = &cluster->bytecode[i];
+        uint8_t op = instruction[0] & RISA_TODLR_INSTRUCTION_MASK;
+
+        if((op == RISA_OP_SGLOB || op == RISA_OP_DGLOB) && instruction[1] < cluster->constants.size
+        && !risa_cluster_optimizer_has_global(written, cluster->constants.values[instruction[1]]))
+            risa_value_array_write(written, cluster->constants.values[instruction[1]]);
+    }
+
+    for(uint32_t i = 0; i < cluster->constants.size; ++i)
+        if(risa_value_is_dense_of_type(cluster->constants.values[i], RISA_DVAL_FUNCTION))
+            risa_cluster_optimizer_collect_globals(&((RisaDenseFunction*) risa_value_as_dense(cluster->constants.values[i]))->cluster, written);
+}
+
+static bool risa_cluster_optimizer_has_global(const RisaValueArray* globals, RisaValue name) {
+    for(uint32_t i = 0; i < globals->size; ++i)
+        if(risa_value_equals(globals->values[i], name))
+            return true;
+
+    return false;
+}
+
+static void risa_cluster_optimizer_find_inlinable(RisaCluster* cluster, const RisaValueArray* written, RisaValueArray* names, RisaValueArray* functions) {
+    uint32_t count = cluster->size / RISA_TODLR_INSTRUCTION_SIZE;
+
+    if(count == 0)
+        return;
+
+    RisaClusterOptimizer optimizer;
+    risa_cluster_optimizer_init(&optimizer, cluster);
+    risa_cluster_optimizer_refresh(&optimizer);
+
+    // Globals that are defined or set more than once may hold another function when they are called.
+    RisaValueArray seen;
+    RisaValueArray repeated;
+
+    risa_value_array_init(&seen);
+    risa_value_array_init(&repeated);
+
+    for(uint32_t i = 0; i < count; ++i) {
+        uint8_t* instruction = &cluster->bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+        if((op != RISA_OP_DGLOB && op != RISA_OP_SGLOB) || instruction[1] >= cluster->constants.size)
+            continue;
+
+        RisaValue name = cluster->constants.values[instruction[1]];
+
+        if(!risa_cluster_optimizer_has_global(&seen, name))
+            risa_value_array_write(&seen, name);
+        else if(!risa_cluster_optimizer_has_global(&repeated, name))
+            risa_value_array_write(&repeated, name);
+    }
+
+    for(uint32_t i = 0; i < count; ++i) {
+        uint8_t* instruction = &cluster->bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t* previous = instruction - RISA_TODLR_INSTRUCTION_SIZE;
+
+        if((instruction[0] & RISA_TODLR_INSTRUCTION_MASK) != RISA_OP_DGLOB || instruction[1] >= cluster->constants.size)
+            continue;
+
+        RisaValue name = cluster->constants.values[instruction[1]];
+        RisaValue value = risa_value_from_null();
+
+        // Function declarations load the function right before defining it.
+        if(instruction[0] & RISA_TODLR_TYPE_LEFT_MASK) {
+            if(instruction[2] < cluster->constants.size)
+                value = cluster->constants.values[instruction[2]];
+        } else if(i > 0 && !optimizer.labels[i] && previous[0] == RISA_OP_CNST && previous[1] == instruction[2] && previous[2] < cluster->constants.size) {
+            value = cluster->constants.values[previous[2]];
+        }
+
+        if(!risa_value_is_dense_of_type(value, RISA_DVAL_FUNCTION) || risa_cluster_optimizer_has_global(&repeated, name) || risa_cluster_optimizer_has_global(written, name))
+            continue;
+
+        if(risa_cluster_optimizer_is_inlinable((RisaDenseFunction*) risa_value_as_dense(value))) {
+            risa_value_array_write(names, name);
+            risa_value_array_write(functions, value);
+        }
+    }
+
+    risa_value_array_delete(&seen);
+    risa_value_array_delete(&repeated);
+
+    risa_cluster_optimizer_delete(&optimizer);
+}
+
+static void risa_cluster_optimizer_inline_calls(RisaCluster* cluster, const RisaValueArray* names, const RisaValueArray* functions) {
+    uint32_t count = cluster->size / RISA_TODLR_INSTRUCTION_SIZE;
+
+    if(count > 0 && names->size > 0 && risa_cluster_optimizer_is_analyzable(cluster)) {
+        RisaClusterOptimizer optimizer;
+        risa_cluster_optimizer_init(&optimizer, cluster);
+        risa_cluster_optimizer_refresh(&optimizer);
+
+        RisaDenseFunction** callees = (RisaDenseFunction**) RISA_MEM_ALLOC(count * sizeof(RisaDenseFunction*));
+        uint32_t extra = 0;
+
+        // Every instruction of the callee takes at most two instructions in the caller.
+        for(uint32_t i = 0; i < count; ++i) {
+            callees[i] = risa_cluster_optimizer_find_callee(&optimizer, i, names, functions);
+
+            if(callees[i] != NULL)
+                extra += 2 * (callees[i]->cluster.size / RISA_TODLR_INSTRUCTION_SIZE);
+        }
+
+        if(extra > 0) {
+            uint8_t* bytecode = (uint8_t*) RISA_MEM_ALLOC((count + extra) * RISA_TODLR_INSTRUCTION_SIZE);
+            uint32_t* indices = (uint32_t*) RISA_MEM_ALLOC((count + extra) * RISA_TODLR_INSTRUCTION_SIZE * sizeof(uint32_t));
+            uint32_t* origins = (uint32_t*) RISA_MEM_ALLOC((count + extra) * sizeof(uint32_t)); // The original jump, or 'count'.
+            uint32_t* positions = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+
+            uint8_t registerCount = cluster->registerCount;
+            uint32_t size = 0;
+
+            for(uint32_t i = 0; i < count; ++i) {
+                uint8_t* instruction = &cluster->bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+                uint32_t start = size;
+
+                positions[i] = size;
+
+                if(callees[i] != NULL && risa_cluster_optimizer_inline_body(cluster, i, &callees[i]->cluster, bytecode, indices, &size)) {
+                    for(uint32_t j = start; j < size; ++j)
+                        origins[j] = count;
+
+                    if(instruction[1] + 1 + callees[i]->cluster.registerCount > registerCount)
+                        registerCount = (uint8_t) (instruction[1] + 1 + callees[i]->cluster.registerCount);
+
+                    continue;
+                }
+
+                origins[size] = risa_cluster_optimizer_is_jump(instruction[0] & RISA_TODLR_INSTRUCTION_MASK) ? i : count;
+                risa_cluster_optimizer_copy_instruction(cluster, i, bytecode, indices, size++);
+            }
+
+            positions[count] = size;
+
+            bool fits = true;
+
+            for(uint32_t i = 0; i < size && fits; ++i) {
+                if(origins[i] == count)
+                    continue;
+
+                uint32_t target = positions[optimizer.targets[origins[i]]];
+
+                if((target > i ? target - i - 1 : i - target) > UINT16_MAX)
+                    fits = false;
+                else risa_cluster_optimizer_encode_jump(&bytecode[i * RISA_TODLR_INSTRUCTION_SIZE], i, target);
+            }
+
+            // The constants that were added are removed by 'compact_constants' if they end up unused.
+            if(fits) {
+                RISA_MEM_FREE(cluster->bytecode);
+                RISA_MEM_FREE(cluster->indices);
+
+                cluster->bytecode = bytecode;
+                cluster->indices = indices;
+                cluster->size = size * RISA_TODLR_INSTRUCTION_SIZE;
+                cluster->capacity = cluster->size;
+                cluster->registerCount = registerCount;
+            } else {
+                RISA_MEM_FREE(bytecode);
+                RISA_MEM_FREE(indices);
+            }
+
+            RISA_MEM_FREE(origins);
+            RISA_MEM_FREE(positions);
+        }
+
+        RISA_MEM_FREE(callees);
+
+        risa_cluster_optimizer_delete(&optimizer);
+    }
+
+    for(uint32_t i = 0; i < cluster->constants.size; ++i)
+        if(risa_value_is_dense_of_type(cluster->constants.values[i], RISA_DVAL_FUNCTION))
+            risa_cluster_optimizer_inline_calls(&((RisaDenseFunction*) risa_value_as_dense(cluster->constants.values[i]))->cluster, names, functions);
+}
+
+static bool risa_cluster_optimizer_inline_body(RisaCluster* cluster, uint32_t call, RisaCluster* callee, uint8_t* bytecode, uint32_t* indices, uint32_t* size) {
+    uint8_t* instruction = &cluster->bytecode[call * RISA_TODLR_INSTRUCTION_SIZE];
+    uint8_t base = instruction[1];
+    bool tail = (instruction[0] & RISA_TODLR_INSTRUCTION_MASK) == RISA_OP_TCALL;
+
+    uint32_t count = callee->size / RISA_TODLR_INSTRUCTION_SIZE;
+    uint32_t* constants = (uint32_t*) RISA_MEM_ALLOC((callee->constants.size + 1) * sizeof(uint32_t));
+    uint32_t* positions = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+
+    for(uint32_t i = 0; i < callee->constants.size; ++i)
+        constants[i] = risa_cluster_write_constant(cluster, callee->constants.values[i]);
+
+    // Returns become a MOV to the register of the callee and a jump past the body. Tail calls keep them.
+    uint32_t length = 0;
+
+    for(uint32_t i = 0; i < count; ++i) {
+        positions[i] = length;
+        length += ((callee->bytecode[i * RISA_TODLR_INSTRUCTION_SIZE] & RISA_TODLR_INSTRUCTION_MASK) == RISA_OP_RET && !tail && i + 1 < count) ? 2 : 1;
+    }
+
+    positions[count] = length;
+
+    bool fits = true;
+
+    for(uint32_t i = 0; i < count && fits; ++i) {
+        uint8_t* source = &callee->bytecode[i * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t* dest = &bytecode[(*size + positions[i]) * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t op = source[0] & RISA_TODLR_INSTRUCTION_MASK;
+        uint8_t operands = risa_cluster_optimizer_constant_operands(source);
+
+        uint8_t reads;
+        uint8_t writes;
+
+        for(uint32_t j = 0; j < RISA_TODLR_INSTRUCTION_SIZE; ++j)
+            dest[j] = source[j];
+
+        // Errors in the body point to the source of the callee, like they would without inlining.
+        for(uint32_t j = positions[i] * RISA_TODLR_INSTRUCTION_SIZE; j < positions[i + 1] * RISA_TODLR_INSTRUCTION_SIZE; ++j)
+            indices[*size * RISA_TODLR_INSTRUCTION_SIZE + j] = callee->indices[i * RISA_TODLR_INSTRUCTION_SIZE + j % RISA_TODLR_INSTRUCTION_SIZE];
+
+        if(operands & RISA_OPTIMIZER_OPERAND_WORD) {
+            uint16_t index = risa_op_read_word(source + 2);
+
+            if(index >= callee->constants.size || constants[index] > UINT16_MAX)
+                fits = false;
+            else risa_op_write_word(dest + 2, (uint16_t) constants[index]);
+        }
+
+        for(uint8_t j = 1; j <= 3; ++j) {
+            if(!(operands & (1 << (j - 1))))
+                continue;
+
+            if(source[j] >= callee->constants.size || constants[source[j]] > UINT8_MAX)
+                fits = false;
+            else dest[j] = (uint8_t) constants[source[j]];
+        }
+
+        // The registers of the callee start right after it, where the arguments already are.
+        risa_cluster_optimizer_register_operands(source, &reads, &writes);
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if((reads | writes) & (1 << (j - 1)))
+                dest[j] = (uint8_t) (source[j] + base + 1);
+
+        if(risa_cluster_optimizer_is_jump(op)) {
+            uint32_t target = count + 1;
+
+            switch(op) {
+                case RISA_OP_JMP:
+                    target = i + 1 + source[1];
+                    break;
+                case RISA_OP_JMPW:
+                    target = i + 1 + risa_op_read_word(source + 1);
+                    break;
+                case RISA_OP_BJMP:
+                    target = i >= source[1] ? i - source[1] : count + 1;
+                    break;
+                case RISA_OP_BJMPW:
+                    target = i >= risa_op_read_word(source + 1) ? i - risa_op_read_word(source + 1) : count + 1;
+                    break;
+                default:
+                    break;
+            }
+
+            if(target > count)
+                fits = false;
+            else risa_cluster_optimizer_encode_jump(dest, positions[i], positions[target]);
+        } else if(op == RISA_OP_RET && !tail) {
+            if(source[1] < RISA_TODLR_REGISTER_COUNT) {
+                dest[2] = dest[1];
+                dest[0] = RISA_OP_MOV;
+            } else {
+                dest[2] = 0;
+                dest[0] = RISA_OP_NULL;
+            }
+
+            dest[1] = base;
+            dest[3] = 0;
+
+            if(i + 1 < count)
+                risa_cluster_optimizer_encode_jump(dest + RISA_TODLR_INSTRUCTION_SIZE, positions[i] + 1, positions[count]);
+        }
+    }
+
+    if(fits)
+        *size += length;
+
+    RISA_MEM_FREE(constants);
+    RISA_MEM_FREE(positions);
+
+    return fits;
+}
+
+static RisaDenseFunction* risa_cluster_optimizer_find_callee(RisaClusterOptimizer* optimizer, uint32_t call, const RisaValueArray* names, const RisaValueArray* functions) {
+    RisaCluster* cluster = optimizer->cluster;
+    uint8_t* instruction = &cluster->bytecode[call * RISA_TODLR_INSTRUCTION_SIZE];
+    uint8_t op = instruction[0] & RISA_TODLR_INSTRUCTION_MASK;
+
+    // Calls with direct closure arguments are left to the VM, which moves their upvalues to the heap for script callees.
+    if((op != RISA_OP_CALL && op != RISA_OP_TCALL) || optimizer->guarded[call] || instruction[3])
+        return NULL;
+
+    // The callee must be loaded by name in the same block, before the arguments.
+    uint32_t load = call;
+
+    for(uint32_t i = call; i > 0 && load == call && !optimizer->labels[i]; --i) {
+        uint8_t* previous = &cluster->bytecode[(i - 1) * RISA_TODLR_INSTRUCTION_SIZE];
+        uint8_t previousOp = risa_op_dequicken(previous[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+        uint8_t reads;
+        uint8_t writes;
+
+        risa_cluster_optimizer_register_operands(previous, &reads, &writes);
+
+        if((writes & RISA_OPTIMIZER_OPERAND_DEST) && previous[1] == instruction[1])
+            load = i - 1;
+        else if((previousOp == RISA_OP_CALL || previousOp == RISA_OP_TCALL) && previous[1] < instruction[1])
+            return NULL;
+    }
+
+    uint8_t* loader = &cluster->bytecode[load * RISA_TODLR_INSTRUCTION_SIZE];
+
+    if(load == call || optimizer->guarded[load] || risa_op_dequicken(loader[0] & RISA_TODLR_INSTRUCTION_MASK) != RISA_OP_GGLOB || loader[2] >= cluster->constants.size)
+        return NULL;
+
+    RisaValue name = cluster->constants.values[loader[2]];
+
+    for(uint32_t i = 0; i < names->size; ++i) {
+        if(!risa_value_equals(names->values[i], name))
+            continue;
+
+        RisaDenseFunction* function = (RisaDenseFunction*) risa_value_as_dense(functions->values[i]);
+
+        // A wrong argument count is reported by the call, so it stays.
+        if(function->arity != instruction[2] || instruction[1] + 1 + function->cluster.registerCount > RISA_TODLR_REGISTER_COUNT)
+            return NULL;
+
+        return function;
+    }
+
+    return NULL;
+}
+
+static void risa_cluster_optimizer_copy_instruction(RisaCluster* cluster, uint32_t from, uint8_t* bytecode, uint32_t* indices, uint32_t to) {
+    for(uint32_t i = 0; i < RISA_TODLR_INSTRUCTION_SIZE; ++i) {
+        bytecode[to * RISA_TODLR_INSTRUCTION_SIZE + i] = cluster->bytecode[from * RISA_TODLR_INSTRUCTION_SIZE + i];
+        indices[to * RISA_TODLR_INSTRUCTION_SIZE + i] = cluster->indices[from * RISA_TODLR_INSTRUCTION_SIZE + i];
+    }
+}
+
+static uint8_t risa_cluster_optimizer_constant_operands(const uint8_t* instruction) {
+    uint8_t types = instruction[0] & RISA_TODLR_TYPE_MASK;
+
+    uint8_t left = (types & RISA_TODLR_TYPE_LEFT_MASK) ? RISA_OPTIMIZER_OPERAND_LEFT : 0;
+    uint8_t right = (types & RISA_TODLR_TYPE_RIGHT_MASK) ? RISA_OPTIMIZER_OPERAND_RIGHT : 0;
+
+    switch(risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK)) {
+        case RISA_OP_CNST:
+        case RISA_OP_GGLOB:
+            return RISA_OPTIMIZER_OPERAND_LEFT;
+        case RISA_OP_CNSTW:
+            return RISA_OPTIMIZER_OPERAND_WORD;
+        case RISA_OP_DGLOB:
+        case RISA_OP_SGLOB:
+            return RISA_OPTIMIZER_OPERAND_DEST | left;
+        case RISA_OP_ACC:
+            return left ? RISA_OPTIMIZER_OPERAND_DEST : 0;
+        case RISA_OP_PARR:
+        case RISA_OP_NOT:
+        case RISA_OP_BNOT:
+        case RISA_OP_NEG:
+            return left;
+        case RISA_OP_GET:
+            return right;
+        case RISA_OP_SET:
+        case RISA_OP_ADD:
+        case RISA_OP_SUB:
+        case RISA_OP_MUL:
+        case RISA_OP_DIV:
+        case RISA_OP_MOD:
+        case RISA_OP_SHL:
+        case RISA_OP_SHR:
+        case RISA_OP_LT:
+        case RISA_OP_LTE:
+        case RISA_OP_EQ:
+        case RISA_OP_NEQ:
+        case RISA_OP_BAND:
+        case RISA_OP_BXOR:
+        case RISA_OP_BOR:
+            return left | right;
+        default:
+            return 0;
+    }
+}
+
+static bool risa_cluster_optimizer_register_operands(const uint8_t* instruction, uint8_t* reads, uint8_t* writes) {
+    uint8_t types = instruction[0] & RISA_TODLR_TYPE_MASK;
+
+    uint8_t left = (types & RISA_TODLR_TYPE_LEFT_MASK) ? 0 : RISA_OPTIMIZER_OPERAND_LEFT;
+    uint8_t right = (types & RISA_TODLR_TYPE_RIGHT_MASK) ? 0 : RISA_OPTIMIZER_OPERAND_RIGHT;
+
+    // 251 stands for 'no register' (e.g. 'RET 251').
+    uint8_t dest = instruction[1] < RISA_TODLR_REGISTER_COUNT ? RISA_OPTIMIZER_OPERAND_DEST : 0;
+
+    *reads = 0;
+    *writes = 0;
+
+    switch(risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK)) {
+        case RISA_OP_CNST:
+        case RISA_OP_CNSTW:
+        case RISA_OP_GGLOB:
+        case RISA_OP_GUPVAL:
+        case RISA_OP_ARR:
+        case RISA_OP_OBJ:
+        case RISA_OP_NULL:
+        case RISA_OP_TRUE:
+        case RISA_OP_FALSE:
+            *writes = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_MOV:
+        case RISA_OP_CLONE:
+        case RISA_OP_CLSR:
+        case RISA_OP_LEN:
+            *reads = RISA_OPTIMIZER_OPERAND_LEFT;
+            *writes = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_DGLOB:
+        case RISA_OP_SGLOB:
+            *reads = left;
+            return true;
+        case RISA_OP_SUPVAL:
+            *reads = RISA_OPTIMIZER_OPERAND_LEFT;
+            return true;
+        case RISA_OP_UPVAL:
+            *reads = instruction[2] ? RISA_OPTIMIZER_OPERAND_DEST : 0; // Only local captures refer to registers.
+            return true;
+        case RISA_OP_PARR:
+            *reads = RISA_OPTIMIZER_OPERAND_DEST | left;
+            return true;
+        case RISA_OP_GET:
+            *reads = RISA_OPTIMIZER_OPERAND_LEFT | right;
+            *writes = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_SET:
+            *reads = RISA_OPTIMIZER_OPERAND_DEST | left | right;
+            return true;
+        case RISA_OP_NOT:
+        case RISA_OP_BNOT:
+        case RISA_OP_NEG:
+            *reads = left;
+            *writes = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_INC:
+        case RISA_OP_DEC:
+            *reads = RISA_OPTIMIZER_OPERAND_DEST;
+            *writes = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_ADD:
+        case RISA_OP_SUB:
+        case RISA_OP_MUL:
+        case RISA_OP_DIV:
+        case RISA_OP_MOD:
+        case RISA_OP_SHL:
+        case RISA_OP_SHR:
+        case RISA_OP_LT:
+        case RISA_OP_LTE:
+        case RISA_OP_EQ:
+        case RISA_OP_NEQ:
+        case RISA_OP_BAND:
+        case RISA_OP_BXOR:
+        case RISA_OP_BOR:
+            *reads = left | right;
+            *writes = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_TEST:
+        case RISA_OP_NTEST:
+            *reads = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_CALL:
+            *reads = RISA_OPTIMIZER_OPERAND_DEST; // The arguments are not operands.
+            *writes = RISA_OPTIMIZER_OPERAND_DEST;
+            return true;
+        case RISA_OP_TCALL:
+        case RISA_OP_RET:
+        case RISA_OP_DIS:
+            *reads = dest;
+            return true;
+        case RISA_OP_ACC:
+            *reads = (types & RISA_TODLR_TYPE_LEFT_MASK) ? 0 : dest;
+            return true;
+        case RISA_OP_CUPVAL:
+        case RISA_OP_JMP:
+        case RISA_OP_JMPW:
+        case RISA_OP_BJMP:
+        case RISA_OP_BJMPW:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool risa_cluster_optimizer_is_analyzable(RisaCluster* cluster) {
+    for(uint32_t i = 0; i + RISA_TODLR_INSTRUCTION_SIZE <= cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        uint8_t* instruction = &cluster->bytecode[i];
+        uint8_t op = risa_op_dequicken(instruction[0] & RISA_TODLR_INSTRUCTION_MASK);
+
+        uint8_t reads;
+        uint8_t writes;
+
+        if(!risa_cluster_optimizer_register_operands(instruction, &reads, &writes))
+            return false;
+
+        for(uint8_t j = 1; j <= 3; ++j)
+            if(((reads | writes) & (1 << (j - 1))) && instruction[j] >= RISA_TODLR_REGISTER_COUNT)
+                return false;
+
+        if((op == RISA_OP_CALL || op == RISA_OP_TCALL) && instruction[1] + instruction[2] >= RISA_TODLR_REGISTER_COUNT)
+            return false;
+    }
+
+    return true;
+}
+
+static bool risa_cluster_optimizer_is_jump(uint8_t op) {
+    return op == RISA_OP_JMP || op == RISA_OP_JMPW || op == RISA_OP_BJMP || op == RISA_OP_BJMPW;
+}
+
+static bool risa_cluster_optimizer_is_pure(uint8_t op) {
+    // Instructions whose result only depends on their operands. They can fail, but then they fail the first time.
+    switch(op) {
+        case RISA_OP_NOT:
+        case RISA_OP_BNOT:
+        case RISA_OP_NEG:
+        case RISA_OP_ADD:
+        case RISA_OP_SUB:
+        case RISA_OP_MUL:
+        case RISA_OP_DIV:
+        case RISA_OP_MOD:
+        case RISA_OP_SHL:
+        case RISA_OP_SHR:
+        case RISA_OP_LT:
+        case RISA_OP_LTE:
+        case RISA_OP_EQ:
+        case RISA_OP_NEQ:
+        case RISA_OP_BAND:
+        case RISA_OP_BXOR:
+        case RISA_OP_BOR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool risa_cluster_optimizer_is_repeatable(uint8_t op) {
+    // Instructions without side effects, which give the same result when they run again right away.
+    switch(op) {
+        case RISA_OP_CNST:
+        case RISA_OP_CNSTW:
+        case RISA_OP_MOV:
+        case RISA_OP_GGLOB:
+        case RISA_OP_LEN:
+        case RISA_OP_GET:
+        case RISA_OP_NULL:
+        case RISA_OP_TRUE:
+        case RISA_OP_FALSE:
+        case RISA_OP_TEST:
+        case RISA_OP_NTEST:
+            return true;
+        default:
+            return risa_cluster_optimizer_is_pure(op);
+    }
+}
+
+static bool risa_cluster_optimizer_is_inlinable(RisaDenseFunction* function) {
+    RisaCluster* cluster = &function->cluster;
+
+    if(cluster->size / RISA_TODLR_INSTRUCTION_SIZE > RISA_OPTIMIZER_INLINE_SIZE || !risa_cluster_optimizer_is_analyzable(cluster))
+        return false;
+
+    // Only leaves are inlined, so the body can't be recursive, and has no frames or upvalues of its own.
+    for(uint32_t i = 0; i + RISA_TODLR_INSTRUCTION_SIZE <= cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        switch(risa_op_dequicken(cluster->bytecode[i] & RISA_TODLR_INSTRUCTION_MASK)) {
+            case RISA_OP_CALL:
+            case RISA_OP_TCALL:
+            case RISA_OP_CLSR:
+            case RISA_OP_UPVAL:
+            case RISA_OP_GUPVAL:
+            case RISA_OP_SUPVAL:
+            case RISA_OP_CUPVAL:
+                return false;
+            default:
+                break;
+        }
+    }
+
+    for(uint32_t i = 0; i < cluster->constants.size; ++i)
+        if(risa_value_is_dense_of_type(cluster->constants.values[i], RISA_DVAL_FUNCTION))
+            return false;
+
+    return true;
+}
+
+static bool risa_cluster_optimizer_is_known(RisaCluster* cluster, uint32_t instruction, uint8_t reg, bool* truthy) {
+    uint8_t* bytes = &cluster->bytecode[instruction * RISA_TODLR_INSTRUCTION_SIZE];
+
+    if(bytes[1] != reg)
+        return false;
+
+    switch(bytes[0]) {
+        case RISA_OP_TRUE:
+            *truthy = true;
+            return true;
+        case RISA_OP_FALSE:
+        case RISA_OP_NULL:
+            *truthy = false;
+            return true;
+        case RISA_OP_CNST:
+            if(bytes[2] >= cluster->constants.size)
+                return false;
+
+            *truthy = risa_value_is_truthy(cluster->constants.values[bytes[2]]);
+            return true;
+        default:
+            return false;
+    }
+}
+
+#undef RISA_OPTIMIZER_OPERAND_DEST
+#undef RISA_OPTIMIZER_OPERAND_LEFT
+#undef RISA_OPTIMIZER_OPERAND_RIGHT
+#undef RISA_OPTIMIZER_OPERAND_WORD
+#undef RISA_OPTIMIZER_MAX_PASSES
+#undef RISA_OPTIMIZER_NO_BLOCK
+#undef RISA_OPTIMIZER_REGISTER_WORDS
+#undef RISA_OPTIMIZER_REGISTER_HAS
+#undef RISA_OPTIMIZER_REGISTER_ADD
+#undef RISA_OPTIMIZER_REGISTER_DEL
@@ -1,4 +1,5 @@
 #include "cluster.h"
+#include "bytecode.h"
 #include "../data/buffer.h"
 #include "../mem/mem.h"
 #include "../version.h"
@@ -51,9 +52,19 @@ static void risa_cluster_serialize(RisaClusterSerializer* serializer, RisaCluste
     // Constants
     risa_cluster_serialize_value_array(serializer, cluster->constants);
 
+    // Registers
+    risa_buffer_write_uint8(&serializer->output, cluster->registerCount);
+
     // Bytecode
     risa_buffer_write_uint32(&serializer->output, cluster->size);
-    risa_buffer_write(&serializer->output, cluster->bytecode, cluster->size);
+    uint32_t bytecodeOffset = risa_buffer_write(&serializer->output, cluster->bytecode, cluster->size);
+
+    // The cluster may have been executed, so quickened instructions must be turned back into generic ones.
+    for(uint32_t i = 0; i < cluster->size; i += RISA_TODLR_INSTRUCTION_SIZE) {
+        uint8_t* instruction = serializer->output.data + bytecodeOffset + i;
+        *instruction = (*instruction & RISA_TODLR_TYPE_MASK) | risa_op_dequicken(*instruction & RISA_TODLR_INSTRUCTION_MASK);
+    }
+
     risa_buffer_write(&serializer->output, (uint8_t*) cluster->indices, sizeof(uint32_t) * cluster->size);
 }
 
@@ -73,9 +84,9 @@ static void risa_cluster_serialize_value_array(RisaClusterSerializer* serializer
 
 static void risa_cluster_serialize_value(RisaClusterSerializer* serializer, RisaValue value) {
     // dd dd tt tt -> d - dense type, t - value type
-    risa_buffer_write_nibbles(&serializer->output, value_is_dense(value) ? (uint8_t) (risa_value_as_dense(value)->type) : 0, value.type);
+    risa_buffer_write_nibbles(&serializer->output, value_is_dense(value) ? (uint8_t) (risa_value_as_dense(value)->type) : 0, risa_value_type(value));
 
-    switch(value.type) {
+    switch(risa_value_type(value)) {
         case RISA_VAL_NULL:
             break;
         case RISA_VAL_BOOL:
@@ -118,11 +129,17 @@ static void risa_cluster_serialize_value(RisaClusterSerializer* serializer, Risa
                 case RISA_DVAL_OBJECT: {
                     RisaDenseObject* obj = RISA_AS_OBJECT(value);
 
-                    risa_buffer_write_uint32(&serializer->output, obj->data.count);
+                    risa_buffer_write_uint32(&serializer->output, risa_dense_object_get_count(obj));
+
+                    RisaDenseObjectIterator iterator;
+                    RisaDenseString* key;
+                    RisaValue val;
+
+                    risa_dense_object_iterate(obj, &iterator);
 
-                    for(int i = 0; i < obj->data.count; ++i) {
-                        risa_cluster_serialize_value(serializer, risa_value_from_dense((RisaDenseValue*) (RisaDenseString*) obj->data.entries[i].key));
-                        risa_cluster_serialize_value(serializer, obj->data.entries[i].value);
+                    while(risa_dense_object_next(&iterator, &key, &val)) {
+                        risa_cluster_serialize_value(serializer, risa_value_from_dense((RisaDenseValue*) key));
+                        risa_cluster_serialize_value(serializer, val);
                     }
                     break;
                 }
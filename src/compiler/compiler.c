@@ -55,13 +55,19 @@ static void risa_compiler_compile_and                    (RisaCompiler*, bool);
 static void risa_compiler_compile_or                     (RisaCompiler*, bool);
 static void risa_compiler_compile_comma                  (RisaCompiler*, bool);
 
-static uint8_t  risa_compiler_compile_arguments          (RisaCompiler*);
+static uint8_t  risa_compiler_compile_arguments          (RisaCompiler*, bool*);
 
 static void     risa_compiler_scope_begin                (RisaCompiler*);
 static void     risa_compiler_scope_end                  (RisaCompiler*);
 
 static void     risa_compiler_local_add                  (RisaCompiler*, RisaToken);
 static uint8_t  risa_compiler_local_resolve              (RisaCompiler*, RisaToken*);
+static RisaLocalInfo* risa_compiler_local_find           (RisaCompiler*, uint8_t);
+static void     risa_compiler_local_finalize             (RisaCompiler*, RisaLocalInfo*);
+static uint8_t  risa_compiler_local_reuse                (RisaCompiler*);
+
+static uint32_t risa_compiler_closure_last               (RisaCompiler*);
+static void     risa_compiler_closure_make_direct        (RisaCompiler*, uint32_t);
 
 static uint8_t  risa_compiler_upvalue_add                (RisaCompiler*, uint8_t, bool);
 static uint8_t  risa_compiler_upvalue_resolve            (RisaCompiler*, RisaToken*);
@@ -83,10 +89,19 @@ static uint16_t risa_compiler_create_string_constant     (RisaCompiler*, const c
 static uint16_t risa_compiler_declare_variable           (RisaCompiler*);
 
 static void     risa_compiler_optimize_last_cnst         (RisaCompiler*);
+static void     risa_compiler_optimize_tail_call         (RisaCompiler*);
 static bool     risa_compiler_can_optimize_last_cnst     (RisaCompiler* compiler);
 
+static bool     risa_compiler_fold_last                  (RisaCompiler*, RisaValue*);
+static bool     risa_compiler_fold_unary                 (RisaTokenType, RisaValue, RisaValue*);
+static bool     risa_compiler_fold_binary                (RisaCompiler*, RisaTokenType, RisaValue, RisaValue, RisaValue*);
+static void     risa_compiler_emit_folded                (RisaCompiler*, RisaValue);
+static bool     risa_compiler_constant_resolve           (RisaCompiler*, RisaToken*, RisaValue*);
+static bool     risa_compiler_constant_is_reassigned     (RisaCompiler*, RisaToken*);
+
 static bool     risa_compiler_register_reserve           (RisaCompiler*);
 static uint8_t  risa_compiler_register_find              (RisaCompiler*, RisaRegType, RisaToken);
+static void     risa_compiler_register_increment         (RisaCompiler*);
 static void     risa_compiler_register_free              (RisaCompiler*);
 
 static void risa_compiler_finalize_compilation           (RisaCompiler*);
@@ -189,10 +204,13 @@ void risa_compiler_init(RisaCompiler* compiler) {
     compiler->last.isEqualOp = false;
     compiler->last.canOverwrite = false; // true
     compiler->last.fromBranched = false;
+    compiler->last.callee = 251;
+    compiler->last.closure = UINT32_MAX;
     compiler->last.lvalMeta.type = LVAL_LOCAL;
     compiler->last.lvalMeta.global = 0;
     compiler->last.lvalMeta.globalReg = 0;
     compiler->last.lvalMeta.propOrigin = 0;
+    compiler->last.lvalMeta.local = 251;
     compiler->last.lvalMeta.propIndex.as.reg = 0;
     compiler->last.lvalMeta.propIndex.isConst = false;
 
@@ -202,6 +220,7 @@ void risa_compiler_init(RisaCompiler* compiler) {
     compiler->leapCount = 0;
 
     compiler->scopeDepth = 0;
+    compiler->loopStart = 0;
 }
 
 void risa_compiler_target(RisaCompiler* compiler, void* vm) {
@@ -328,6 +347,14 @@ static void risa_compiler_compile_int(RisaCompiler* compiler, bool allowAssignme
             return;
         }
 
+        #ifdef RISA_VALUE_NAN_BOXING
+            // Boxed ints only have 48 bits.
+            if(num < RISA_VALUE_NAN_INT_MIN || num > RISA_VALUE_NAN_INT_MAX) {
+                risa_parser_error_at_previous(compiler->parser, "Number is too large for type 'int'");
+                return;
+            }
+        #endif
+
         risa_compiler_emit_constant(compiler, risa_value_from_int(num));
 
         compiler->last.reg = compiler->regIndex - 1;
@@ -544,6 +571,17 @@ static void risa_compiler_compile_identifier(RisaCompiler* compiler, bool allowA
     uint8_t get;
     uint8_t set;
 
+    RisaValue constant;
+
+    // Locals that always hold the same constant are replaced by it, so the operations on them can be folded.
+    if(risa_compiler_constant_resolve(compiler, &compiler->parser->previous, &constant)) {
+        if(!risa_compiler_register_reserve(compiler))
+            return;
+
+        risa_compiler_emit_folded(compiler, constant);
+        return;
+    }
+
     uint8_t index = risa_compiler_local_resolve(compiler, &compiler->parser->previous);
 
     if(index != 251) {
@@ -593,8 +631,8 @@ static void risa_compiler_compile_identifier(RisaCompiler* compiler, bool allowA
                     return;
                 }
 
-                if(cluster.bytecode[cluster.size - incOffset + 1] == compiler->localCount - 1) { // The INC target interferes with the local register.
-                    uint8_t dest = compiler->localCount - 1;
+                if(cluster.bytecode[cluster.size - incOffset + 1] == index) { // The INC target interferes with the local register.
+                    uint8_t dest = index;
                     uint8_t tmp = cluster.bytecode[cluster.size - incOffset - 4 + 1]; // Original MOV target.
 
                     cluster.bytecode[cluster.size - incOffset - 4 + 2] = tmp;  // MOV source.
@@ -633,7 +671,7 @@ static void risa_compiler_compile_identifier(RisaCompiler* compiler, bool allowA
 
                         cluster.bytecode[cluster.size - incOffset + 2] = tmp;
                     }
-                } else cluster.bytecode[cluster.size - incOffset - 4 + 1] = compiler->localCount - 1; // Directly MOV to local.
+                } else cluster.bytecode[cluster.size - incOffset - 4 + 1] = index; // Directly MOV to local.
             } else if(risa_op_has_direct_dest(cluster.bytecode[cluster.size - 4] & RISA_TODLR_INSTRUCTION_MASK) && !compiler->last.isEqualOp) { // Can directly assign to local.
                 cluster.bytecode[cluster.size - 4 + 1] = index;  // Do it.
                 compiler->last.reg = index;
@@ -667,6 +705,7 @@ static void risa_compiler_compile_identifier(RisaCompiler* compiler, bool allowA
 
         compiler->last.isConst = false;
         compiler->last.fromBranched = false;
+        compiler->last.lvalMeta.local = 251; // The assigned value is not a read of this local.
 
         //risa_compiler_register_free(compiler);
     } else {
@@ -712,10 +751,20 @@ static void risa_compiler_compile_identifier(RisaCompiler* compiler, bool allowA
             } else compiler->last.isNew = false;
         }
 
+        compiler->last.lvalMeta.local = 251;
+
         switch(get) {
-            case RISA_OP_MOV:
+            case RISA_OP_MOV: {
+                RisaLocalInfo* local = risa_compiler_local_find(compiler, index);
+
                 compiler->last.lvalMeta.type = LVAL_LOCAL;
+
+                if(local != NULL) {
+                    compiler->last.lvalMeta.local = index;
+                    ++local->reads;
+                }
                 break;
+            }
             case RISA_OP_GGLOB:
                 compiler->last.lvalMeta.type = LVAL_GLOBAL;
                 compiler->last.lvalMeta.global = index;
@@ -754,13 +803,14 @@ static void risa_compiler_compile_array(RisaCompiler* compiler, bool allowAssign
         while (1) {
             risa_compiler_compile_expression_precedence(compiler, RISA_PREC_COMMA + 1);
 
-            if (compiler->last.isNew)
-                risa_compiler_register_free(compiler);
-
             bool isOptimized = risa_compiler_can_optimize_last_cnst(compiler);
 
+            // The optimization already frees the register of the constant.
             risa_compiler_optimize_last_cnst(compiler);
 
+            if (compiler->last.isNew)
+                risa_compiler_register_free(compiler);
+
             #define L_TYPE (isOptimized * RISA_TODLR_TYPE_LEFT_MASK)
 
             risa_compiler_emit_byte(compiler, RISA_OP_PARR | L_TYPE);
@@ -869,13 +919,14 @@ static void risa_compiler_compile_object(RisaCompiler* compiler, bool allowAssig
 
             risa_compiler_compile_expression_precedence(compiler, RISA_PREC_COMMA + 1);
 
-            if(compiler->last.isNew)
-                risa_compiler_register_free(compiler);
-
             bool isOptimized = risa_compiler_can_optimize_last_cnst(compiler);
 
+            // The optimization already frees the register of the constant.
             risa_compiler_optimize_last_cnst(compiler);
 
+            if(compiler->last.isNew)
+                risa_compiler_register_free(compiler);
+
             #define LR_TYPES ((isConst * RISA_TODLR_TYPE_LEFT_MASK) | (isOptimized * RISA_TODLR_TYPE_RIGHT_MASK))
 
             risa_compiler_emit_byte(compiler, RISA_OP_SET | LR_TYPES);//HERE2
@@ -921,8 +972,14 @@ static void risa_compiler_compile_declaration(RisaCompiler* compiler) {
     if(compiler->parser->panic)
         risa_parser_sync(compiler->parser);
 
-    if(compiler->regIndex - regIndex != compiler->localCount - localCount)
-        compiler->regIndex = regIndex + (compiler->localCount - localCount);
+    // Only the new locals that didn't borrow a register hold one on top of the others.
+    size_t owned = 0;
+
+    for(size_t i = localCount; i < compiler->localCount; ++i)
+        owned += !compiler->locals[i].borrowed;
+
+    if(compiler->regIndex - regIndex != owned)
+        compiler->regIndex = regIndex + owned;
 }
 
 static void risa_compiler_compile_variable_declaration(RisaCompiler* compiler) {
@@ -930,18 +987,29 @@ static void risa_compiler_compile_variable_declaration(RisaCompiler* compiler) {
     uint32_t clusterSize = compiler->function->cluster.size;
     RisaToken lastRegToken = compiler->parser->previous;
 
+    bool isConst = false;
+    RisaValue constant;
+
     if(compiler->parser->current.type == RISA_TOKEN_EQUAL) {
         risa_parser_advance(compiler->parser);
         risa_compiler_compile_expression(compiler);
+
+        if(compiler->scopeDepth > 0 && risa_compiler_can_optimize_last_cnst(compiler)) {
+            RisaCluster* cluster = &compiler->function->cluster;
+
+            isConst = true;
+            constant = cluster->constants.values[cluster->bytecode[cluster->size - 2]];
+        }
     } else {
         if(!risa_compiler_register_reserve(compiler))
             return;
 
         risa_compiler_emit_byte(compiler, RISA_OP_NULL);
-        risa_compiler_emit_byte(compiler, compiler->locals[compiler->localCount - 1].reg - 1);
+        risa_compiler_emit_byte(compiler, compiler->regIndex - 1);
         risa_compiler_emit_byte(compiler, 0);
         risa_compiler_emit_byte(compiler, 0);
 
+        compiler->last.reg = compiler->regIndex - 1;
         compiler->last.isNew = true;
         compiler->last.isConst = false;
         compiler->last.isLvalue = false;
@@ -952,6 +1020,14 @@ static void risa_compiler_compile_variable_declaration(RisaCompiler* compiler) {
 
     if(compiler->scopeDepth > 0) {
         RisaCluster cluster = compiler->function->cluster;
+        uint32_t closure = risa_compiler_closure_last(compiler);
+        uint8_t reused = risa_compiler_local_reuse(compiler);
+
+        if(reused != 251) {
+            compiler->regs[compiler->locals[compiler->localCount - 1].reg] = (RisaRegInfo) {RISA_REG_TEMP };
+            compiler->locals[compiler->localCount - 1].reg = reused;
+            compiler->locals[compiler->localCount - 1].borrowed = true;
+        }
 
         if((clusterSize == cluster.size)                  // Register reference; no new OPs.
         || (clusterSize + 4 == cluster.size               // Only one OP.
@@ -1026,6 +1102,16 @@ static void risa_compiler_compile_variable_declaration(RisaCompiler* compiler) {
 
         compiler->locals[compiler->localCount - 1].depth = compiler->scopeDepth;
 
+        // Like local functions, locals initialized with a lambda are candidates for direct upvalues.
+        if(closure != UINT32_MAX && closure >= clusterSize)
+            compiler->locals[compiler->localCount - 1].closure = closure;
+
+        // The local still holds the value; only its reads are replaced with the constant.
+        if(isConst && !risa_compiler_constant_is_reassigned(compiler, &lastRegToken)) {
+            compiler->locals[compiler->localCount - 1].isConst = true;
+            compiler->locals[compiler->localCount - 1].value = constant;
+        }
+
         compiler->last.reg = compiler->locals[compiler->localCount - 1].reg;
         compiler->last.isConstOptimized = false;
         compiler->regs[compiler->last.reg] = (RisaRegInfo) {RISA_REG_LOCAL, lastRegToken };
@@ -1035,22 +1121,26 @@ static void risa_compiler_compile_variable_declaration(RisaCompiler* compiler) {
         compiler->last.isEqualOp = false;
         compiler->last.fromBranched = false;
 
+        if(reused != 251)
+            return;
+
         if(compiler->regIndex == 249) {
             risa_parser_error_at_current(compiler->parser, "Register limit exceeded (250)");
             return;
         }
 
-        ++compiler->regIndex;
+        risa_compiler_register_increment(compiler);
         return;
     }
 
-    if(compiler->last.isNew)
-        risa_compiler_register_free(compiler);
-
     compiler->last.isConstOptimized = risa_compiler_can_optimize_last_cnst(compiler);
 
+    // The optimization already frees the register of the constant.
     risa_compiler_optimize_last_cnst(compiler);
 
+    if(compiler->last.isNew)
+        risa_compiler_register_free(compiler);
+
     // TODO: check if this ^^^^^ is a perfect replacement.
     /*if(cluster->bytecode[cluster->size - 4] == RISA_OP_CNST) {
         compiler->last.reg = cluster->bytecode[cluster->size - 2];
@@ -1158,7 +1248,7 @@ static void risa_compiler_compile_function(RisaCompiler* compiler) {
 
             subcompiler.locals[subcompiler.localCount - 1].depth = subcompiler.scopeDepth;
 
-            ++subcompiler.regIndex;
+            risa_compiler_register_increment(&subcompiler);
 
             if(subcompiler.parser->current.type != RISA_TOKEN_COMMA)
                 break;
@@ -1187,6 +1277,9 @@ static void risa_compiler_compile_function(RisaCompiler* compiler) {
     } else {
         risa_compiler_emit_constant(compiler, risa_value_from_dense((RisaDenseValue*) subcompiler.function));
 
+        uint32_t closure = compiler->function->cluster.size;
+        bool recaptured = false;
+
         risa_compiler_emit_byte(compiler, RISA_OP_CLSR);
         risa_compiler_emit_byte(compiler, compiler->regIndex - 1);
         risa_compiler_emit_byte(compiler, compiler->regIndex - 1);
@@ -1197,9 +1290,18 @@ static void risa_compiler_compile_function(RisaCompiler* compiler) {
             risa_compiler_emit_byte(compiler, subcompiler.upvalues[i].index);
             risa_compiler_emit_byte(compiler, subcompiler.upvalues[i].local);
             risa_compiler_emit_byte(compiler, 0);
+
+            recaptured |= subcompiler.upvalues[i].captured;
         }
+
+        // Local functions are candidates for direct upvalues, decided when the local goes out of scope.
+        if(compiler->scopeDepth > 0 && !recaptured)
+            compiler->locals[compiler->localCount - 1].closure = closure;
     }
 
+    for(uint16_t i = 0; i < subcompiler.localCount; ++i)
+        risa_compiler_local_finalize(&subcompiler, &subcompiler.locals[i]);
+
     compiler->last.isConstOptimized = false;
     compiler->last.isNew = true;
     compiler->last.isConst = false;
@@ -1290,6 +1392,9 @@ static void risa_compiler_compile_if_statement(RisaCompiler* compiler) {
 
 static void risa_compiler_compile_while_statement(RisaCompiler* compiler) {
     uint32_t start = compiler->function->cluster.size;
+    uint32_t loopStart = compiler->loopStart;
+
+    compiler->loopStart = compiler->parser->previous.index;
 
     risa_parser_consume(compiler->parser, RISA_TOKEN_LEFT_PAREN, "Expected '(' after 'if'");
     risa_compiler_compile_expression(compiler);
@@ -1317,6 +1422,8 @@ static void risa_compiler_compile_while_statement(RisaCompiler* compiler) {
 
     risa_compiler_compile_statement(compiler);
 
+    compiler->loopStart = loopStart;
+
     risa_compiler_emit_backwards_jump(compiler, start);
     risa_compiler_emit_jump(compiler, end);
 
@@ -1351,6 +1458,10 @@ static void risa_compiler_compile_for_statement(RisaCompiler* compiler) {
     uint32_t exitIndex = 0;
     bool infinite = true;
 
+    // The initializer only runs once, so its locals live across the iterations.
+    uint32_t loopStart = compiler->loopStart;
+    compiler->loopStart = compiler->parser->current.index;
+
     if(compiler->parser->current.type != RISA_TOKEN_SEMICOLON) {
         risa_compiler_compile_expression(compiler);
         risa_parser_consume(compiler->parser, RISA_TOKEN_SEMICOLON, "Expected ';' after loop condition");
@@ -1397,6 +1508,8 @@ static void risa_compiler_compile_for_statement(RisaCompiler* compiler) {
     risa_compiler_compile_statement(compiler);
     risa_compiler_emit_backwards_jump(compiler, start);
 
+    compiler->loopStart = loopStart;
+
     if(!infinite) {
         risa_compiler_emit_jump(compiler, exitIndex);
     }
@@ -1427,6 +1540,8 @@ static void risa_compiler_compile_return_statement(RisaCompiler* compiler) {
         risa_compiler_compile_expression(compiler);
         risa_parser_consume(compiler->parser, RISA_TOKEN_SEMICOLON, "Expected ';' after return expression");
 
+        risa_compiler_optimize_tail_call(compiler);
+
         risa_compiler_emit_byte(compiler, RISA_OP_RET);
         risa_compiler_emit_byte(compiler, compiler->last.reg);
         risa_compiler_emit_byte(compiler, 0);
@@ -1447,6 +1562,8 @@ static void risa_compiler_compile_return_expression(RisaCompiler* compiler) {
     } else {
         risa_compiler_compile_expression_precedence(compiler, RISA_PREC_COMMA + 1);
 
+        risa_compiler_optimize_tail_call(compiler);
+
         risa_compiler_emit_byte(compiler, RISA_OP_RET);
         risa_compiler_emit_byte(compiler, compiler->last.reg);
         risa_compiler_emit_byte(compiler, 0);
@@ -1585,6 +1702,10 @@ static void risa_compiler_compile_inline_asm_statement(RisaCompiler* compiler) {
     iasm.cluster = compiler->function->cluster;
     iasm.strings = &super->strings;
 
+    // The assembly can read any register, so no local closure is known to stay in the frame.
+    for(uint16_t i = 0; i < compiler->localCount; ++i)
+        compiler->locals[i].closure = UINT32_MAX;
+
     risa_assembler_assemble(&iasm, compiler->parser->lexer.start, isBlock ? "}" : "\r\n;");
 
     compiler->function->cluster = iasm.cluster;
@@ -1663,6 +1784,14 @@ static void risa_compiler_compile_expression_precedence(RisaCompiler* compiler,
 }
 
 static void risa_compiler_compile_call(RisaCompiler* compiler, bool allowAssignment) {
+    uint8_t callee = 251;
+
+    // Reading a local only to call it doesn't let the value escape.
+    if(compiler->last.isLvalue && compiler->last.lvalMeta.type == LVAL_LOCAL && compiler->last.lvalMeta.local != 251) {
+        callee = compiler->last.lvalMeta.local;
+        ++risa_compiler_local_find(compiler, callee)->calls;
+    }
+
     if(!compiler->last.isNew) {
         if(!risa_compiler_register_reserve(compiler))
             return;
@@ -1678,14 +1807,15 @@ static void risa_compiler_compile_call(RisaCompiler* compiler, bool allowAssignm
 
     compiler->last.canOverwrite = true;
 
-    uint8_t argc = risa_compiler_compile_arguments(compiler);
+    bool direct;
+    uint8_t argc = risa_compiler_compile_arguments(compiler, &direct);
 
     compiler->last.canOverwrite = false;
 
     risa_compiler_emit_byte(compiler, RISA_OP_CALL);
     risa_compiler_emit_byte(compiler, functionReg);
     risa_compiler_emit_byte(compiler, argc);
-    risa_compiler_emit_byte(compiler, 0);
+    risa_compiler_emit_byte(compiler, direct);
 
     while(argc > 0) {
         risa_compiler_register_free(compiler);
@@ -1693,6 +1823,7 @@ static void risa_compiler_compile_call(RisaCompiler* compiler, bool allowAssignm
     }
 
     compiler->last.reg = functionReg;
+    compiler->last.callee = callee;
     compiler->regs[functionReg] = (RisaRegInfo) {RISA_REG_TEMP };
     compiler->last.isConstOptimized = false;
     compiler->last.isNew = true;
@@ -1875,9 +2006,11 @@ static void risa_compiler_compile_dot(RisaCompiler* compiler, bool allowAssignme
     }
 }
 
-static uint8_t risa_compiler_compile_arguments(RisaCompiler* compiler) {
+static uint8_t risa_compiler_compile_arguments(RisaCompiler* compiler, bool* direct) {
     uint8_t argc = 0;
 
+    *direct = false;
+
     if(compiler->parser->current.type != RISA_TOKEN_RIGHT_PAREN) {
         do {
             uint32_t clusterSize = compiler->function->cluster.size;
@@ -1885,6 +2018,15 @@ static uint8_t risa_compiler_compile_arguments(RisaCompiler* compiler) {
 
             risa_compiler_compile_expression_precedence(compiler, RISA_PREC_COMMA + 1);
 
+            // A lambda passed straight to the callee lives in the argument register, which is dead after the call. The
+            // VM falls back to heap upvalues unless the callee is a native that never keeps its arguments.
+            uint32_t closure = risa_compiler_closure_last(compiler);
+
+            if(closure != UINT32_MAX && closure >= clusterSize) {
+                risa_compiler_closure_make_direct(compiler, closure);
+                *direct = true;
+            }
+
             if(regIndex != compiler->regIndex)
                 compiler->regIndex = regIndex;
 
@@ -1985,7 +2127,7 @@ static void risa_compiler_compile_lambda(RisaCompiler* compiler) {
             subcompiler.locals[subcompiler.localCount - 1].depth = subcompiler.scopeDepth;
 
             // Reserve a register for the parameter.
-            ++subcompiler.regIndex;
+            risa_compiler_register_increment(&subcompiler);
 
             if(subcompiler.parser->current.type != RISA_TOKEN_COMMA)
                 break;
@@ -2006,11 +2148,16 @@ static void risa_compiler_compile_lambda(RisaCompiler* compiler) {
     if(!risa_compiler_register_reserve(compiler))
         return;
 
+    compiler->last.closure = UINT32_MAX;
+
     if(subcompiler.upvalueCount == 0) {
         risa_compiler_emit_constant(compiler, risa_value_from_dense((RisaDenseValue*) subcompiler.function));
     } else {
         risa_compiler_emit_constant(compiler, risa_value_from_dense((RisaDenseValue*) subcompiler.function));
 
+        uint32_t closure = compiler->function->cluster.size;
+        bool recaptured = false;
+
         risa_compiler_emit_byte(compiler, RISA_OP_CLSR);
         risa_compiler_emit_byte(compiler, compiler->regIndex - 1);
         risa_compiler_emit_byte(compiler, compiler->regIndex - 1);
@@ -2021,11 +2168,21 @@ static void risa_compiler_compile_lambda(RisaCompiler* compiler) {
             risa_compiler_emit_byte(compiler, subcompiler.upvalues[i].index);
             risa_compiler_emit_byte(compiler, subcompiler.upvalues[i].local);
             risa_compiler_emit_byte(compiler, 0);
+
+            recaptured |= subcompiler.upvalues[i].captured;
         }
+
+        // Whoever receives the closure decides whether its captures can use the registers directly.
+        if(!recaptured)
+            compiler->last.closure = closure;
     }
 
     compiler->last.reg = compiler->regIndex - 1;
     compiler->regs[compiler->last.reg] = (RisaRegInfo) {RISA_REG_CONSTANT, {RISA_TOKEN_IDENTIFIER, "lambda", 6 } };
+
+    for(uint16_t i = 0; i < subcompiler.localCount; ++i)
+        risa_compiler_local_finalize(&subcompiler, &subcompiler.locals[i]);
+
     compiler->last.isConstOptimized = false;
     compiler->last.isNew = true;
     compiler->last.isConst = true;
@@ -2154,10 +2311,21 @@ static void risa_compiler_compile_unary(RisaCompiler* compiler, bool allowAssign
 
     risa_compiler_compile_expression_precedence(compiler, RISA_PREC_UNARY);
 
+    RisaValue operand;
+    RisaValue result;
+
+    if(risa_compiler_fold_last(compiler, &operand) && risa_compiler_fold_unary(operator, operand, &result)) {
+        compiler->function->cluster.size -= 4;
+        risa_compiler_emit_folded(compiler, result);
+        return;
+    }
+
     uint8_t destReg;
 
-    // TODO: use risa_compiler_optimize_last_cnst here
-    if(compiler->last.isConst) {
+    // TRUE, FALSE and NULL are also constants, but they are not CNST instructions.
+    bool isOptimized = risa_compiler_can_optimize_last_cnst(compiler);
+
+    if(isOptimized) {
         //risa_compiler_register_free(compiler);
         destReg = compiler->last.reg;
         compiler->last.reg = compiler->function->cluster.bytecode[compiler->function->cluster.size - 2];
@@ -2170,7 +2338,7 @@ static void risa_compiler_compile_unary(RisaCompiler* compiler, bool allowAssign
         destReg = compiler->regIndex - 1;
     } else destReg = compiler->last.reg;
 
-    #define L_TYPE (compiler->last.isConst * RISA_TODLR_TYPE_LEFT_MASK)
+    #define L_TYPE (isOptimized * RISA_TODLR_TYPE_LEFT_MASK)
 
     switch(operator) {
         case RISA_TOKEN_BANG:
@@ -2229,6 +2397,20 @@ static void risa_compiler_compile_binary(RisaCompiler* compiler, bool allowAssig
 
     risa_compiler_optimize_last_cnst(compiler);
 
+    if(isLeftOptimized && isRightOptimized) {
+        RisaValueArray* constants = &compiler->function->cluster.constants;
+        RisaValue result;
+
+        // Both operand registers were freed by the CNST optimization.
+        if(risa_compiler_fold_binary(compiler, operatorType, constants->values[leftReg], constants->values[compiler->last.reg], &result)) {
+            if(!risa_compiler_register_reserve(compiler))
+                return;
+
+            risa_compiler_emit_folded(compiler, result);
+            return;
+        }
+    }
+
     // The GT and GTE instructions are simulated with reversed LT and LTE. Therefore, switch the operands and use the REV def.
     #define LR_TYPES ((isLeftOptimized * RISA_TODLR_TYPE_LEFT_MASK) | (isRightOptimized * RISA_TODLR_TYPE_RIGHT_MASK))
     #define LR_TYPES_REV ((isRightOptimized * RISA_TODLR_TYPE_LEFT_MASK) | (isLeftOptimized * RISA_TODLR_TYPE_RIGHT_MASK))
@@ -2667,21 +2849,26 @@ static void risa_compiler_scope_end(RisaCompiler* compiler) {
     --compiler->scopeDepth;
 
     while(compiler->localCount > 0 && compiler->locals[compiler->localCount - 1].depth > compiler->scopeDepth) {
+        risa_compiler_local_finalize(compiler, &compiler->locals[compiler->localCount - 1]);
+
         if(compiler->locals[compiler->localCount - 1].captured) {
             risa_compiler_emit_byte(compiler, RISA_OP_CUPVAL);
-            risa_compiler_emit_byte(compiler, compiler->regIndex - 1);
+            risa_compiler_emit_byte(compiler, compiler->locals[compiler->localCount - 1].reg);
             risa_compiler_emit_byte(compiler, 0);
             risa_compiler_emit_byte(compiler, 0);
         }
 
-        risa_compiler_register_free(compiler);
+        // A borrowed register belongs to an older local of the same scope, which frees it.
+        if(!compiler->locals[compiler->localCount - 1].borrowed)
+            risa_compiler_register_free(compiler);
+
         --compiler->localCount;
     }
 }
 
 static void risa_compiler_local_add(RisaCompiler* compiler, RisaToken identifier) {
-    if(compiler->localCount == 250) {
-        risa_parser_error_at_previous(compiler->parser, "RisaLocalInfo variable limit exceeded (250)");
+    if(compiler->localCount == RISA_COMPILER_LOCAL_COUNT) {
+        risa_parser_error_at_previous(compiler->parser, "RisaLocalInfo variable limit exceeded (" RISA_STRINGIFY(RISA_COMPILER_LOCAL_COUNT) ")");
         return;
     }
 
@@ -2693,6 +2880,12 @@ static void risa_compiler_local_add(RisaCompiler* compiler, RisaToken identifier
     local->depth = -1;
     local->reg = compiler->regIndex; // -1
     local->captured = false;
+    local->borrowed = false;
+    local->lent = false;
+    local->closure = UINT32_MAX;
+    local->reads = 0;
+    local->calls = 0;
+    local->isConst = false;
 
     compiler->regs[local->reg] = (RisaRegInfo) {RISA_REG_LOCAL, identifier };
 }
@@ -2708,6 +2901,113 @@ static uint8_t risa_compiler_local_resolve(RisaCompiler* compiler, RisaToken* id
     return 251;
 }
 
+static RisaLocalInfo* risa_compiler_local_find(RisaCompiler* compiler, uint8_t reg) {
+    for(int16_t i = compiler->localCount - 1; i >= 0; --i)
+        if(compiler->locals[i].reg == reg && compiler->locals[i].depth > -1)
+            return &compiler->locals[i];
+
+    return NULL;
+}
+
+static void risa_compiler_local_finalize(RisaCompiler* compiler, RisaLocalInfo* local) {
+    // A closure that is only ever called while its local is alive can't outlive the frame, unless a nested function
+    // captures either the local or one of the closure's upvalues. Its captures can then use the registers directly.
+    if(local->closure == UINT32_MAX || local->captured || local->reads != local->calls)
+        return;
+
+    risa_compiler_closure_make_direct(compiler, local->closure);
+}
+
+static uint8_t risa_compiler_local_reuse(RisaCompiler* compiler) {
+    // The last local can take over the register of an older local of the same scope that is never read again, instead
+    // of reserving a new one. The older local must not be captured, and must be declared again on every iteration of
+    // the innermost loop, if any. A post increment writes to the register of the local it reads, so it is left out.
+    RisaLocalInfo* local = &compiler->locals[compiler->localCount - 1];
+    bool candidates[RISA_COMPILER_LOCAL_COUNT];
+    uint8_t count = 0;
+
+    if(compiler->last.isPostIncrement)
+        return 251;
+
+    for(uint16_t i = 0; i < compiler->localCount - 1; ++i) {
+        RisaLocalInfo* older = &compiler->locals[i];
+
+        candidates[i] = older->depth == compiler->scopeDepth && !older->captured && !older->lent
+                     && older->identifier.index > compiler->loopStart;
+        count += candidates[i];
+    }
+
+    // Scans the rest of the block, like risa_compiler_constant_is_reassigned. Any use of the name keeps the local.
+    RisaLexer lexer = compiler->parser->lexer;
+    RisaToken token = compiler->parser->current;
+
+    uint32_t depth = 0;
+
+    while(count > 0 && token.type != RISA_TOKEN_EOF) {
+        if(token.type == RISA_TOKEN_LEFT_BRACE)
+            ++depth;
+        else if(token.type == RISA_TOKEN_RIGHT_BRACE) {
+            if(depth == 0)
+                break;
+
+            --depth;
+        } else if(token.type == RISA_TOKEN_DOLLAR || token.type == RISA_TOKEN_ERROR)
+            return 251;
+        else if(token.type == RISA_TOKEN_IDENTIFIER) {
+            for(uint16_t i = 0; i < compiler->localCount - 1; ++i) {
+                if(candidates[i] && risa_token_identifier_equals(&token, &compiler->locals[i].identifier)) {
+                    candidates[i] = false;
+                    --count;
+                }
+            }
+        }
+
+        token = risa_lexer_next(&lexer);
+    }
+
+    if(count == 0)
+        return 251;
+
+    // Reads of the name find the highest register that holds it, so the local can't go below a shadowed one.
+    uint8_t shadowed = risa_compiler_register_find(compiler, RISA_REG_LOCAL, local->identifier);
+
+    for(uint16_t i = 0; i < compiler->localCount - 1; ++i) {
+        if(candidates[i] && (shadowed == 251 || shadowed < compiler->locals[i].reg)) {
+            compiler->locals[i].lent = true;
+            return compiler->locals[i].reg;
+        }
+    }
+
+    return 251;
+}
+
+static uint32_t risa_compiler_closure_last(RisaCompiler* compiler) {
+    // The last value is the closure of a lambda only if nothing was emitted after its CLSR block.
+    RisaCluster* cluster = &compiler->function->cluster;
+    uint32_t closure = compiler->last.closure;
+
+    if(closure == UINT32_MAX || compiler->last.fromBranched || closure >= cluster->size)
+        return UINT32_MAX;
+
+    if(cluster->bytecode[closure] != RISA_OP_CLSR || cluster->bytecode[closure + 1] != compiler->last.reg
+    || closure + 4 * (cluster->bytecode[closure + 3] + 1) != cluster->size)
+        return UINT32_MAX;
+
+    return closure;
+}
+
+static void risa_compiler_closure_make_direct(RisaCompiler* compiler, uint32_t closure) {
+    RisaCluster* cluster = &compiler->function->cluster;
+    uint8_t upvalCount = cluster->bytecode[closure + 3];
+
+    for(uint8_t i = 0; i < upvalCount; ++i) {
+        uint8_t* upval = &cluster->bytecode[closure + 4 * (i + 1)];
+
+        if(upval[2])
+            upval[3] = 1;
+    }
+}
+
 static uint8_t risa_compiler_upvalue_add(RisaCompiler* compiler, uint8_t index, bool local) {
     uint8_t upvalCount = compiler->upvalueCount;
 
@@ -2724,6 +3024,7 @@ static uint8_t risa_compiler_upvalue_add(RisaCompiler* compiler, uint8_t index,
 
     compiler->upvalues[upvalCount].local = local;
     compiler->upvalues[upvalCount].index = index;
+    compiler->upvalues[upvalCount].captured = false;
     return compiler->upvalueCount++;
 }
 
@@ -2734,14 +3035,16 @@ static uint8_t risa_compiler_upvalue_resolve(RisaCompiler* compiler, RisaToken*
     uint8_t local = risa_compiler_local_resolve(compiler->super, identifier);
 
     if(local != 251) {
-        compiler->super->locals[local].captured = true;
+        risa_compiler_local_find(compiler->super, local)->captured = true;
         return risa_compiler_upvalue_add(compiler, local, true);
     }
 
     uint8_t upvalue = risa_compiler_upvalue_resolve(compiler->super, identifier);
 
-    if(upvalue != 251)
+    if(upvalue != 251) {
+        compiler->super->upvalues[upvalue].captured = true;
         return risa_compiler_upvalue_add(compiler, upvalue, false);
+    }
 
     return 251;
 }
@@ -2932,6 +3235,329 @@ static void risa_compiler_optimize_last_cnst(RisaCompiler* compiler) {
     }
 }
 
+static void risa_compiler_optimize_tail_call(RisaCompiler* compiler) {
+    // If the returned value comes straight from a CALL, the callee can take over the frame. The RET is still
+    // emitted after the TCALL, for natives and for the jumps that land after the call.
+    RisaCluster* cluster = &compiler->function->cluster;
+
+    if(cluster->size >= 4
+    && cluster->bytecode[cluster->size - 4] == RISA_OP_CALL
+    && cluster->bytecode[cluster->size - 3] == compiler->last.reg) {
+        cluster->bytecode[cluster->size - 4] = RISA_OP_TCALL;
+
+        // The callee replaces this frame, so a closure that uses its registers directly must not be tail called.
+        RisaLocalInfo* local = compiler->last.callee == 251 ? NULL : risa_compiler_local_find(compiler, compiler->last.callee);
+
+        if(local != NULL)
+            ++local->reads;
+    }
+}
+
+static bool risa_compiler_fold_last(RisaCompiler* compiler, RisaValue* value) {
+    // Like risa_compiler_can_optimize_last_cnst, but TRUE, FALSE and NULL also count. The value must be in a new register.
+    RisaCluster* cluster = &compiler->function->cluster;
+
+    if(!compiler->last.isConst || compiler->last.fromBranched || !compiler->last.isNew || cluster->size < 4 || compiler->last.reg != compiler->regIndex - 1)
+        return false;
+
+    switch(cluster->bytecode[cluster->size - 4]) {
+        case RISA_OP_CNST:
+            *value = cluster->constants.values[cluster->bytecode[cluster->size - 2]];
+            return true;
+        case RISA_OP_TRUE:
+            *value = risa_value_from_bool(true);
+            return true;
+        case RISA_OP_FALSE:
+            *value = risa_value_from_bool(false);
+            return true;
+        case RISA_OP_NULL:
+            *value = risa_value_from_null();
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool risa_compiler_fold_unary(RisaTokenType operator, RisaValue operand, RisaValue* result) {
+    switch(operator) {
+        case RISA_TOKEN_BANG:
+            *result = risa_value_from_bool(risa_value_is_falsy(operand));
+            return true;
+        case RISA_TOKEN_TILDE:
+            if(risa_value_is_byte(operand))
+                *result = risa_value_from_byte(~risa_value_as_byte(operand));
+            else if(risa_value_is_int(operand))
+                *result = risa_value_from_int(~risa_value_as_int(operand));
+            else return false;
+
+            return true;
+        case RISA_TOKEN_MINUS:
+            if(risa_value_is_byte(operand))
+                *result = risa_value_from_int(-((int64_t) risa_value_as_byte(operand)));
+            else if(risa_value_is_int(operand) && risa_value_as_int(operand) != INT64_MIN)
+                *result = risa_value_from_int(-risa_value_as_int(operand));
+            else if(risa_value_is_float(operand))
+                *result = risa_value_from_float(-risa_value_as_float(operand));
+            else return false;
+
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool risa_compiler_fold_binary(RisaCompiler* compiler, RisaTokenType operator, RisaValue left, RisaValue right, RisaValue* result) {
+    // The result must be exactly what the VM would compute. Operations that raise runtime errors, divide by zero,
+    // overflow or shift out of range are left for the VM.
+    bool isLeftString = risa_value_is_dense_of_type(left, RISA_DVAL_STRING);
+    bool isRightString = risa_value_is_dense_of_type(right, RISA_DVAL_STRING);
+
+    if(operator == RISA_TOKEN_EQUAL_EQUAL || operator == RISA_TOKEN_BANG_EQUAL) {
+        // Dense values are compared by reference, which is only known for interned strings.
+        if((value_is_dense(left) && !isLeftString) || (value_is_dense(right) && !isRightString))
+            return false;
+
+        *result = risa_value_from_bool(risa_value_equals(left, right) == (operator == RISA_TOKEN_EQUAL_EQUAL));
+        return true;
+    }
+
+    if(operator == RISA_TOKEN_PLUS && isLeftString && isRightString) {
+        RisaDenseString* concat = risa_dense_string_concat(RISA_AS_STRING(left), RISA_AS_STRING(right));
+
+        RisaCompiler* super = compiler;
+
+        while(super->super != NULL)
+            super = super->super;
+
+        RisaDenseString* interned = risa_map_find(&super->strings, concat->chars, concat->length, concat->hash);
+
+        if(interned == NULL) {
+            interned = concat;
+            risa_map_set(&super->strings, interned, risa_value_from_null());
+        } else RISA_MEM_FREE(concat);
+
+        *result = risa_value_from_dense((RisaDenseValue*) interned);
+        return true;
+    }
+
+    bool isLeftFloat = risa_value_is_float(left);
+    bool isRightFloat = risa_value_is_float(right);
+
+    if((!risa_value_is_byte(left) && !risa_value_is_int(left) && !isLeftFloat) || (!risa_value_is_byte(right) && !risa_value_is_int(right) && !isRightFloat))
+        return false;
+
+    if(isLeftFloat || isRightFloat) {
+        double l = isLeftFloat ? risa_value_as_float(left) : (risa_value_is_int(left) ? (double) risa_value_as_int(left) : risa_value_as_byte(left));
+        double r = isRightFloat ? risa_value_as_float(right) : (risa_value_is_int(right) ? (double) risa_value_as_int(right) : risa_value_as_byte(right));
+
+        switch(operator) {
+            case RISA_TOKEN_PLUS:          *result = risa_value_from_float(l + r); return true;
+            case RISA_TOKEN_MINUS:         *result = risa_value_from_float(l - r); return true;
+            case RISA_TOKEN_STAR:          *result = risa_value_from_float(l * r); return true;
+            case RISA_TOKEN_SLASH:         *result = risa_value_from_float(l / r); return true;
+            case RISA_TOKEN_LESS:          *result = risa_value_from_bool(l < r);  return true;
+            case RISA_TOKEN_LESS_EQUAL:    *result = risa_value_from_bool(l <= r); return true;
+            case RISA_TOKEN_GREATER:       *result = risa_value_from_bool(r < l);  return true;
+            case RISA_TOKEN_GREATER_EQUAL: *result = risa_value_from_bool(r <= l); return true;
+            default:                       return false; // MOD, shifts and bitwise operations don't accept floats.
+        }
+    }
+
+    bool isLeftByte = risa_value_is_byte(left);
+    bool isRightByte = risa_value_is_byte(right);
+
+    int64_t l = isLeftByte ? risa_value_as_byte(left) : risa_value_as_int(left);
+    int64_t r = isRightByte ? risa_value_as_byte(right) : risa_value_as_int(right);
+
+    switch(operator) {
+        case RISA_TOKEN_LESS:          *result = risa_value_from_bool(l < r);  return true;
+        case RISA_TOKEN_LESS_EQUAL:    *result = risa_value_from_bool(l <= r); return true;
+        case RISA_TOKEN_GREATER:       *result = risa_value_from_bool(r < l);  return true;
+        case RISA_TOKEN_GREATER_EQUAL: *result = risa_value_from_bool(r <= l); return true;
+        case RISA_TOKEN_LESS_LESS:
+        case RISA_TOKEN_GREATER_GREATER:
+            if(l < 0 || r < 0)
+                return false;
+
+            // Bytes are shifted as C ints, so keep the result within 31 bits.
+            if(isLeftByte) {
+                if(r >= (operator == RISA_TOKEN_LESS_LESS ? 24 : 32))
+                    return false;
+
+                *result = risa_value_from_byte(operator == RISA_TOKEN_LESS_LESS ? l << r : l >> r);
+                return true;
+            }
+
+            if(r >= 64 || (operator == RISA_TOKEN_LESS_LESS && l > (INT64_MAX >> r)))
+                return false;
+
+            *result = risa_value_from_int(operator == RISA_TOKEN_LESS_LESS ? l << r : l >> r);
+            return true;
+        case RISA_TOKEN_SLASH:
+        case RISA_TOKEN_PERCENT:
+            if(r == 0 || (l == INT64_MIN && r == -1))
+                return false;
+            break;
+        default:
+            break;
+    }
+
+    // Operations on two bytes wrap around, like in the VM.
+    if(isLeftByte && isRightByte) {
+        switch(operator) {
+            case RISA_TOKEN_PLUS:      *result = risa_value_from_byte(l + r); return true;
+            case RISA_TOKEN_MINUS:     *result = risa_value_from_byte(l - r); return true;
+            case RISA_TOKEN_STAR:      *result = risa_value_from_byte(l * r); return true;
+            case RISA_TOKEN_SLASH:     *result = risa_value_from_byte(l / r); return true;
+            case RISA_TOKEN_PERCENT:   *result = risa_value_from_byte(l % r); return true;
+            case RISA_TOKEN_AMPERSAND: *result = risa_value_from_byte(l & r); return true;
+            case RISA_TOKEN_CARET:     *result = risa_value_from_byte(l ^ r); return true;
+            case RISA_TOKEN_PIPE:      *result = risa_value_from_byte(l | r); return true;
+            default:                   return false;
+        }
+    }
+
+    switch(operator) {
+        case RISA_TOKEN_PLUS:
+            if((r > 0 && l > INT64_MAX - r) || (r < 0 && l < INT64_MIN - r))
+                return false;
+
+            *result = risa_value_from_int(l + r);
+            return true;
+        case RISA_TOKEN_MINUS:
+            if((r < 0 && l > INT64_MAX + r) || (r > 0 && l < INT64_MIN + r))
+                return false;
+
+            *result = risa_value_from_int(l - r);
+            return true;
+        case RISA_TOKEN_STAR:
+            if(l != 0 && r != 0) {
+                if(l > 0 ? (r > 0 ? l > INT64_MAX / r : r < INT64_MIN / l)
+                         : (r > 0 ? l < INT64_MIN / r : r < INT64_MAX / l))
+                    return false;
+            }
+
+            *result = risa_value_from_int(l * r);
+            return true;
+        case RISA_TOKEN_SLASH:
+            *result = risa_value_from_int(l / r);
+            return true;
+        case RISA_TOKEN_PERCENT:
+            // The result is only an int when both operands are ints.
+            *result = isLeftByte || isRightByte ? risa_value_from_byte(l % r) : risa_value_from_int(l % r);
+            return true;
+        case RISA_TOKEN_AMPERSAND: *result = risa_value_from_int(l & r); return true;
+        case RISA_TOKEN_CARET:     *result = risa_value_from_int(l ^ r); return true;
+        case RISA_TOKEN_PIPE:      *result = risa_value_from_int(l | r); return true;
+        default:                   return false;
+    }
+}
+
+static void risa_compiler_emit_folded(RisaCompiler* compiler, RisaValue value) {
+    // The register must already be reserved. It is marked as TEMP, so that literals can't find it.
+    risa_compiler_emit_constant(compiler, value);
+
+    compiler->last.reg = compiler->regIndex - 1;
+    compiler->regs[compiler->last.reg] = (RisaRegInfo) {RISA_REG_TEMP };
+    compiler->last.isConstOptimized = false;
+    compiler->last.isNew = true;
+    compiler->last.isConst = true;
+    compiler->last.isLvalue = false;
+    compiler->last.isPostIncrement = false;
+    compiler->last.isEqualOp = false;
+    compiler->last.fromBranched = false;
+}
+
+static bool risa_compiler_constant_resolve(RisaCompiler* compiler, RisaToken* identifier, RisaValue* value) {
+    // The innermost local with that name decides, even if it belongs to an enclosing function.
+    for(; compiler != NULL; compiler = compiler->super) {
+        uint8_t reg = risa_compiler_local_resolve(compiler, identifier);
+
+        if(reg == 251)
+            continue;
+
+        RisaLocalInfo* local = risa_compiler_local_find(compiler, reg);
+
+        if(local == NULL || !local->isConst)
+            return false;
+
+        *value = local->value;
+        return true;
+    }
+
+    return false;
+}
+
+static bool risa_compiler_constant_is_reassigned(RisaCompiler* compiler, RisaToken* identifier) {
+    // Scans the rest of the enclosing block, including nested functions. Any assignment, increment, property access or
+    // declaration that uses the name counts, as well as inline asm, which can write to any register.
+    RisaLexer lexer = compiler->parser->lexer;
+
+    RisaToken previous = compiler->parser->previous;
+    RisaToken token = compiler->parser->current;
+
+    uint32_t depth = 0;
+
+    while(token.type != RISA_TOKEN_EOF) {
+        RisaToken next = risa_lexer_next(&lexer);
+
+        switch(token.type) {
+            case RISA_TOKEN_LEFT_BRACE:
+                ++depth;
+                break;
+            case RISA_TOKEN_RIGHT_BRACE:
+                if(depth == 0)
+                    return false;
+
+                --depth;
+                break;
+            case RISA_TOKEN_DOLLAR:
+            case RISA_TOKEN_ERROR:
+                return true;
+            case RISA_TOKEN_IDENTIFIER:
+                if(!risa_token_identifier_equals(&token, identifier))
+                    break;
+
+                switch(previous.type) {
+                    case RISA_TOKEN_PLUS_PLUS:
+                    case RISA_TOKEN_MINUS_MINUS:
+                    case RISA_TOKEN_VAR:
+                    case RISA_TOKEN_FUNCTION:
+                        return true;
+                    default:
+                        break;
+                }
+
+                switch(next.type) {
+                    case RISA_TOKEN_EQUAL:
+                    case RISA_TOKEN_PLUS_EQUAL:
+                    case RISA_TOKEN_MINUS_EQUAL:
+                    case RISA_TOKEN_STAR_EQUAL:
+                    case RISA_TOKEN_SLASH_EQUAL:
+                    case RISA_TOKEN_CARET_EQUAL:
+                    case RISA_TOKEN_PERCENT_EQUAL:
+                    case RISA_TOKEN_PIPE_EQUAL:
+                    case RISA_TOKEN_AMPERSAND_EQUAL:
+                    case RISA_TOKEN_PLUS_PLUS:
+                    case RISA_TOKEN_MINUS_MINUS:
+                    case RISA_TOKEN_DOT:
+                    case RISA_TOKEN_LEFT_BRACKET:
+                        return true;
+                    default:
+                        break;
+                }
+                break;
+            default:
+                break;
+        }
+
+        previous = token;
+        token = next;
+    }
+
+    return false;
+}
+
 static bool risa_compiler_register_reserve(RisaCompiler* compiler) {
     if(compiler->regIndex == 249) {
         risa_parser_error_at_current(compiler->parser, "Register limit exceeded (250)");
@@ -2939,7 +3565,7 @@ static bool risa_compiler_register_reserve(RisaCompiler* compiler) {
     }
     else {
         compiler->regs[compiler->regIndex] = (RisaRegInfo) {RISA_REG_TEMP };
-        ++compiler->regIndex;
+        risa_compiler_register_increment(compiler);
         return true;
     }
 }
@@ -2955,6 +3581,14 @@ static uint8_t risa_compiler_register_find(RisaCompiler* compiler, RisaRegType t
     return 251;
 }
 
+static void risa_compiler_register_increment(RisaCompiler* compiler) {
+    ++compiler->regIndex;
+
+    // The frame of the function only reserves as many registers as were in use at once.
+    if(compiler->regIndex > compiler->function->cluster.registerCount)
+        compiler->function->cluster.registerCount = compiler->regIndex;
+}
+
 static void risa_compiler_register_free(RisaCompiler* compiler) {
     --compiler->regIndex;
 }
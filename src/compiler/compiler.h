@@ -32,11 +32,21 @@ typedef struct {
     uint8_t reg;
 
     bool captured;
+    bool borrowed;    // Whether or not the register was taken over from a local that is never read again.
+    bool lent;        // Whether or not a later local took over the register.
+
+    uint32_t closure; // The offset of the CLSR that initializes the local, or UINT32_MAX if it doesn't hold a closure.
+    uint16_t reads;   // How many times the local was read.
+    uint16_t calls;   // How many of those reads were only used to call the local.
+
+    bool isConst;     // Whether or not the local is initialized with a constant and never reassigned.
+    RisaValue value;  // The constant, which replaces every read of the local.
 } RisaLocalInfo;
 
 typedef struct {
     uint8_t index;
     bool local;
+    bool captured; // Whether or not a nested function captures the upvalue in turn.
 } RisaUpvalueInfo;
 
 typedef struct {
@@ -69,6 +79,8 @@ typedef struct RisaCompiler {
         bool isEqualOp;            // Whether or not the last value is the result of an equality operation.
         bool canOverwrite;         // Whether or not the last value register can be overwritten. Used to prevent an object property from overwriting a global value in a temporary reg.
         bool fromBranched;         // Whether or not the last value comes from one of multiple branches (e.g. ternary). Required to disable bad CNST optimizations.
+        uint8_t callee;            // The register of the local that was called by the last CALL, or 251.
+        uint32_t closure;          // The offset of the CLSR emitted by the last lambda, or UINT32_MAX if it has no upvalues or one of them is captured again.
 
         struct {
             enum LValType {
@@ -84,6 +96,7 @@ typedef struct RisaCompiler {
             uint8_t globalReg;  // In which register the global temporarily resides.
             uint8_t propOrigin; // The register in which the property holder resides.
             uint8_t upval;
+            uint8_t local;      // The register of the local.
 
             struct {
                 union {
@@ -96,16 +109,17 @@ typedef struct RisaCompiler {
         } lvalMeta;
     } last;
 
-    RisaLocalInfo locals[250];
+    RisaLocalInfo locals[RISA_COMPILER_LOCAL_COUNT];
     RisaUpvalueInfo upvalues[250];
     RisaLeapInfo leaps[250];
 
-    uint8_t localCount;
+    uint16_t localCount;
     uint8_t upvalueCount;
     uint8_t loopCount;
     uint8_t leapCount;
 
     int32_t scopeDepth;
+    uint32_t loopStart; // The source index from which the innermost loop runs again, or 0 outside loops.
 } RisaCompiler;
 
 typedef enum {
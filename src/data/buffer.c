@@ -78,6 +78,7 @@ uint8_t* risa_buffer_release(RisaBuffer* buffer) {
 void risa_const_buffer_init(RisaConstBuffer* buffer) {
     buffer->data = NULL;
     buffer->size = 0;
+    buffer->index = 0;
 }
 
 void risa_const_buffer_delete(RisaConstBuffer* buffer) {
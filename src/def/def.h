@@ -2,6 +2,7 @@
 #define RISA_DEF_H_GUARD
 
 #include <float.h>
+#include <stdint.h>
 
 #include "macro.h"
 
@@ -14,8 +15,10 @@
 #define RISA_MATH_RAD2DEG  (180 / RISA_MATH_PI)
 #define RISA_MATH_DEG2RAD  (RISA_MATH_PI / 180)
 
+// The default maximum call depth. The frame array and the stack start small and grow up to these limits,
+// which can be changed for each VM with 'risa_vm_set_limits'.
 #ifndef RISA_VM_CALLFRAME_COUNT
-    #define RISA_VM_CALLFRAME_COUNT 64
+    #define RISA_VM_CALLFRAME_COUNT 1024
 #endif
 
 #ifndef RISA_VM_CALLFRAME_STACK_SIZE
@@ -26,10 +29,156 @@
     #define RISA_VM_STACK_SIZE (RISA_VM_CALLFRAME_COUNT * RISA_VM_CALLFRAME_STACK_SIZE)
 #endif
 
+#ifndef RISA_VM_CALLFRAME_INITIAL_COUNT
+    #define RISA_VM_CALLFRAME_INITIAL_COUNT 8
+#endif
+
+// Enough for the registers of the first frame, so loading a function never needs to grow the stack.
+#ifndef RISA_VM_STACK_INITIAL_SIZE
+    #define RISA_VM_STACK_INITIAL_SIZE 256
+#endif
+
 #ifndef RISA_VM_HEAP_INITIAL_THRESHOLD
     #define RISA_VM_HEAP_INITIAL_THRESHOLD (64 * RISA_KILOBYTE)
 #endif
 
+// The default GC pacing of a VM, which can be changed with 'risa_vm_set_gc_pacing'. After every full collection, the
+// heap threshold is set to the size of the live values times the growth factor, clamped between the minimum and the
+// maximum threshold (0 means no maximum). If the CPU target (a percentage) isn't 0, the growth factor is adjusted after
+// every collection so that collecting takes about that share of the time since the previous one.
+#ifndef RISA_GC_GROWTH_FACTOR
+    #define RISA_GC_GROWTH_FACTOR 2.0
+#endif
+
+#ifndef RISA_GC_MIN_THRESHOLD
+    #define RISA_GC_MIN_THRESHOLD RISA_VM_HEAP_INITIAL_THRESHOLD
+#endif
+
+#ifndef RISA_GC_MAX_THRESHOLD
+    #define RISA_GC_MAX_THRESHOLD 0
+#endif
+
+#ifndef RISA_GC_CPU_TARGET
+    #define RISA_GC_CPU_TARGET 0
+#endif
+
+// The default heap limit of a VM, in bytes. Once the heap is still larger than this after a full collection, the
+// allocation fails with a runtime error. 0 means no limit; it can be changed for each VM with 'risa_vm_set_heap_limit'.
+#ifndef RISA_VM_HEAP_LIMIT
+    #define RISA_VM_HEAP_LIMIT 0
+#endif
+
+// Define RISA_GC_GENERATIONAL to allocate new values in a nursery, which is collected on its own once it holds this
+// many bytes. The values that survive are promoted to the old generation, which is bounded by the heap threshold.
+#ifndef RISA_GC_NURSERY_SIZE
+    #define RISA_GC_NURSERY_SIZE (256 * RISA_KILOBYTE)
+#endif
+
+// Define RISA_GC_INCREMENTAL to split the marking into steps that run while the script does. A step runs every time the
+// heap grows by RISA_GC_STEP_SIZE bytes, and stops after the pause target of the VM (in microseconds, RISA_GC_PAUSE_TARGET
+// by default, and changed with 'risa_vm_set_gc_pause_target'). The incremental GC can't be combined with the
+// generational one.
+#if defined(RISA_GC_INCREMENTAL) && defined(RISA_GC_GENERATIONAL)
+    #undef RISA_GC_INCREMENTAL
+#endif
+
+#ifndef RISA_GC_STEP_SIZE
+    #define RISA_GC_STEP_SIZE (16 * RISA_KILOBYTE)
+#endif
+
+#ifndef RISA_GC_PAUSE_TARGET
+    #define RISA_GC_PAUSE_TARGET 1000
+#endif
+
+// Marking uses a stack of values instead of recursion. It holds at most this many values, and once it is full, the
+// marked values are scanned again to find the ones that didn't fit.
+#ifndef RISA_GC_MARK_STACK_SIZE
+    #define RISA_GC_MARK_STACK_SIZE (64 * RISA_KILOBYTE)
+#endif
+
+// Define RISA_GC_PARALLEL to mark on RISA_GC_WORKER_COUNT threads, including the one that runs the script, or on one
+// thread per core (up to 8) if it is 0. Collections that may mark less than RISA_GC_PARALLEL_MIN_HEAP bytes aren't worth
+// waking the threads for. This needs GCC and POSIX threads, and can't be combined with the incremental GC.
+#if defined(RISA_GC_PARALLEL) && (defined(RISA_GC_INCREMENTAL) || !(defined(COMPILER_GCC) && defined(__unix__)))
+    #undef RISA_GC_PARALLEL
+#endif
+
+#ifndef RISA_GC_WORKER_COUNT
+    #define RISA_GC_WORKER_COUNT 0
+#endif
+
+#ifndef RISA_GC_PARALLEL_MIN_HEAP
+    #define RISA_GC_PARALLEL_MIN_HEAP (1024 * RISA_KILOBYTE)
+#endif
+
+// Define RISA_GC_LAZY_SWEEP to free the unreachable values after the collection, this many at every allocation, so
+// that the pause only lasts as long as the marking. Collections started with 'risa_gc_run' still sweep everything.
+#ifndef RISA_GC_SWEEP_STEP
+    #define RISA_GC_SWEEP_STEP 256
+#endif
+
+// Define RISA_VM_SLABS to allocate the small values created by the VM out of per-VM chunks of this size, with one
+// free list for every multiple of the granule up to the maximum size. Larger values still use RISA_MEM_ALLOC.
+#ifndef RISA_SLAB_GRANULE
+    #define RISA_SLAB_GRANULE 16
+#endif
+
+#ifndef RISA_SLAB_MAX_SIZE
+    #define RISA_SLAB_MAX_SIZE 256
+#endif
+
+#ifndef RISA_SLAB_CHUNK_SIZE
+    #define RISA_SLAB_CHUNK_SIZE (64 * RISA_KILOBYTE)
+#endif
+
+// Objects with more properties than this, or created from a shape with too many transitions, fall back to a map.
+#ifndef RISA_SHAPE_MAX_PROPERTIES
+    #define RISA_SHAPE_MAX_PROPERTIES 32
+#endif
+
+#ifndef RISA_SHAPE_MAX_TRANSITIONS
+    #define RISA_SHAPE_MAX_TRANSITIONS 32
+#endif
+
+// Number of shapes remembered by every GET/SET inline cache.
+#ifndef RISA_VM_INLINE_CACHE_SIZE
+    #define RISA_VM_INLINE_CACHE_SIZE 2
+#endif
+
+// Labels as values (&&label) are required for threaded dispatch. Define RISA_VM_SWITCH_DISPATCH to force the switch.
+#if defined(COMPILER_GCC) && !defined(RISA_VM_SWITCH_DISPATCH) && !defined(RISA_VM_THREADED_DISPATCH)
+    #define RISA_VM_THREADED_DISPATCH
+#endif
+
+// Locals a function can declare at once. Only 250 registers exist, but locals that are never read again give their
+// register to the ones declared after them, so more of them may be in scope.
+#ifndef RISA_COMPILER_LOCAL_COUNT
+    #define RISA_COMPILER_LOCAL_COUNT 512
+#endif
+
+// Script functions with at most this many instructions are inlined by 'risa -c -O', unless '--no-inline' follows the
+// '-O'. Define RISA_OPTIMIZER_NO_INLINE to leave inlining out of every build of the optimizer.
+#ifndef RISA_OPTIMIZER_INLINE_SIZE
+    #define RISA_OPTIMIZER_INLINE_SIZE 16
+#endif
+
+// Values are NaN-boxed into 8 bytes instead of 16, which halves the size of registers, arrays and constants, but
+// limits ints to 48 bits. This needs 64-bit pointers that fit in 48 bits (e.g. x86-64 and AArch64).
+#if defined(RISA_VALUE_NAN_BOXING) && UINTPTR_MAX != 0xFFFFFFFFFFFFFFFFu
+    #undef RISA_VALUE_NAN_BOXING
+#endif
+
+// The baseline JIT compiles hot functions to machine code. It only supports x86-64 Linux and 16-byte values, and is
+// left out unless RISA_VM_JIT is defined.
+#if defined(RISA_VM_JIT) && (defined(RISA_VALUE_NAN_BOXING) || !(defined(COMPILER_GCC) && defined(__x86_64__) && defined(__linux__)))
+    #undef RISA_VM_JIT
+#endif
+
+// Calls and back jumps before a function is compiled by the JIT.
+#ifndef RISA_VM_JIT_THRESHOLD
+    #define RISA_VM_JIT_THRESHOLD 1000
+#endif
+
 #ifndef RISA_INPUT_WORD_BUFFER_SIZE
     #define RISA_INPUT_WORD_BUFFER_SIZE 128
 #endif
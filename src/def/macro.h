@@ -15,6 +15,14 @@
     #define DEBUG
 #endif
 
+#if defined(COMPILER_MSVC)
+    #define RISA_THREAD_LOCAL __declspec(thread)
+#elif defined(COMPILER_GCC)
+    #define RISA_THREAD_LOCAL __thread
+#else
+    #define RISA_THREAD_LOCAL
+#endif
+
 #define RISA_STRINGIFY_DIRECTLY(str) #str
 #define RISA_STRINGIFY(str) RISA_STRINGIFY_DIRECTLY(str)
 
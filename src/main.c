@@ -1,5 +1,6 @@
 #include "risa.h"
 
+#include "asm/disassembler.h"
 #include "def/types.h"
 #include "io/log.h"
 
@@ -16,7 +17,7 @@
 void run_repl(RisaIO io);
 void run_args(RisaIO io, int argc, char* argv[]);
 void run_file(RisaIO io, const char* path);
-void compile_file(RisaIO io, const char* input, const char* output);
+void compile_file(RisaIO io, const char* input, const char* output, bool optimize, bool inlining);
 
 RisaVM create_vm();
 
@@ -81,7 +82,7 @@ void run_repl(RisaIO io) {
 
         RisaInterpretStatus status = risa_interpret_string(&vm, line);
 
-        if(status == RISA_INTERPRET_OK && vm.acc.type != RISA_VAL_NULL)
+        if(status == RISA_INTERPRET_OK && !risa_value_is_null(vm.acc))
             risa_value_print(&vm.io, vm.acc);
 
         RISA_OUT(io, "\n");
@@ -90,11 +91,26 @@ void run_repl(RisaIO io) {
 
 void run_args(RisaIO io, int argc, char* argv[]) {
     if(0 == strcmp(argv[1], "-c")) {
-        if(argc < 4) {
+        bool optimize = argc > 2 && 0 == strcmp(argv[2], "-O");
+        bool noInline = optimize && argc > 3 && 0 == strcmp(argv[3], "--no-inline");
+        int flags = optimize + noInline;
+
+        if(argc < 4 + flags) {
+            TERMINATE(io, 64, "Invalid arguments");
+        }
+
+        compile_file(io, argv[2 + flags], argv[3 + flags], optimize, !noInline);
+    } else if(0 == strcmp(argv[1], "-d")) {
+        bool optimize = argc > 2 && 0 == strcmp(argv[2], "-O");
+        bool noInline = optimize && argc > 3 && 0 == strcmp(argv[3], "--no-inline");
+        int flags = optimize + noInline;
+
+        if(argc < 3 + flags) {
             TERMINATE(io, 64, "Invalid arguments");
         }
 
-        compile_file(io, argv[2], argv[3]);
+        // Without an output, the compiled bytecode is dumped with its basic blocks.
+        compile_file(io, argv[2 + flags], NULL, optimize, !noInline);
     } else {
         run_file(io, argv[1]);
     }
@@ -168,7 +184,7 @@ void run_file(RisaIO io, const char* path) {
     }
 }
 
-void compile_file(RisaIO io, const char* input, const char* output) {
+void compile_file(RisaIO io, const char* input, const char* output, bool optimize, bool inlining) {
     FILE* file = fopen(input, "rb");
 
     if(file == NULL)
@@ -198,6 +214,22 @@ void compile_file(RisaIO io, const char* input, const char* output) {
     RISA_MEM_FREE(data);
 
     if(status == RISA_COMPILER_STATUS_OK) {
+        if(optimize)
+            risa_cluster_optimize(&compiler.function->cluster, inlining);
+
+        if(output == NULL) {
+            RisaDisassembler disasm;
+            risa_disassembler_init(&disasm);
+            risa_io_clone(&disasm.io, &io);
+            risa_disassembler_blocks(&disasm, true);
+
+            risa_disassembler_load(&disasm, &compiler.function->cluster);
+            risa_disassembler_run(&disasm);
+
+            risa_compiler_delete(&compiler);
+            return;
+        }
+
         uint32_t compiledSize = 0;
         uint8_t* compiled = risa_serialize_cluster(&compiler.function->cluster, &compiledSize);
 
@@ -1,122 +1,978 @@
 #include "gc.h"
+#include "mem.h"
 #include "../vm/vm.h"
 #include "../io/log.h"
 
 #include <string.h>
+#include <time.h>
 
-static void gc_mark_dense(RisaDenseValue* dense);
-static void gc_mark_map(RisaMap* map);
+#ifdef RISA_GC_PARALLEL
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+// The number of grey values marked between two checks of the pause target.
+#define GC_STEP_GRANULE 64
+
+// The CPU target of the pacing scales the growth factor by at most this much (or its inverse) after every collection.
+#define GC_PACE_MAX_STEP 2.0
+
+// Arrays are marked this many elements at a time, so that a large array doesn't fill the grey stack.
+#define GC_ARRAY_CHUNK 128
+
+#ifdef RISA_GC_PARALLEL
+
+// The parallel workers keep their grey values in batches of this size. Full batches are shared with the other workers.
+#define GC_BATCH_SIZE 256
+
+// The default number of workers is the number of cores, up to this many.
+#define GC_MAX_WORKERS 8
+
+typedef struct GCBatch {
+    struct GCBatch* next;
+    uint32_t count;
+    RisaGreyValue values[GC_BATCH_SIZE];
+} GCBatch;
+
+typedef struct GCWorker {
+    struct RisaGCPool* pool;
+    pthread_t thread;
+    uint32_t epoch;
+
+    GCBatch* batch; // Private to the worker, until it is full.
+} GCWorker;
+
+// The workers wait for 'epoch' to change, and mark until none of them has grey values left. The first worker is the
+// thread that runs the collection, so it has no thread of its own.
+struct RisaGCPool {
+    RisaVM* vm;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t work;
+    pthread_cond_t done;
+
+    uint32_t epoch;
+    bool stopping;
+
+    GCBatch* full;  // Shared batches that can be taken by any worker.
+    GCBatch* empty; // Reused instead of allocating new batches.
+    uint32_t fullCount;
+
+    uint32_t idle;
+    uint32_t finished;
+
+    uint32_t workerCount;
+    GCWorker* workers;
+};
+
+// The worker that runs on this thread, or NULL for the mutator outside of a parallel mark.
+static __thread GCWorker* gcWorker = NULL;
+
+#endif
+
+static void gc_mark_roots(RisaVM* vm);
+static void gc_mark_dense(RisaVM* vm, RisaDenseValue* dense);
+static void gc_mark_children(RisaVM* vm, RisaDenseValue* dense, uint32_t start);
+static void gc_mark_map(RisaVM* vm, RisaMap* map);
+static void gc_mark_shape(RisaVM* vm, RisaShape* shape);
+static void gc_push_grey(RisaVM* vm, RisaDenseValue* dense, uint32_t start);
+static void gc_pop_grey(RisaVM* vm);
+static void gc_drain(RisaVM* vm);
+static bool gc_rescan(RisaVM* vm);
+static void gc_collect(RisaVM* vm);
+static void gc_erase_strings(RisaVM* vm);
 static void gc_sweep(RisaVM* vm);
+static void gc_count_time(RisaVM* vm, clock_t start);
+static void gc_pace(RisaVM* vm);
 
-void risa_gc_check(RisaVM* vm) {
-    if(vm->heapSize >= vm->heapThreshold) {
-        risa_gc_run(vm);
-        vm->heapThreshold *= 2;
-    }
+#ifdef RISA_GC_LAZY_SWEEP
+    static void gc_sweep_step(RisaVM* vm, uint32_t count);
+    static void gc_sweep_finish(RisaVM* vm);
+#endif
+
+#ifdef RISA_GC_GENERATIONAL
+    static void gc_sweep_young(RisaVM* vm);
+#endif
+
+#if defined(RISA_GC_GENERATIONAL) || defined(RISA_GC_INCREMENTAL)
+    static void gc_forget(RisaVM* vm);
+#endif
+
+#ifdef RISA_GC_INCREMENTAL
+    static bool gc_mark_grey(RisaVM* vm, clock_t deadline);
+    static void gc_finish(RisaVM* vm);
+#endif
+
+#ifdef RISA_GC_PARALLEL
+    static void     gc_mark_parallel   (RisaVM* vm);
+    static void     gc_pool_start      (RisaVM* vm);
+    static void     gc_pool_stop       (RisaVM* vm);
+    static void*    gc_worker_main     (void* arg);
+    static void     gc_worker_run      (GCWorker* worker);
+    static void     gc_worker_push     (GCWorker* worker, RisaDenseValue* dense, uint32_t start);
+    static bool     gc_worker_take     (GCWorker* worker);
+    static void     gc_worker_share    (GCWorker* worker);
+    static GCBatch* gc_batch_get       (struct RisaGCPool* pool);
+#endif
+
+bool risa_gc_check(RisaVM* vm) {
+    #ifdef RISA_GC_LAZY_SWEEP
+        if(vm->sweeping != NULL) {
+            // The steps are too short to time with clock(), so only the marking counts towards the CPU target.
+            gc_sweep_step(vm, RISA_GC_SWEEP_STEP);
+
+            if(vm->gcPacePending)
+                gc_pace(vm);
+        }
+    #endif
+
+    #if defined(RISA_GC_GENERATIONAL)
+        // The nursery always has the same size, and the old generation grows like the whole heap does otherwise.
+        size_t oldSize = vm->heapSize > vm->youngSize ? vm->heapSize - vm->youngSize : 0;
+
+        if(oldSize >= vm->heapThreshold) {
+            gc_collect(vm);
+        } else if(vm->youngSize >= RISA_GC_NURSERY_SIZE) {
+            risa_gc_run_minor(vm);
+        }
+    #elif defined(RISA_GC_INCREMENTAL)
+        // Once a collection has started, a step runs every time the heap grows by RISA_GC_STEP_SIZE.
+        if(vm->heapSize >= (vm->gcMarking ? vm->gcStepThreshold : vm->heapThreshold))
+            risa_gc_step(vm);
+    #else
+        if(vm->heapSize >= vm->heapThreshold)
+            gc_collect(vm);
+    #endif
+
+    if(vm->heapLimit == 0 || vm->heapSize <= vm->heapLimit)
+        return true;
+
+    risa_gc_run(vm);
+    return vm->heapSize <= vm->heapLimit;
 }
 
 void risa_gc_run(RisaVM* vm) {
+    gc_collect(vm);
+
+    #ifdef RISA_GC_LAZY_SWEEP
+        // Unlike the collections started by risa_gc_check, this one frees the unreachable values before returning.
+        gc_sweep_finish(vm);
+
+        if(vm->gcPacePending)
+            gc_pace(vm);
+    #endif
+}
+
+// A full collection. With RISA_GC_LAZY_SWEEP, the unreachable values are only freed by the next calls to risa_gc_check.
+static void gc_collect(RisaVM* vm) {
+    // Running out of memory halfway through a collection would leave the marks behind, so there's no recovering from it.
+    jmp_buf* recovery = risa_mem_set_recovery(NULL);
+    clock_t start = clock();
+
+    #ifdef RISA_GC_INCREMENTAL
+        // Finishes the collection in progress in one go, or runs a whole new one.
+        if(!vm->gcMarking) {
+            #ifdef RISA_GC_LAZY_SWEEP
+                gc_sweep_finish(vm);
+            #endif
+
+            gc_mark_roots(vm);
+        }
+
+        gc_finish(vm);
+    #else
+        #ifdef RISA_GC_LAZY_SWEEP
+            gc_sweep_finish(vm);
+        #endif
+
+        #ifdef RISA_GC_GENERATIONAL
+            // Old values stay marked between collections, which is how the minor collections skip them. A full collection
+            // marks everything, so it doesn't need the remembered set either.
+            for(RisaDenseValue* dense = vm->values; dense != NULL; dense = dense->link)
+                dense->marked = false;
+
+            gc_forget(vm);
+        #endif
+
+        gc_mark_roots(vm);
+
+        #ifdef RISA_GC_PARALLEL
+            if(vm->heapSize >= RISA_GC_PARALLEL_MIN_HEAP)
+                gc_mark_parallel(vm);
+        #endif
+
+        gc_drain(vm);
+        gc_erase_strings(vm);
+        gc_sweep(vm);
+
+        #ifdef RISA_GC_GENERATIONAL
+            gc_sweep_young(vm);
+        #endif
+    #endif
+
+    gc_count_time(vm, start);
+    risa_mem_set_recovery(recovery);
+}
+
+void risa_gc_run_minor(RisaVM* vm) {
+    #ifdef RISA_GC_GENERATIONAL
+        jmp_buf* recovery = risa_mem_set_recovery(NULL);
+        clock_t start = clock();
+
+        // The old values are still marked, so marking stops at them. The ones that were written to since the last
+        // collection may point to young values, so their children are marked too.
+        gc_mark_roots(vm);
+
+        for(uint32_t i = 0; i < vm->rememberedCount; ++i)
+            gc_mark_children(vm, vm->remembered[i], 0);
+
+        #ifdef RISA_GC_PARALLEL
+            if(vm->youngSize >= RISA_GC_PARALLEL_MIN_HEAP)
+                gc_mark_parallel(vm);
+        #endif
+
+        gc_drain(vm);
+        gc_erase_strings(vm);
+        gc_sweep_young(vm);
+        gc_forget(vm);
+
+        gc_count_time(vm, start);
+        risa_mem_set_recovery(recovery);
+    #else
+        risa_gc_run(vm);
+    #endif
+}
+
+void risa_gc_step(RisaVM* vm) {
+    #ifdef RISA_GC_INCREMENTAL
+        jmp_buf* recovery = risa_mem_set_recovery(NULL);
+        clock_t start = clock();
+
+        // The roots are only made grey here, so starting a collection takes as long as scanning the stack and globals.
+        if(!vm->gcMarking) {
+            #ifdef RISA_GC_LAZY_SWEEP
+                gc_sweep_finish(vm);
+            #endif
+
+            vm->gcMarking = true;
+            gc_mark_roots(vm);
+        }
+
+        clock_t deadline = start + (clock_t) ((double) vm->gcPauseTarget * CLOCKS_PER_SEC / 1000000);
+
+        if(gc_mark_grey(vm, deadline))
+            gc_finish(vm);
+        else vm->gcStepThreshold = vm->heapSize + RISA_GC_STEP_SIZE;
+
+        gc_count_time(vm, start);
+        risa_mem_set_recovery(recovery);
+    #else
+        risa_gc_run(vm);
+    #endif
+}
+
+void risa_gc_remember(RisaVM* vm, RisaDenseValue* dense) {
+    while(vm->rememberedCapacity <= vm->rememberedCount)
+        vm->remembered = (RisaDenseValue**) RISA_MEM_EXPAND(vm->remembered, &vm->rememberedCapacity, sizeof(RisaDenseValue*));
+
+    dense->remembered = true;
+    vm->remembered[vm->rememberedCount++] = dense;
+}
+
+static void gc_mark_roots(RisaVM* vm) {
     for(RisaValue* i = vm->stack; i < vm->stackTop; ++i)
         if(value_is_dense(*i))
-            gc_mark_dense(risa_value_as_dense(*i));
+            gc_mark_dense(vm, risa_value_as_dense(*i));
+
+    // The registers past the top belong to frames that returned. The values left there may be freed by this collection,
+    // and the next frames would expose them again (along with the closures that the stack growth scans), so they go.
+    for(RisaValue* i = vm->stackTop; i < vm->stack + vm->stackCapacity; ++i)
+        *i = risa_value_from_null();
 
     for(uint32_t i = 0; i < vm->frameCount; ++i)
-        gc_mark_dense((RisaDenseValue*) VM_FRAME_FUNCTION(vm->frames[i]));
+        gc_mark_dense(vm, (RisaDenseValue*) VM_FRAME_FUNCTION(vm->frames[i]));
 
     for(RisaDenseUpvalue* i = vm->upvalues; i != NULL; i = (RisaDenseUpvalue*) i->next)
-        gc_mark_dense((RisaDenseValue*) i);
+        gc_mark_dense(vm, (RisaDenseValue*) i);
 
-    gc_mark_map(&vm->globals);
+    for(uint32_t i = 0; i < vm->globalCount; ++i) {
+        gc_mark_dense(vm, (RisaDenseValue*) vm->globals[i].name);
 
-    if(value_is_dense(vm->acc)) {
-        gc_mark_dense(risa_value_as_dense(vm->acc));
+        if(value_is_dense(vm->globals[i].value))
+            gc_mark_dense(vm, risa_value_as_dense(vm->globals[i].value));
     }
 
-    for(uint32_t i = 0; i < vm->strings.capacity; ++i) {
-        RisaMapEntry* entry = &vm->strings.entries[i];
-
-        if(entry->key != NULL && !((RisaDenseString*) entry->key)->dense.marked)
-            risa_map_erase(&vm->strings, entry->key);
+    if(value_is_dense(vm->acc)) {
+        gc_mark_dense(vm, risa_value_as_dense(vm->acc));
     }
-
-    gc_sweep(vm);
 }
 
-static void gc_mark_dense(RisaDenseValue* dense) {
+static void gc_mark_dense(RisaVM* vm, RisaDenseValue* dense) {
+    #ifdef RISA_GC_PARALLEL
+        // Several workers can reach the same value, and only the one that sets the mark bit pushes it.
+        if(gcWorker != NULL) {
+            if(dense != NULL && !__atomic_load_n(&dense->marked, __ATOMIC_RELAXED) && !__atomic_exchange_n(&dense->marked, true, __ATOMIC_RELAXED))
+                gc_worker_push(gcWorker, dense, 0);
+
+            return;
+        }
+    #endif
+
     if(dense == NULL || dense->marked)
         return;
     dense->marked = true;
 
+    // The children are marked once the value is popped from the grey stack, so deep structures don't overflow the C stack.
+    gc_push_grey(vm, dense, 0);
+}
+
+// Arrays are only marked from 'start', up to GC_ARRAY_CHUNK elements. The rest is pushed back on the grey stack.
+static void gc_mark_children(RisaVM* vm, RisaDenseValue* dense, uint32_t start) {
     switch(dense->type) {
         case RISA_DVAL_STRING:
         case RISA_DVAL_NATIVE:
             break;
         case RISA_DVAL_ARRAY: {
             RisaDenseArray* array = (RisaDenseArray*) dense;
+            uint32_t end = array->data.size;
+
+            // The array may have shrunk since it was pushed, during an incremental collection.
+            if(start >= end)
+                break;
 
-            for(uint32_t i = 0; i < array->data.size; ++i)
+            if(end - start > GC_ARRAY_CHUNK) {
+                end = start + GC_ARRAY_CHUNK;
+                gc_push_grey(vm, dense, end);
+            }
+
+            for(uint32_t i = start; i < end; ++i)
                 if(value_is_dense(array->data.values[i]))
-                    gc_mark_dense(risa_value_as_dense(array->data.values[i]));
+                    gc_mark_dense(vm, risa_value_as_dense(array->data.values[i]));
             break;
         }
-        case RISA_DVAL_OBJECT:
-            gc_mark_map(&((RisaDenseObject*) dense)->data);
+        case RISA_DVAL_OBJECT: {
+            RisaDenseObject* object = (RisaDenseObject*) dense;
+
+            if(object->shape != NULL) {
+                gc_mark_shape(vm, object->shape);
+
+                for(uint32_t i = 0; i < object->shape->count; ++i)
+                    if(value_is_dense(object->slots[i]))
+                        gc_mark_dense(vm, risa_value_as_dense(object->slots[i]));
+            } else gc_mark_map(vm, &object->data);
             break;
+        }
         case RISA_DVAL_UPVALUE:
             if(value_is_dense(((RisaDenseUpvalue*) dense)->closed))
-                gc_mark_dense(risa_value_as_dense(((RisaDenseUpvalue*) dense)->closed));
+                gc_mark_dense(vm, risa_value_as_dense(((RisaDenseUpvalue*) dense)->closed));
             break;
         case RISA_DVAL_FUNCTION: {
             RisaDenseFunction* function = (RisaDenseFunction*) dense;
-            gc_mark_dense((RisaDenseValue*) function->name);
+            gc_mark_dense(vm, (RisaDenseValue*) function->name);
 
             for(uint32_t i = 0; i < function->cluster.constants.size; ++i)
                 if(value_is_dense(function->cluster.constants.values[i]))
-                    gc_mark_dense(risa_value_as_dense(function->cluster.constants.values[i]));
+                    gc_mark_dense(vm, risa_value_as_dense(function->cluster.constants.values[i]));
+
+            // The shapes held by the inline caches must keep their keys alive.
+            if(function->caches != NULL) {
+                for(uint32_t i = 0; i < function->cluster.size / 4; ++i) {
+                    for(uint32_t j = 0; j < RISA_VM_INLINE_CACHE_SIZE; ++j) {
+                        gc_mark_shape(vm, function->caches[i].entries[j].shape);
+                        gc_mark_shape(vm, function->caches[i].entries[j].transition);
+                    }
+                }
+            }
             break;
         }
         case RISA_DVAL_CLOSURE: {
             RisaDenseClosure* closure = (RisaDenseClosure*) dense;
-            gc_mark_dense((RisaDenseValue*) closure->function);
+            gc_mark_dense(vm, (RisaDenseValue*) closure->function);
 
+            // Direct cells point into the registers, which are marked along with the stack.
             for(uint32_t i = 0; i < closure->upvalueCount; ++i)
-                gc_mark_dense((RisaDenseValue*) closure->upvalues[i]);
+                if(!risa_dense_closure_is_direct(closure, i))
+                    gc_mark_dense(vm, (RisaDenseValue*) closure->upvalues[i]);
             break;
         }
     }
 }
 
-static void gc_mark_map(RisaMap* map) {
+static void gc_mark_map(RisaVM* vm, RisaMap* map) {
     for(uint32_t i = 0; i < map->capacity; ++i) {
         RisaMapEntry* entry = &map->entries[i];
-        gc_mark_dense((RisaDenseValue*) entry->key);
+        gc_mark_dense(vm, (RisaDenseValue*) entry->key);
 
         if(value_is_dense(entry->value))
-            gc_mark_dense(risa_value_as_dense(entry->value));
+            gc_mark_dense(vm, risa_value_as_dense(entry->value));
+    }
+}
+
+static void gc_mark_shape(RisaVM* vm, RisaShape* shape) {
+    for(; shape != NULL && shape->parent != NULL; shape = shape->parent)
+        gc_mark_dense(vm, (RisaDenseValue*) shape->key);
+}
+
+static void gc_push_grey(RisaVM* vm, RisaDenseValue* dense, uint32_t start) {
+    #ifdef RISA_GC_PARALLEL
+        if(gcWorker != NULL) {
+            gc_worker_push(gcWorker, dense, start);
+            return;
+        }
+    #endif
+
+    if(vm->greyCount == vm->greyCapacity) {
+        // Instead of growing the stack without a limit, the value stays marked and is found again by gc_rescan.
+        if(vm->greyCapacity >= RISA_GC_MARK_STACK_SIZE) {
+            vm->greyOverflow = true;
+            return;
+        }
+
+        vm->grey = (RisaGreyValue*) RISA_MEM_EXPAND(vm->grey, &vm->greyCapacity, sizeof(RisaGreyValue));
+    }
+
+    vm->grey[vm->greyCount].dense = dense;
+    vm->grey[vm->greyCount].start = start;
+    ++vm->greyCount;
+}
+
+static void gc_pop_grey(RisaVM* vm) {
+    RisaGreyValue grey = vm->grey[--vm->greyCount];
+    gc_mark_children(vm, grey.dense, grey.start);
+}
+
+// Marks the children of the grey values until there are none left.
+static void gc_drain(RisaVM* vm) {
+    do {
+        while(vm->greyCount > 0)
+            gc_pop_grey(vm);
+    } while(gc_rescan(vm));
+}
+
+// If the grey stack was full, some of the marked values never got on it. In that case, the children of every marked
+// value are marked, and true is returned so that the caller checks the stack again.
+static bool gc_rescan(RisaVM* vm) {
+    if(!vm->greyOverflow)
+        return false;
+
+    vm->greyOverflow = false;
+
+    RisaDenseValue* lists[] = { vm->values, vm->young, vm->sweeping };
+
+    for(uint8_t i = 0; i < 3; ++i) {
+        for(RisaDenseValue* dense = lists[i]; dense != NULL; dense = dense->link) {
+            if(!dense->marked)
+                continue;
+
+            gc_mark_children(vm, dense, 0);
+
+            while(vm->greyCount > 0)
+                gc_pop_grey(vm);
+        }
+    }
+
+    return true;
+}
+
+static void gc_erase_strings(RisaVM* vm) {
+    for(uint32_t i = 0; i < vm->strings.capacity; ++i) {
+        RisaMapEntry* entry = &vm->strings.entries[i];
+
+        if(entry->key != NULL && !((RisaDenseString*) entry->key)->dense.marked)
+            risa_map_erase(&vm->strings, entry->key);
     }
 }
 
 static void gc_sweep(RisaVM* vm) {
-    RisaDenseValue* prev = NULL;
-    RisaDenseValue* dense = vm->values;
+    #ifdef RISA_GC_LAZY_SWEEP
+        // The values are only detached from the heap here. New values go to the empty list, so they aren't swept. The
+        // live size is only known once they are, so there's no collection until then.
+        vm->sweeping = vm->values;
+        vm->values = NULL;
+
+        vm->heapThreshold = SIZE_MAX;
+        vm->gcPacePending = false;
+    #else
+        RisaDenseValue* prev = NULL;
+        RisaDenseValue* dense = vm->values;
+
+        while(dense != NULL) {
+            if(dense->marked) {
+                #ifndef RISA_GC_GENERATIONAL
+                    dense->marked = false;
+                #endif
+
+                prev = dense;
+                dense = dense->link;
+            } else {
+                RisaDenseValue* unmarked = dense;
+
+                dense = dense->link;
+
+                if(prev != NULL)
+                    prev->link = dense;
+                else vm->values = dense;
+
+                vm->heapSize -= risa_dense_size(unmarked);
+
+                risa_vm_dense_free(vm, unmarked);
+            }
+        }
+
+        vm->gcPacePending = true;
+    #endif
+}
+
+// Adds the time since 'start' to the time spent collecting, then sets the heap threshold if the collection ended.
+static void gc_count_time(RisaVM* vm, clock_t start) {
+    vm->gcTime += clock() - start;
+
+    if(vm->gcPacePending)
+        gc_pace(vm);
+}
+
+// Sets the heap threshold from the values that survived the last full collection.
+static void gc_pace(RisaVM* vm) {
+    RisaGCPacing* pacing = &vm->gcPacing;
+    clock_t now = clock();
+    double growth = pacing->growthFactor;
+
+    if(pacing->cpuTarget != 0 && now > vm->gcCycleStart) {
+        // Collecting takes time in proportion to the live size, and the script runs while it allocates up to
+        // (growth - 1) times the live size. So scaling (growth - 1) by how far the measured share is from the target
+        // moves the next cycle towards it. The step is bounded, because a single measurement can be noisy.
+        double measured = (double) vm->gcTime / (double) (now - vm->gcCycleStart);
+        double target = pacing->cpuTarget / 100.0;
+
+        if(measured > 0.99)
+            measured = 0.99;
+
+        double scale = (measured / (1 - measured)) / (target / (1 - target));
+
+        if(scale > GC_PACE_MAX_STEP)
+            scale = GC_PACE_MAX_STEP;
+        else if(scale < 1 / GC_PACE_MAX_STEP)
+            scale = 1 / GC_PACE_MAX_STEP;
+
+        growth = 1 + (vm->gcGrowth - 1) * scale;
+
+        if(growth < RISA_GC_MIN_GROWTH)
+            growth = RISA_GC_MIN_GROWTH;
+        else if(growth > RISA_GC_MAX_GROWTH)
+            growth = RISA_GC_MAX_GROWTH;
+    }
+
+    // With generations, the threshold only bounds the old values. The nursery is empty after a full collection anyway.
+    size_t live = vm->heapSize > vm->youngSize ? vm->heapSize - vm->youngSize : 0;
+    double threshold = (double) live * growth;
+
+    if(threshold < (double) pacing->minThreshold)
+        threshold = (double) pacing->minThreshold;
+    else if(pacing->maxThreshold != 0 && threshold > (double) pacing->maxThreshold)
+        threshold = (double) pacing->maxThreshold;
+
+    // When the live values alone reach the maximum, the heap can still grow by the minimum before the next collection.
+    vm->heapThreshold = threshold > (double) live ? (size_t) threshold : live + pacing->minThreshold;
+
+    vm->gcGrowth = growth;
+    vm->gcTime = 0;
+    vm->gcCycleStart = now;
+    vm->gcPacePending = false;
+}
+
+#ifdef RISA_GC_LAZY_SWEEP
+
+// Frees up to 'count' unmarked values from the list detached by gc_sweep, and moves the marked ones back to the heap.
+static void gc_sweep_step(RisaVM* vm, uint32_t count) {
+    if(vm->sweeping == NULL)
+        return;
+
+    while(vm->sweeping != NULL && count-- > 0) {
+        RisaDenseValue* dense = vm->sweeping;
+        vm->sweeping = dense->link;
+
+        if(dense->marked) {
+            #ifndef RISA_GC_GENERATIONAL
+                dense->marked = false;
+            #endif
+
+            dense->link = vm->values;
+            vm->values = dense;
+        } else {
+            vm->heapSize -= risa_dense_size(dense);
+            risa_vm_dense_free(vm, dense);
+        }
+    }
+
+    if(vm->sweeping == NULL)
+        vm->gcPacePending = true;
+}
+
+// Must be called before marking, because the values that weren't swept yet are still marked.
+static void gc_sweep_finish(RisaVM* vm) {
+    gc_sweep_step(vm, UINT32_MAX);
+
+    #ifdef RISA_GC_INCREMENTAL
+        // The barrier may have remembered them, but it only needs the values marked by the next collection.
+        gc_forget(vm);
+    #endif
+}
+
+#endif
+
+#ifdef RISA_GC_GENERATIONAL
+
+// Frees the unmarked young values, and promotes the others by moving them to the old list. They stay marked.
+static void gc_sweep_young(RisaVM* vm) {
+    RisaDenseValue* dense = vm->young;
 
     while(dense != NULL) {
+        RisaDenseValue* next = dense->link;
+
         if(dense->marked) {
-            dense->marked = false;
-            prev = dense;
-            dense = dense->link;
+            dense->link = vm->values;
+            vm->values = dense;
         } else {
-            RisaDenseValue* unmarked = dense;
+            vm->heapSize -= risa_dense_size(dense);
+            risa_vm_dense_free(vm, dense);
+        }
+
+        dense = next;
+    }
+
+    vm->young = NULL;
+    vm->youngSize = 0;
+}
+
+#endif
+
+#if defined(RISA_GC_GENERATIONAL) || defined(RISA_GC_INCREMENTAL)
+
+// Once the nursery is empty, or the collection is finished, the remembered values need no special treatment.
+static void gc_forget(RisaVM* vm) {
+    for(uint32_t i = 0; i < vm->rememberedCount; ++i)
+        vm->remembered[i]->remembered = false;
+
+    vm->rememberedCount = 0;
+}
+
+#endif
+
+#ifdef RISA_GC_INCREMENTAL
+
+// Marks the children of the grey values until there are none left, in which case it returns true, or until the deadline.
+static bool gc_mark_grey(RisaVM* vm, clock_t deadline) {
+    do {
+        while(vm->greyCount > 0) {
+            for(uint32_t i = 0; i < GC_STEP_GRANULE && vm->greyCount > 0; ++i)
+                gc_pop_grey(vm);
+
+            if(vm->greyCount > 0 && clock() >= deadline)
+                return false;
+        }
+    } while(gc_rescan(vm));
+
+    return true;
+}
+
+// The registers and globals are written without barriers, so the roots are marked again before sweeping, along with the
+// children of the values that were written to during the collection. This is the only part of the marking that isn't
+// split into steps.
+static void gc_finish(RisaVM* vm) {
+    gc_mark_roots(vm);
+
+    for(uint32_t i = 0; i < vm->rememberedCount; ++i)
+        gc_mark_children(vm, vm->remembered[i], 0);
+
+    gc_forget(vm);
+    gc_drain(vm);
+    gc_erase_strings(vm);
+    gc_sweep(vm);
+
+    vm->gcMarking = false;
+}
+
+#endif
+
+void risa_gc_stop(RisaVM* vm) {
+    #ifdef RISA_GC_PARALLEL
+        if(vm->gcPool != NULL)
+            gc_pool_stop(vm);
+    #else
+        (void) vm;
+    #endif
+}
+
+#ifdef RISA_GC_PARALLEL
+
+static void gc_pool_stop(RisaVM* vm) {
+    struct RisaGCPool* pool = vm->gcPool;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(uint32_t i = 1; i < pool->workerCount; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    for(uint32_t i = 0; i < pool->workerCount; ++i)
+        RISA_MEM_FREE(pool->workers[i].batch);
+
+    while(pool->empty != NULL) {
+        GCBatch* next = pool->empty->next;
+        RISA_MEM_FREE(pool->empty);
+        pool->empty = next;
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+
+    RISA_MEM_FREE(pool->workers);
+    RISA_MEM_FREE(pool);
+
+    vm->gcPool = NULL;
+}
+
+// Splits the grey stack into batches, and marks them on every worker. The grey stack is empty afterwards, unless a
+// worker couldn't push a value, in which case 'greyOverflow' is set and gc_drain scans the heap again.
+static void gc_mark_parallel(RisaVM* vm) {
+    if(vm->gcPool == NULL)
+        gc_pool_start(vm);
+
+    struct RisaGCPool* pool = vm->gcPool;
+
+    // With a single core, gc_drain marks everything without the overhead of the batches.
+    if(pool->workerCount == 1)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while(vm->greyCount > 0) {
+        GCBatch* batch = gc_batch_get(pool);
+
+        while(batch->count < GC_BATCH_SIZE && vm->greyCount > 0)
+            batch->values[batch->count++] = vm->grey[--vm->greyCount];
+
+        batch->next = pool->full;
+        pool->full = batch;
+        __atomic_add_fetch(&pool->fullCount, 1, __ATOMIC_RELAXED);
+    }
+
+    pool->idle = 0;
+    pool->finished = 0;
+    ++pool->epoch;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    gc_worker_run(&pool->workers[0]);
+
+    pthread_mutex_lock(&pool->lock);
+
+    while(pool->finished < pool->workerCount - 1)
+        pthread_cond_wait(&pool->done, &pool->lock);
 
-            dense = dense->link;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void gc_pool_start(RisaVM* vm) {
+    struct RisaGCPool* pool = (struct RisaGCPool*) RISA_MEM_ALLOC(sizeof(struct RisaGCPool));
+
+    pool->vm = vm;
+    pool->epoch = 0;
+    pool->stopping = false;
+    pool->full = NULL;
+    pool->empty = NULL;
+    pool->fullCount = 0;
+    pool->idle = 0;
+    pool->finished = 0;
+
+    pool->workerCount = RISA_GC_WORKER_COUNT;
+
+    if(pool->workerCount == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        pool->workerCount = cores < 1 ? 1 : (cores > GC_MAX_WORKERS ? GC_MAX_WORKERS : (uint32_t) cores);
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->workers = (GCWorker*) RISA_MEM_ALLOC(pool->workerCount * sizeof(GCWorker));
+
+    for(uint32_t i = 0; i < pool->workerCount; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].epoch = 0;
+        pool->workers[i].batch = gc_batch_get(pool);
+    }
+
+    vm->gcPool = pool;
+
+    // If a thread can't be created, the collection goes on with the ones that could.
+    for(uint32_t i = 1; i < pool->workerCount; ++i) {
+        if(pthread_create(&pool->workers[i].thread, NULL, gc_worker_main, &pool->workers[i]) != 0) {
+            for(uint32_t j = i; j < pool->workerCount; ++j)
+                RISA_MEM_FREE(pool->workers[j].batch);
+
+            pool->workerCount = i;
+            break;
+        }
+    }
+}
+
+static void* gc_worker_main(void* arg) {
+    GCWorker* worker = (GCWorker*) arg;
+    struct RisaGCPool* pool = worker->pool;
 
-            if(prev != NULL)
-                prev->link = dense;
-            else vm->values = dense;
+    pthread_mutex_lock(&pool->lock);
 
-            vm->heapSize -= risa_dense_size(unmarked);
+    while(true) {
+        while(worker->epoch == pool->epoch && !pool->stopping)
+            pthread_cond_wait(&pool->start, &pool->lock);
 
-            risa_dense_delete(unmarked);
+        if(pool->stopping)
+            break;
+
+        worker->epoch = pool->epoch;
+        pthread_mutex_unlock(&pool->lock);
+
+        gc_worker_run(worker);
+
+        pthread_mutex_lock(&pool->lock);
+
+        if(++pool->finished == pool->workerCount - 1)
+            pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void gc_worker_run(GCWorker* worker) {
+    RisaVM* vm = worker->pool->vm;
+
+    gcWorker = worker;
+
+    do {
+        while(worker->batch->count > 0) {
+            RisaGreyValue grey = worker->batch->values[--worker->batch->count];
+            gc_mark_children(vm, grey.dense, grey.start);
+
+            // Keeping every grey value private would leave the other workers idle while this one marks a large structure.
+            if(worker->batch->count > 1 && __atomic_load_n(&worker->pool->idle, __ATOMIC_RELAXED) > 0
+               && __atomic_load_n(&worker->pool->fullCount, __ATOMIC_RELAXED) == 0)
+                gc_worker_share(worker);
         }
+    } while(gc_worker_take(worker));
+
+    gcWorker = NULL;
+}
+
+static void gc_worker_push(GCWorker* worker, RisaDenseValue* dense, uint32_t start) {
+    if(worker->batch->count == GC_BATCH_SIZE)
+        gc_worker_share(worker);
+
+    GCBatch* batch = worker->batch;
+
+    if(batch->count == GC_BATCH_SIZE) {
+        // Like the grey stack, the shared batches don't grow without a limit.
+        __atomic_store_n(&worker->pool->vm->greyOverflow, true, __ATOMIC_RELAXED);
+        return;
+    }
+
+    batch->values[batch->count].dense = dense;
+    batch->values[batch->count].start = start;
+    ++batch->count;
+}
+
+// Waits for a shared batch, and returns false once every worker is waiting, which means that marking is done.
+static bool gc_worker_take(GCWorker* worker) {
+    struct RisaGCPool* pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+
+    __atomic_store_n(&pool->idle, pool->idle + 1, __ATOMIC_RELAXED);
+
+    while(pool->full == NULL && pool->idle < pool->workerCount)
+        pthread_cond_wait(&pool->work, &pool->lock);
+
+    bool found = pool->full != NULL;
+
+    if(found) {
+        worker->batch->next = pool->empty;
+        pool->empty = worker->batch;
+
+        worker->batch = pool->full;
+        pool->full = pool->full->next;
+        __atomic_sub_fetch(&pool->fullCount, 1, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&pool->idle, pool->idle - 1, __ATOMIC_RELAXED);
+    } else pthread_cond_broadcast(&pool->work);
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return found;
+}
+
+// Shares half of the private batch, or all of it if it is full.
+static void gc_worker_share(GCWorker* worker) {
+    struct RisaGCPool* pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+
+    if(pool->fullCount * GC_BATCH_SIZE >= RISA_GC_MARK_STACK_SIZE) {
+        pthread_mutex_unlock(&pool->lock);
+        return;
     }
-}
\ No newline at end of file
+
+    GCBatch* batch = gc_batch_get(pool);
+
+    if(worker->batch->count == GC_BATCH_SIZE) {
+        GCBatch* shared = worker->batch;
+
+        worker->batch = batch;
+        batch = shared;
+    } else {
+        uint32_t half = worker->batch->count / 2;
+
+        memcpy(batch->values, worker->batch->values, half * sizeof(RisaGreyValue));
+        memmove(worker->batch->values, worker->batch->values + half, (worker->batch->count - half) * sizeof(RisaGreyValue));
+
+        batch->count = half;
+        worker->batch->count -= half;
+    }
+
+    batch->next = pool->full;
+    pool->full = batch;
+    __atomic_add_fetch(&pool->fullCount, 1, __ATOMIC_RELAXED);
+
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Must be called with the lock held, or before the workers are started.
+static GCBatch* gc_batch_get(struct RisaGCPool* pool) {
+    GCBatch* batch = pool->empty;
+
+    if(batch != NULL)
+        pool->empty = batch->next;
+    else batch = (GCBatch*) RISA_MEM_ALLOC(sizeof(GCBatch));
+
+    batch->next = NULL;
+    batch->count = 0;
+
+    return batch;
+}
+
+#undef GC_BATCH_SIZE
+#undef GC_MAX_WORKERS
+
+#endif
+
+#undef GC_STEP_GRANULE
+#undef GC_ARRAY_CHUNK
@@ -4,7 +4,28 @@
 #include "../api.h"
 #include "../vm/vm.h"
 
-RISA_API void risa_gc_check (RisaVM* vm);
-RISA_API void risa_gc_run   (RisaVM* vm);
+// Must be used before storing a value into a registered array, object or upvalue, so that the generational GC
+// (RISA_GC_GENERATIONAL) can find the young values referenced by old ones, and the incremental GC (RISA_GC_INCREMENTAL)
+// the unmarked values stored in marked ones. Registers and globals need no barrier.
+#if defined(RISA_GC_GENERATIONAL) || defined(RISA_GC_INCREMENTAL)
+    #define RISA_GC_BARRIER(vm, dense)                                 \
+        do {                                                           \
+            if((dense)->marked && !(dense)->remembered)                \
+                risa_gc_remember((vm), (dense));                       \
+        } while(false)
+#else
+    #define RISA_GC_BARRIER(vm, dense)
+#endif
+
+// The bounds of the growth factor, which the CPU target of the GC pacing can't adjust it past.
+#define RISA_GC_MIN_GROWTH 1.125
+#define RISA_GC_MAX_GROWTH 16.0
+
+RISA_API bool risa_gc_check     (RisaVM* vm); // False if the heap is still over the limit of the VM after a full collection.
+RISA_API void risa_gc_run       (RisaVM* vm); // A full collection.
+RISA_API void risa_gc_run_minor (RisaVM* vm); // Only collects the nursery; the same as risa_gc_run without generations.
+RISA_API void risa_gc_step      (RisaVM* vm); // Starts or continues an incremental collection; the same as risa_gc_run otherwise.
+RISA_API void risa_gc_remember  (RisaVM* vm, RisaDenseValue* dense);
+RISA_API void risa_gc_stop      (RisaVM* vm); // Stops the threads of the parallel GC (RISA_GC_PARALLEL), if it started any.
 
 #endif
@@ -7,6 +7,8 @@
 
 #define MEM_BLOCK_START_SIZE 8
 
+static RISA_THREAD_LOCAL jmp_buf* memRecovery = NULL;
+
 #ifdef DEBUG_TRACE_MEMORY_OPS
     static size_t unfreedAllocations = 0;
 #endif
@@ -74,7 +76,17 @@ void risa_mem_free(void* ptr, const char* file, uint32_t line) {
 }
 
 void risa_mem_panic() {
+    if(memRecovery != NULL)
+        longjmp(*memRecovery, 1);
+
     exit(RISA_EXIT_OOM);
 }
 
+jmp_buf* risa_mem_set_recovery(jmp_buf* recovery) {
+    jmp_buf* previous = memRecovery;
+    memRecovery = recovery;
+
+    return previous;
+}
+
 #undef MEM_BLOCK_START_SIZE
@@ -4,6 +4,8 @@
 #include "../api.h"
 #include "../def/types.h"
 
+#include <setjmp.h>
+
 #define RISA_EXIT_OOM 137
 
 #define RISA_MEM_ALLOC(size) risa_mem_alloc(size, __FILE__, __LINE__)
@@ -16,6 +18,8 @@ RISA_API void* risa_mem_realloc (void* ptr, uint32_t size, uint32_t unitSize, co
 RISA_API void* risa_mem_expand  (void* ptr, uint32_t* size, uint32_t unitSize, const char* file, uint32_t line);
 RISA_API void  risa_mem_free    (void* ptr, const char* file, uint32_t line);
 
-RISA_API void  risa_mem_panic   ();
+// Exits with RISA_EXIT_OOM, unless the current thread has set a recovery point to jump to.
+RISA_API void     risa_mem_panic        ();
+RISA_API jmp_buf* risa_mem_set_recovery (jmp_buf* recovery); // Returns the previous recovery point.
 
 #endif
@@ -0,0 +1,68 @@
+#include "slab.h"
+#include "mem.h"
+
+// The chunk header is padded so that the blocks stay aligned to the granule.
+#define SLAB_CHUNK_HEADER (((sizeof(RisaSlabChunk) + RISA_SLAB_GRANULE - 1) / RISA_SLAB_GRANULE) * RISA_SLAB_GRANULE)
+
+void risa_slab_init(RisaSlabAllocator* slabs) {
+    slabs->chunks = NULL;
+
+    for(uint32_t i = 0; i < RISA_SLAB_CLASS_COUNT; ++i) {
+        slabs->free[i] = NULL;
+        slabs->next[i] = NULL;
+        slabs->end[i] = NULL;
+    }
+}
+
+void risa_slab_delete(RisaSlabAllocator* slabs) {
+    while(slabs->chunks != NULL) {
+        RisaSlabChunk* next = slabs->chunks->next;
+        RISA_MEM_FREE(slabs->chunks);
+        slabs->chunks = next;
+    }
+
+    risa_slab_init(slabs);
+}
+
+uint8_t risa_slab_class(uint32_t size) {
+    if(size == 0 || size > RISA_SLAB_MAX_SIZE)
+        return 0;
+
+    return (uint8_t) ((size + RISA_SLAB_GRANULE - 1) / RISA_SLAB_GRANULE);
+}
+
+void* risa_slab_alloc(RisaSlabAllocator* slabs, uint8_t sizeClass) {
+    uint32_t index = sizeClass - 1;
+    RisaSlabBlock* block = slabs->free[index];
+
+    if(block != NULL) {
+        slabs->free[index] = block->next;
+        return block;
+    }
+
+    uint32_t size = sizeClass * RISA_SLAB_GRANULE;
+
+    if(slabs->next[index] == NULL || slabs->next[index] + size > slabs->end[index]) {
+        RisaSlabChunk* chunk = (RisaSlabChunk*) RISA_MEM_ALLOC(RISA_SLAB_CHUNK_SIZE);
+
+        chunk->next = slabs->chunks;
+        slabs->chunks = chunk;
+
+        slabs->next[index] = (uint8_t*) chunk + SLAB_CHUNK_HEADER;
+        slabs->end[index] = (uint8_t*) chunk + RISA_SLAB_CHUNK_SIZE;
+    }
+
+    void* ptr = slabs->next[index];
+    slabs->next[index] += size;
+
+    return ptr;
+}
+
+void risa_slab_free(RisaSlabAllocator* slabs, void* ptr, uint8_t sizeClass) {
+    RisaSlabBlock* block = (RisaSlabBlock*) ptr;
+
+    block->next = slabs->free[sizeClass - 1];
+    slabs->free[sizeClass - 1] = block;
+}
+
+#undef SLAB_CHUNK_HEADER
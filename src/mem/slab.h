@@ -0,0 +1,36 @@
+#ifndef RISA_MEM_SLAB_H_GUARD
+#define RISA_MEM_SLAB_H_GUARD
+
+#include "../api.h"
+#include "../def/types.h"
+#include "../def/def.h"
+
+// Blocks are grouped in size classes, which are multiples of RISA_SLAB_GRANULE bytes. Class 0 means that the size
+// is too large for the slabs, and must be allocated with RISA_MEM_ALLOC.
+#define RISA_SLAB_CLASS_COUNT (RISA_SLAB_MAX_SIZE / RISA_SLAB_GRANULE)
+
+typedef struct RisaSlabBlock {
+    struct RisaSlabBlock* next;
+} RisaSlabBlock;
+
+typedef struct RisaSlabChunk {
+    struct RisaSlabChunk* next;
+} RisaSlabChunk;
+
+// Every class has a free list of blocks, and carves new ones out of its own chunk when the list is empty. The chunks
+// are only freed with the allocator.
+typedef struct {
+    RisaSlabChunk* chunks;
+
+    RisaSlabBlock* free[RISA_SLAB_CLASS_COUNT];
+    uint8_t* next[RISA_SLAB_CLASS_COUNT];
+    uint8_t* end[RISA_SLAB_CLASS_COUNT];
+} RisaSlabAllocator;
+
+RISA_API void    risa_slab_init   (RisaSlabAllocator* slabs);
+RISA_API void    risa_slab_delete (RisaSlabAllocator* slabs);
+RISA_API uint8_t risa_slab_class  (uint32_t size);
+RISA_API void*   risa_slab_alloc  (RisaSlabAllocator* slabs, uint8_t sizeClass);
+RISA_API void    risa_slab_free   (RisaSlabAllocator* slabs, void* ptr, uint8_t sizeClass);
+
+#endif
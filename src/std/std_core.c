@@ -23,7 +23,7 @@ void risa_std_register_core(RisaVM* vm) {
     risa_vm_global_set_native(vm, STD_CORE_ENTRY(toByte, to_byte));
     risa_vm_global_set_native(vm, STD_CORE_ENTRY(toFloat, to_float));
     risa_vm_global_set_native(vm, STD_CORE_ENTRY(toBool, to_bool));
-    risa_vm_global_set_native(vm, STD_CORE_ENTRY(foreach, foreach));
+    risa_vm_global_set_borrowing_native(vm, STD_CORE_ENTRY(foreach, foreach));
 
     #undef STD_CORE_ENTRY
 }
@@ -52,7 +52,7 @@ static RisaValue risa_std_core_to_int(void* vm, uint8_t argc, RisaValue* args) {
     if(argc == 0)
         return risa_value_from_null();
 
-    switch(args[0].type) {
+    switch(risa_value_type(args[0])) {
         case RISA_VAL_NULL: {
             return risa_value_from_null();
         }
@@ -91,7 +91,7 @@ static RisaValue risa_std_core_to_byte(void* vm, uint8_t argc, RisaValue* args)
     if(argc == 0)
         return risa_value_from_null();
 
-    switch(args[0].type) {
+    switch(risa_value_type(args[0])) {
         case RISA_VAL_NULL: {
             return risa_value_from_null();
         }
@@ -130,7 +130,7 @@ static RisaValue risa_std_core_to_float(void* vm, uint8_t argc, RisaValue* args)
     if(argc == 0)
         return risa_value_from_null();
 
-    switch(args[0].type) {
+    switch(risa_value_type(args[0])) {
         case RISA_VAL_NULL: {
             return risa_value_from_null();
         }
@@ -179,7 +179,7 @@ static RisaValue risa_std_core_foreach(void* vm, uint8_t argc, RisaValue* args)
     if(!risa_value_is_dense_of_type(args[0], RISA_DVAL_ARRAY))
         return risa_value_from_null();
 
-    switch(args[1].type) {
+    switch(risa_value_type(args[1])) {
         case RISA_VAL_DENSE:
             switch(risa_value_as_dense(args[1])->type) {
                 case RISA_DVAL_FUNCTION:
@@ -194,9 +194,13 @@ static RisaValue risa_std_core_foreach(void* vm, uint8_t argc, RisaValue* args)
 _std_core_foreach_work: ;
 
     RisaDenseArray* array = RISA_AS_ARRAY(args[0]);
+    RisaValue callee = args[1];
+
+    // Invoking the callee may grow the stack, which would leave 'args' pointing to the old one.
+    size_t offset = args + argc - ((RisaVM*) vm)->stack;
 
     for(size_t i = 0; i < array->data.size; ++i) {
-        risa_vm_invoke(vm, args + argc, args[1], 1, array->data.values[i]);
+        risa_vm_invoke(vm, ((RisaVM*) vm)->stack + offset, callee, 1, array->data.values[i]);
     }
 
     return risa_value_from_null();
@@ -205,7 +209,7 @@ _std_core_foreach_work: ;
 static RisaValue risa_std_core_internal_typeof(RisaVM* vm, RisaValue val) {
     #define TYPEOF_RESULT(type) risa_value_from_dense((RisaDenseValue*) risa_vm_string_create(vm, type, sizeof(type) - 1))
 
-    switch(val.type) {
+    switch(risa_value_type(val)) {
         case RISA_VAL_NULL:  return TYPEOF_RESULT("null");
         case RISA_VAL_BOOL:  return TYPEOF_RESULT("bool");
         case RISA_VAL_BYTE:  return TYPEOF_RESULT("byte");
@@ -74,7 +74,7 @@ static RisaValue risa_std_debug_vm_heap_size(void* vm, uint8_t argc, RisaValue*
 }
 
 static RisaValue risa_std_debug_vm_stack_size(void* vm, uint8_t argc, RisaValue* args) {
-    return (risa_value_from_int((uint64_t) (RISA_VM_STACK_SIZE * sizeof(RisaValue))));
+    return (risa_value_from_int((uint64_t) (((RisaVM*) vm)->stackCapacity * sizeof(RisaValue))));
 }
 
 static RisaValue risa_std_debug_vm_gc(void* vm, uint8_t argc, RisaValue* args) {
@@ -86,7 +86,7 @@ static RisaValue risa_std_debug_vm_gc(void* vm, uint8_t argc, RisaValue* args) {
 static RisaValue risa_std_debug_type_internal(RisaVM* vm, RisaValue val) {
     #define TYPE_RESULT(type) risa_value_from_dense((RisaDenseValue*) risa_vm_string_create(vm, type, sizeof(type) - 1))
 
-    switch(val.type) {
+    switch(risa_value_type(val)) {
         case RISA_VAL_NULL:  return TYPE_RESULT("null");
         case RISA_VAL_BOOL:  return TYPE_RESULT("bool");
         case RISA_VAL_BYTE:  return TYPE_RESULT("byte");
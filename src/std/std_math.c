@@ -75,7 +75,7 @@ static RisaValue risa_std_math_min(void* vm, uint8_t argc, RisaValue* args) {
         } as;
     } min;
 
-    switch(args[0].type) {
+    switch(risa_value_type(args[0])) {
         case RISA_VAL_BYTE:
             min.type = RISA_VAL_BYTE;
             min.as.byte = risa_value_as_byte(args[0]);
@@ -93,7 +93,7 @@ static RisaValue risa_std_math_min(void* vm, uint8_t argc, RisaValue* args) {
     }
 
     for(uint8_t i = 1; i < argc; ++i) {
-        switch(args[i].type) {
+        switch(risa_value_type(args[i])) {
             case RISA_VAL_BYTE:
                 switch(min.type) {
                     case RISA_VAL_BYTE:
@@ -194,7 +194,7 @@ static RisaValue risa_std_math_max(void* vm, uint8_t argc, RisaValue* args) {
         } as;
     } max;
 
-    switch(args[0].type) {
+    switch(risa_value_type(args[0])) {
         case RISA_VAL_BYTE:
             max.type = RISA_VAL_BYTE;
             max.as.byte = risa_value_as_byte(args[0]);
@@ -212,7 +212,7 @@ static RisaValue risa_std_math_max(void* vm, uint8_t argc, RisaValue* args) {
     }
 
     for(uint8_t i = 1; i < argc; ++i) {
-        switch(args[i].type) {
+        switch(risa_value_type(args[i])) {
             case RISA_VAL_BYTE:
                 switch(max.type) {
                     case RISA_VAL_BYTE:
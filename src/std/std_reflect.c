@@ -17,7 +17,8 @@ static RisaValue risa_std_reflect_reflect(void* vm, uint8_t argc, RisaValue* arg
         case 0: {
             RisaDenseObject* obj = risa_dense_object_create_under(vm, 0);
 
-            risa_map_copy(&obj->data, &((RisaVM*) vm)->globals);
+            for(uint32_t i = 0; i < ((RisaVM*) vm)->globalCount; ++i)
+                risa_dense_object_set(obj, ((RisaVM*) vm)->globals[i].name, ((RisaVM*) vm)->globals[i].value);
 
             return risa_value_from_dense(obj);
         }
@@ -27,7 +28,7 @@ static RisaValue risa_std_reflect_reflect(void* vm, uint8_t argc, RisaValue* arg
 
             RisaValue val;
 
-            if(!risa_map_get(&((RisaVM*) vm)->globals, RISA_AS_STRING(args[0]), &val))
+            if(!risa_vm_global_get(vm, RISA_AS_STRING(args[0]), &val))
                 return risa_value_from_null();
 
             return val;
@@ -36,7 +37,7 @@ static RisaValue risa_std_reflect_reflect(void* vm, uint8_t argc, RisaValue* arg
             if(!risa_value_is_dense_of_type(args[0], RISA_DVAL_STRING))
                 return risa_value_from_null();
 
-            risa_map_set(&((RisaVM*) vm)->globals, RISA_AS_STRING(args[0]), args[1]);
+            risa_vm_global_define(vm, RISA_AS_STRING(args[0]), args[1]);
 
             return args[1];
         }
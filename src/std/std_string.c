@@ -31,7 +31,7 @@ static RisaValue risa_std_string_substr(void* vm, uint8_t argc, RisaValue* args)
     int64_t length;
 
     if(argc >= 2) {
-        switch(args[1].type) {
+        switch(risa_value_type(args[1])) {
             case RISA_VAL_BYTE:
                 index = (int64_t) risa_value_as_byte(args[1]);
                 break;
@@ -52,7 +52,7 @@ static RisaValue risa_std_string_substr(void* vm, uint8_t argc, RisaValue* args)
     }
 
     if(argc >= 3) {
-        switch(args[2].type) {
+        switch(risa_value_type(args[2])) {
             case RISA_VAL_BYTE:
                 length = (int64_t) risa_value_as_byte(args[2]);
                 break;
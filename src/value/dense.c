@@ -22,19 +22,23 @@ void risa_dense_print(RisaIO* io, RisaDenseValue* dense) {
         case RISA_DVAL_OBJECT: {
             bool first = true;
 
+            RisaDenseObjectIterator iterator;
+            RisaDenseString* key;
+            RisaValue value;
+
+            risa_dense_object_iterate((RisaDenseObject*) dense, &iterator);
+
             RISA_OUT((*io), "{ ");
-            for (uint32_t i = 0; i < ((RisaDenseObject *) dense)->data.capacity; ++i) {
-                if(((RisaDenseObject *) dense)->data.entries[i].key != NULL) {
-                    if(first)
-                        first = false;
-                    else RISA_OUT((*io), ", ");
+            while(risa_dense_object_next(&iterator, &key, &value)) {
+                if(first)
+                    first = false;
+                else RISA_OUT((*io), ", ");
 
-                    RISA_OUT((*io), "\"");
-                    risa_dense_print(io, (RisaDenseValue *) (((RisaDenseObject *) dense)->data.entries[i].key));
-                    RISA_OUT((*io), "\": ");
+                RISA_OUT((*io), "\"");
+                risa_dense_print(io, (RisaDenseValue*) key);
+                RISA_OUT((*io), "\": ");
 
-                    risa_value_print(io, ((RisaDenseObject *) dense)->data.entries[i].value);
-                }
+                risa_value_print(io, value);
             }
             RISA_OUT((*io), " }");
             break;
@@ -99,25 +103,28 @@ char* risa_dense_to_string(RisaDenseValue* dense) {
             risa_lib_charlib_string_init(&str);
             risa_lib_charlib_string_append_c(&str,  "{ ");
 
-            for (uint32_t i = 0; i < ((RisaDenseObject *) dense)->data.capacity; ++i) {
-                if(((RisaDenseObject *) dense)->data.entries[i].key != NULL) {
-                    if(first)
-                        first = false;
-                    else risa_lib_charlib_string_append_c(&str,  ", ");
+            RisaDenseObjectIterator iterator;
+            RisaDenseString* key;
+            RisaValue value;
 
-                    risa_lib_charlib_string_append_c(&str,  "\"");
+            risa_dense_object_iterate((RisaDenseObject*) dense, &iterator);
 
-                    char* valStr = risa_dense_to_string((RisaDenseValue *) (((RisaDenseObject *) dense)->data.entries[i].key));
-                    risa_lib_charlib_string_append_c(&str,  valStr);
-                    RISA_MEM_FREE(valStr);
+            while(risa_dense_object_next(&iterator, &key, &value)) {
+                if(first)
+                    first = false;
+                else risa_lib_charlib_string_append_c(&str,  ", ");
 
+                risa_lib_charlib_string_append_c(&str,  "\"");
 
-                    risa_lib_charlib_string_append_c(&str,  "\": ");
+                char* valStr = risa_dense_to_string((RisaDenseValue*) key);
+                risa_lib_charlib_string_append_c(&str,  valStr);
+                RISA_MEM_FREE(valStr);
 
-                    valStr = risa_value_to_string(((RisaDenseObject *) dense)->data.entries[i].value);
-                    risa_lib_charlib_string_append_c(&str,  valStr);
-                    RISA_MEM_FREE(valStr);
-                }
+                risa_lib_charlib_string_append_c(&str,  "\": ");
+
+                valStr = risa_value_to_string(value);
+                risa_lib_charlib_string_append_c(&str,  valStr);
+                RISA_MEM_FREE(valStr);
             }
 
             risa_lib_charlib_string_append_c(&str,  " }");
@@ -186,7 +193,7 @@ bool risa_dense_is_truthy(RisaDenseValue* dense) {
         case RISA_DVAL_ARRAY:
             return ((RisaDenseArray*) dense)->data.size > 0;
         case RISA_DVAL_OBJECT:
-            return ((RisaDenseObject*) dense)->data.count > 0;
+            return risa_dense_object_get_count((RisaDenseObject*) dense) > 0;
         case RISA_DVAL_UPVALUE:
         case RISA_DVAL_FUNCTION:
         case RISA_DVAL_CLOSURE:
@@ -214,11 +221,23 @@ RisaValue risa_dense_clone(RisaDenseValue* dense) {
             RisaDenseObject* object = (RisaDenseObject*) dense;
             RisaDenseObject* clone = risa_dense_object_create();
 
-            for(size_t i = 0; i < object->data.capacity; ++i) {
-                RisaMapEntry entry = object->data.entries[i];
+            // The clone has the same keys in the same order, so it can share the shape.
+            if(object->shape != NULL) {
+                risa_shape_retain(object->shape);
+
+                clone->shape = object->shape;
+                clone->slotCapacity = object->shape->count;
+                clone->slots = clone->slotCapacity == 0 ? NULL : (RisaValue*) RISA_MEM_ALLOC(clone->slotCapacity * sizeof(RisaValue));
 
-                if(entry.key != NULL)
-                    risa_dense_object_set(clone, entry.key, risa_value_clone(entry.value));
+                for(uint32_t i = 0; i < clone->slotCapacity; ++i)
+                    clone->slots[i] = risa_value_clone(object->slots[i]);
+            } else {
+                for(size_t i = 0; i < object->data.capacity; ++i) {
+                    RisaMapEntry entry = object->data.entries[i];
+
+                    if(entry.key != NULL)
+                        risa_dense_object_set(clone, entry.key, risa_value_clone(entry.value));
+                }
             }
 
             return risa_value_from_dense(((RisaDenseValue*) clone));
@@ -227,7 +246,7 @@ RisaValue risa_dense_clone(RisaDenseValue* dense) {
             RisaDenseUpvalue* upvalue = (RisaDenseUpvalue*) dense;
             RisaDenseUpvalue* clone = risa_dense_upvalue_create(upvalue->ref);
 
-            if(upvalue->closed.type != RISA_VAL_NULL)
+            if(!risa_value_is_null(upvalue->closed))
                 clone->closed = risa_value_clone(upvalue->closed);
 
             return risa_value_from_dense(((RisaDenseValue*) clone));
@@ -262,11 +281,22 @@ RisaValue risa_dense_clone_under(void* vm, RisaDenseValue* dense) {
             RisaDenseObject* object = (RisaDenseObject*) dense;
             RisaDenseObject* clone = risa_dense_object_create();
 
-            for(size_t i = 0; i < object->data.capacity; ++i) {
-                RisaMapEntry entry = object->data.entries[i];
+            if(object->shape != NULL) {
+                risa_shape_retain(object->shape);
 
-                if(entry.key != NULL) {
-                    risa_dense_object_set(clone, entry.key, risa_value_clone_register(vm, entry.value));
+                clone->shape = object->shape;
+                clone->slotCapacity = object->shape->count;
+                clone->slots = clone->slotCapacity == 0 ? NULL : (RisaValue*) RISA_MEM_ALLOC(clone->slotCapacity * sizeof(RisaValue));
+
+                for(uint32_t i = 0; i < clone->slotCapacity; ++i)
+                    clone->slots[i] = risa_value_clone_register(vm, object->slots[i]);
+            } else {
+                for(size_t i = 0; i < object->data.capacity; ++i) {
+                    RisaMapEntry entry = object->data.entries[i];
+
+                    if(entry.key != NULL) {
+                        risa_dense_object_set(clone, entry.key, risa_value_clone_register(vm, entry.value));
+                    }
                 }
             }
 
@@ -279,7 +309,7 @@ RisaValue risa_dense_clone_under(void* vm, RisaDenseValue* dense) {
             RisaDenseUpvalue* upvalue = (RisaDenseUpvalue*) dense;
             RisaDenseUpvalue* clone = risa_dense_upvalue_create(upvalue->ref);
 
-            if(upvalue->closed.type != RISA_VAL_NULL) {
+            if(!risa_value_is_null(upvalue->closed)) {
                 clone->closed = risa_value_clone(upvalue->closed);
             }
 
@@ -313,7 +343,7 @@ size_t risa_dense_size(RisaDenseValue* dense) {
         case RISA_DVAL_NATIVE:
             return sizeof(RisaDenseNative);
         case RISA_DVAL_CLOSURE:
-            return ((RisaDenseClosure*) dense)->upvalueCount * sizeof(RisaDenseUpvalue) + sizeof(RisaDenseClosure);
+            return ((RisaDenseClosure*) dense)->upvalueCount * (sizeof(RisaDenseUpvalue*) + (((RisaDenseClosure*) dense)->cells == NULL ? 0 : sizeof(RisaDenseUpvalue))) + sizeof(RisaDenseClosure);
         default:
             return 0;  // Never reached; written to suppress warnings.
     }
@@ -324,29 +354,28 @@ RisaDenseValueType risa_dense_get_type(RisaDenseValue* dense) {
 }
 
 void risa_dense_delete(RisaDenseValue* dense) {
+    risa_dense_delete_contents(dense);
+    RISA_MEM_FREE(dense);
+}
+
+void risa_dense_delete_contents(RisaDenseValue* dense) {
     switch(dense->type) {
         case RISA_DVAL_STRING:
-            RISA_MEM_FREE(dense);
+        case RISA_DVAL_UPVALUE:
+        case RISA_DVAL_NATIVE:
             break;
         case RISA_DVAL_ARRAY:
             risa_dense_array_delete((RisaDenseArray*) dense);
-            RISA_MEM_FREE(dense);
             break;
         case RISA_DVAL_OBJECT:
             risa_dense_object_delete((RisaDenseObject*) dense);
-            RISA_MEM_FREE(dense);
-            break;
-        case RISA_DVAL_UPVALUE:
-        case RISA_DVAL_NATIVE:
-            RISA_MEM_FREE(dense);
             break;
         case RISA_DVAL_FUNCTION:
             risa_dense_function_delete((RisaDenseFunction*) dense);
-            RISA_MEM_FREE(dense);
             break;
         case RISA_DVAL_CLOSURE:
             RISA_MEM_FREE(((RisaDenseClosure *) dense)->upvalues);
-            RISA_MEM_FREE(dense);
+            RISA_MEM_FREE(((RisaDenseClosure *) dense)->cells);
             break;
     }
 }
\ No newline at end of file
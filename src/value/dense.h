@@ -7,6 +7,8 @@
 #include "../cluster/cluster.h"
 #include "../mem/mem.h"
 #include "../data/map.h"
+#include "../def/def.h"
+#include "shape.h"
 
 typedef RisaValue (*RisaNativeFunction)(void* vm, uint8_t argc, RisaValue* args);
 
@@ -28,9 +30,33 @@ typedef struct {
 typedef struct {
     RisaDenseValue dense;
 
+    RisaShape* shape; // NULL if the object is in dictionary mode, in which case the properties are stored in 'data'.
+    RisaValue* slots;
+    uint32_t slotCapacity;
+
     RisaMap data;
 } RisaDenseObject;
 
+// If 'transition' is not NULL, the entry caches the addition of a new property which turns 'shape' into 'transition'.
+typedef struct {
+    RisaShape* shape;
+    RisaShape* transition;
+    uint32_t slot;
+} RisaInlineCacheEntry;
+
+typedef struct {
+    RisaInlineCacheEntry entries[RISA_VM_INLINE_CACHE_SIZE];
+} RisaInlineCache;
+
+// Visits the properties of an object in the order they were added, or in map order for dictionaries. The keys of a
+// shaped object are collected by a single walk of its shape chain when the iteration starts.
+typedef struct {
+    RisaDenseObject* object;
+    uint32_t index; // The next slot, or the next map entry in dictionary mode.
+
+    RisaDenseStringPtr keys[RISA_SHAPE_MAX_PROPERTIES];
+} RisaDenseObjectIterator;
+
 typedef struct RisaDenseUpvalue {
     RisaDenseValue dense;
 
@@ -47,6 +73,11 @@ typedef struct {
 
     RisaCluster cluster;
     RisaDenseString* name;
+
+    RisaInlineCache* caches; // One for every instruction; allocated on the first cached property access.
+
+    uint32_t heat;           // Calls and back jumps, counted until the JIT compiles the function.
+    struct RisaJitCode* jit;
 } RisaDenseFunction;
 
 typedef struct {
@@ -55,6 +86,10 @@ typedef struct {
     RisaDenseFunction* function;
     RisaDenseUpvalue** upvalues;
 
+    // Upvalues that point straight at the registers of the defining frame. They are only created for closures that
+    // never outlive that frame, so they are neither registered nor ever closed. Allocated on the first direct capture.
+    RisaDenseUpvalue* cells;
+
     uint8_t upvalueCount;
 } RisaDenseClosure;
 
@@ -62,16 +97,17 @@ typedef struct {
     RisaDenseValue dense;
 
     RisaNativeFunction function;
+    bool borrowing; // Whether or not the native never keeps its arguments after it returns.
 } RisaDenseNative;
 
-#define RISA_AS_STRING(value)   ((RisaDenseString*) ((value).as.dense))
-#define RISA_AS_ARRAY(value)    ((RisaDenseArray*) ((value).as.dense))
-#define RISA_AS_OBJECT(value)   ((RisaDenseObject*) ((value).as.dense))
-#define RISA_AS_UPVALUE(value)   ((RisaDenseUpvalue*) ((value).as.dense))
-#define RISA_AS_CSTRING(value)  (((RisaDenseString*) ((value).as.dense))->chars)
-#define RISA_AS_FUNCTION(value) ((RisaDenseFunction*) ((value).as.dense))
-#define RISA_AS_CLOSURE(value)  ((RisaDenseClosure*) ((value).as.dense))
-#define RISA_AS_NATIVE(value)   ((RisaDenseNative*) ((value).as.dense))
+#define RISA_AS_STRING(value)   ((RisaDenseString*) (RISA_AS_DENSE(value)))
+#define RISA_AS_ARRAY(value)    ((RisaDenseArray*) (RISA_AS_DENSE(value)))
+#define RISA_AS_OBJECT(value)   ((RisaDenseObject*) (RISA_AS_DENSE(value)))
+#define RISA_AS_UPVALUE(value)   ((RisaDenseUpvalue*) (RISA_AS_DENSE(value)))
+#define RISA_AS_CSTRING(value)  (((RisaDenseString*) (RISA_AS_DENSE(value)))->chars)
+#define RISA_AS_FUNCTION(value) ((RisaDenseFunction*) (RISA_AS_DENSE(value)))
+#define RISA_AS_CLOSURE(value)  ((RisaDenseClosure*) (RISA_AS_DENSE(value)))
+#define RISA_AS_NATIVE(value)   ((RisaDenseNative*) (RISA_AS_DENSE(value)))
 
 RISA_API void               risa_dense_print               (RisaIO* io, RisaDenseValue* dense);
 RISA_API char*              risa_dense_to_string           (RisaDenseValue* dense);
@@ -81,13 +117,16 @@ RISA_API RisaValue          risa_dense_clone_under         (void* vm, RisaDenseV
 RISA_API size_t             risa_dense_size                (RisaDenseValue* dense);
 RISA_API RisaDenseValueType risa_dense_get_type            (RisaDenseValue* dense);
 RISA_API void               risa_dense_delete              (RisaDenseValue* dense);
+RISA_API void               risa_dense_delete_contents     (RisaDenseValue* dense); // Frees what the value owns, but not the value itself.
 
 RISA_API RisaDenseString*   risa_dense_string_prepare      (const char* chars, uint32_t length);
+RISA_API void               risa_dense_string_init         (RisaDenseString* string, uint32_t length); // Needs room for 'length' chars after the string.
 RISA_API uint32_t           risa_dense_string_hash         (RisaDenseString* string);
 RISA_API void               risa_dense_string_hash_inplace (RisaDenseString* string);
 RISA_API RisaDenseString*   risa_dense_string_from         (const char* chars, uint32_t length);
 RISA_API char*              risa_dense_string_as_cstring   (RisaDenseString* string);
 RISA_API RisaDenseString*   risa_dense_string_concat       (RisaDenseString* left, RisaDenseString* right);
+RISA_API void               risa_dense_string_concat_into  (RisaDenseString* string, RisaDenseString* left, RisaDenseString* right);
 RISA_API void               risa_dense_string_delete       (RisaDenseString* string);
 
 RISA_API RisaDenseArray*    risa_dense_array_create        ();
@@ -98,23 +137,33 @@ RISA_API RisaValue          risa_dense_array_get           (RisaDenseArray* arra
 RISA_API void               risa_dense_array_set           (RisaDenseArray* array, uint32_t index, RisaValue value);
 
 RISA_API RisaDenseObject*   risa_dense_object_create       ();
+RISA_API RisaDenseObject*   risa_dense_object_create_with  (RisaShape* root);
 RISA_API RisaDenseObject*   risa_dense_object_create_under (void* vm, uint32_t entryCount, ...);
 RISA_API void               risa_dense_object_init         (RisaDenseObject* object);
 RISA_API void               risa_dense_object_delete       (RisaDenseObject* object);
 RISA_API uint32_t           risa_dense_object_get_count    (RisaDenseObject* object);
-RISA_API RisaMapEntry*      risa_dense_object_get_entry    (RisaDenseObject* object, uint32_t index);
+RISA_API bool               risa_dense_object_get_entry    (RisaDenseObject* object, uint32_t index, RisaDenseString** key, RisaValue* value);
+RISA_API void               risa_dense_object_iterate      (RisaDenseObject* object, RisaDenseObjectIterator* iterator);
+RISA_API bool               risa_dense_object_next         (RisaDenseObjectIterator* iterator, RisaDenseString** key, RisaValue* value); // False once every property was visited.
 RISA_API bool               risa_dense_object_get          (RisaDenseObject* object, RisaDenseString* key, RisaValue* value);
 RISA_API void               risa_dense_object_set          (RisaDenseObject* object, RisaDenseString* key, RisaValue value);
+RISA_API bool               risa_dense_object_get_cached   (RisaDenseObject* object, RisaDenseString* key, RisaValue* value, RisaInlineCache* cache);
+RISA_API void               risa_dense_object_set_cached   (RisaDenseObject* object, RisaDenseString* key, RisaValue value, RisaInlineCache* cache);
 
 RISA_API RisaDenseUpvalue*  risa_dense_upvalue_create      (RisaValue* value);
+RISA_API void               risa_dense_upvalue_init        (RisaDenseUpvalue* upvalue, RisaValue* value);
 
 RISA_API RisaDenseFunction* risa_dense_function_create      ();
 RISA_API void               risa_dense_function_init        (RisaDenseFunction* function);
 RISA_API RisaCluster*       risa_dense_function_get_cluster (RisaDenseFunction* function);
+RISA_API RisaInlineCache*   risa_dense_function_get_cache   (RisaDenseFunction* function, uint32_t offset);
 RISA_API void               risa_dense_function_delete      (RisaDenseFunction* function);
 RISA_API void               risa_dense_function_free        (RisaDenseFunction* function);
 
 RISA_API RisaDenseClosure*  risa_dense_closure_create      (RisaDenseFunction* function, uint8_t upvalueCount);
+RISA_API void               risa_dense_closure_init        (RisaDenseClosure* closure, RisaDenseFunction* function, uint8_t upvalueCount);
+RISA_API RisaDenseUpvalue*  risa_dense_closure_capture     (RisaDenseClosure* closure, uint8_t index, RisaValue* ref); // Direct capture into a cell.
+RISA_API bool               risa_dense_closure_is_direct   (RisaDenseClosure* closure, uint8_t index);
 
 RISA_API RisaDenseNative*   risa_dense_native_create       (RisaNativeFunction function);
 RISA_API RisaValue          risa_dense_native_value        (RisaNativeFunction function);
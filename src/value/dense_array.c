@@ -2,6 +2,7 @@
 
 RisaDenseArray* risa_dense_array_create() {
     RisaDenseArray* array = (RisaDenseArray*) RISA_MEM_ALLOC(sizeof(RisaDenseArray));
+    array->dense.slab = 0;
 
     risa_dense_array_init(array);
     return array;
@@ -11,6 +12,8 @@ void risa_dense_array_init(RisaDenseArray* array) {
     array->dense.type = RISA_DVAL_ARRAY;
     array->dense.link = NULL;
     array->dense.marked = false;
+    array->dense.registered = false;
+    array->dense.remembered = false;
 
     risa_value_array_init(&array->data);
 }
@@ -1,18 +1,51 @@
 #include "dense.h"
 
 RisaDenseClosure* risa_dense_closure_create(RisaDenseFunction* function, uint8_t upvalueCount) {
-    RisaDenseUpvalue** upvalues = RISA_MEM_ALLOC(upvalueCount * sizeof(RisaDenseUpvalue));
+    RisaDenseClosure* closure = RISA_MEM_ALLOC(sizeof(RisaDenseClosure));
+    closure->dense.slab = 0;
+
+    risa_dense_closure_init(closure, function, upvalueCount);
+    return closure;
+}
+
+void risa_dense_closure_init(RisaDenseClosure* closure, RisaDenseFunction* function, uint8_t upvalueCount) {
+    RisaDenseUpvalue** upvalues = RISA_MEM_ALLOC(upvalueCount * sizeof(RisaDenseUpvalue*));
     for(uint8_t i = 0; i < upvalueCount; ++i)
         upvalues[i] = NULL;
 
-    RisaDenseClosure* closure = RISA_MEM_ALLOC(sizeof(RisaDenseClosure));
     closure->dense.type = RISA_DVAL_CLOSURE;
     closure->dense.link = NULL;
     closure->dense.marked = false;
+    closure->dense.registered = false;
+    closure->dense.remembered = false;
 
     closure->function = function;
     closure->upvalues = upvalues;
+    closure->cells = NULL;
     closure->upvalueCount = upvalueCount;
+}
 
-    return closure;
-}
\ No newline at end of file
+RisaDenseUpvalue* risa_dense_closure_capture(RisaDenseClosure* closure, uint8_t index, RisaValue* ref) {
+    if(closure->cells == NULL)
+        closure->cells = RISA_MEM_ALLOC(closure->upvalueCount * sizeof(RisaDenseUpvalue));
+
+    RisaDenseUpvalue* cell = &closure->cells[index];
+    cell->dense.type = RISA_DVAL_UPVALUE;
+    cell->dense.link = NULL;
+    cell->dense.marked = false;
+    cell->dense.registered = false;
+    cell->dense.remembered = false;
+    cell->dense.slab = 0;
+
+    cell->ref = ref;
+    cell->closed = risa_value_from_null();
+    cell->next = NULL;
+
+    closure->upvalues[index] = cell;
+
+    return cell;
+}
+
+bool risa_dense_closure_is_direct(RisaDenseClosure* closure, uint8_t index) {
+    return closure->cells != NULL && closure->upvalues[index] == &closure->cells[index];
+}
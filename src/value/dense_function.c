@@ -1,7 +1,9 @@
 #include "dense.h"
+#include "../vm/vm.h"
 
 RisaDenseFunction* risa_dense_function_create() {
     RisaDenseFunction* function = (RisaDenseFunction*) RISA_MEM_ALLOC(sizeof(RisaDenseFunction));
+    function->dense.slab = 0;
 
     risa_dense_function_init(function);
     return function;
@@ -11,9 +13,14 @@ void risa_dense_function_init(RisaDenseFunction* function) {
     function->dense.type = RISA_DVAL_FUNCTION;
     function->dense.link = NULL;
     function->dense.marked = false;
+    function->dense.registered = false;
+    function->dense.remembered = false;
 
     function->arity = 0;
     function->name = NULL;
+    function->caches = NULL;
+    function->heat = 0;
+    function->jit = NULL;
     risa_cluster_init(&function->cluster);
 }
 
@@ -21,7 +28,40 @@ RisaCluster* risa_dense_function_get_cluster (RisaDenseFunction* function) {
     return &function->cluster;
 }
 
+RisaInlineCache* risa_dense_function_get_cache(RisaDenseFunction* function, uint32_t offset) {
+    if(function->caches == NULL) {
+        uint32_t count = function->cluster.size / 4;
+
+        function->caches = (RisaInlineCache*) RISA_MEM_ALLOC(count * sizeof(RisaInlineCache));
+
+        for(uint32_t i = 0; i < count; ++i) {
+            for(uint32_t j = 0; j < RISA_VM_INLINE_CACHE_SIZE; ++j) {
+                function->caches[i].entries[j].shape = NULL;
+                function->caches[i].entries[j].transition = NULL;
+                function->caches[i].entries[j].slot = 0;
+            }
+        }
+    }
+
+    return &function->caches[offset / 4];
+}
+
 void risa_dense_function_delete(RisaDenseFunction* function) {
+    if(function->caches != NULL) {
+        for(uint32_t i = 0; i < function->cluster.size / 4; ++i) {
+            for(uint32_t j = 0; j < RISA_VM_INLINE_CACHE_SIZE; ++j) {
+                risa_shape_release(function->caches[i].entries[j].shape);
+                risa_shape_release(function->caches[i].entries[j].transition);
+            }
+        }
+
+        RISA_MEM_FREE(function->caches);
+    }
+
+    #ifdef RISA_VM_JIT
+        risa_vm_jit_free(function->jit);
+    #endif
+
     risa_cluster_delete(&function->cluster);
     risa_dense_function_init(function);
 }
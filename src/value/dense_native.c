@@ -5,8 +5,12 @@ RisaDenseNative* risa_dense_native_create(RisaNativeFunction function) {
     native->dense.type = RISA_DVAL_NATIVE;
     native->dense.link = NULL;
     native->dense.marked = false;
+    native->dense.registered = false;
+    native->dense.remembered = false;
+    native->dense.slab = 0;
 
     native->function = function;
+    native->borrowing = false;
 
     return native;
 }
@@ -1,15 +1,29 @@
 #include "dense.h"
 #include "../vm/vm.h"
 
+static void risa_dense_object_make_dictionary (RisaDenseObject* object);
+static void risa_dense_object_transition      (RisaDenseObject* object, RisaShape* shape, RisaValue value);
+static void risa_dense_object_cache_insert    (RisaInlineCache* cache, RisaShape* shape, RisaShape* transition, uint32_t slot);
+
 RisaDenseObject* risa_dense_object_create() {
     RisaDenseObject* object = (RisaDenseObject*) RISA_MEM_ALLOC(sizeof(RisaDenseObject));
+    object->dense.slab = 0;
 
     risa_dense_object_init(object);
     return object;
 }
 
+RisaDenseObject* risa_dense_object_create_with(RisaShape* root) {
+    RisaDenseObject* object = risa_dense_object_create();
+
+    risa_shape_retain(root);
+    object->shape = root;
+
+    return object;
+}
+
 RisaDenseObject* risa_dense_object_create_under(void* vm, uint32_t entryCount, ...) {
-    RisaDenseObject* obj = risa_dense_object_create();
+    RisaDenseObject* obj = risa_dense_object_create_with(((RisaVM*) vm)->shapes);
 
     va_list args;
 
@@ -22,7 +36,7 @@ RisaDenseObject* risa_dense_object_create_under(void* vm, uint32_t entryCount, .
 
         risa_dense_object_set(obj, risa_vm_string_create((RisaVM*) vm, key, keySize), val);
 
-        if(val.type == RISA_VAL_DENSE)
+        if(value_is_dense(val))
             risa_vm_register_dense((RisaVM *) vm, risa_value_as_dense(val));
     }
 
@@ -37,35 +51,227 @@ void risa_dense_object_init(RisaDenseObject* object) {
     object->dense.type = RISA_DVAL_OBJECT;
     object->dense.link = NULL;
     object->dense.marked = false;
+    object->dense.registered = false;
+    object->dense.remembered = false;
+
+    object->shape = NULL;
+    object->slots = NULL;
+    object->slotCapacity = 0;
 
     risa_map_init(&object->data);
 }
 
 void risa_dense_object_delete(RisaDenseObject* object) {
+    risa_shape_release(object->shape);
+    RISA_MEM_FREE(object->slots);
     risa_map_delete(&object->data);
     risa_dense_object_init(object);
 }
 
 uint32_t risa_dense_object_get_count(RisaDenseObject* object) {
-    return object->data.count;
+    return object->shape != NULL ? object->shape->count : object->data.count;
 }
 
-RisaMapEntry* risa_dense_object_get_entry(RisaDenseObject* object, uint32_t index) {
+bool risa_dense_object_get_entry(RisaDenseObject* object, uint32_t index, RisaDenseString** key, RisaValue* value) {
+    if(object->shape != NULL) {
+        if(index >= object->shape->count)
+            return false;
+
+        *key = risa_shape_get_ancestor(object->shape, index)->key;
+        *value = object->slots[index];
+        return true;
+    }
+
     for(uint32_t i = 0; i < object->data.capacity; ++i) {
         if(object->data.entries[i].key != NULL) {
-            if(index == 0)
-                return &object->data.entries[i];
+            if(index == 0) {
+                *key = object->data.entries[i].key;
+                *value = object->data.entries[i].value;
+                return true;
+            }
             --index;
         }
     }
 
-    return NULL;
+    return false;
+}
+
+void risa_dense_object_iterate(RisaDenseObject* object, RisaDenseObjectIterator* iterator) {
+    iterator->object = object;
+    iterator->index = 0;
+
+    if(object->shape != NULL)
+        for(RisaShape* shape = object->shape; shape->parent != NULL; shape = shape->parent)
+            iterator->keys[shape->count - 1] = shape->key;
+}
+
+bool risa_dense_object_next(RisaDenseObjectIterator* iterator, RisaDenseString** key, RisaValue* value) {
+    RisaDenseObject* object = iterator->object;
+
+    if(object->shape != NULL) {
+        if(iterator->index >= object->shape->count)
+            return false;
+
+        *key = (RisaDenseString*) iterator->keys[iterator->index];
+        *value = object->slots[iterator->index];
+        ++iterator->index;
+        return true;
+    }
+
+    while(iterator->index < object->data.capacity) {
+        RisaMapEntry* entry = &object->data.entries[iterator->index++];
+
+        if(entry->key != NULL) {
+            *key = (RisaDenseString*) entry->key;
+            *value = entry->value;
+            return true;
+        }
+    }
+
+    return false;
 }
 
 bool risa_dense_object_get(RisaDenseObject* object, RisaDenseString* key, RisaValue* value) {
-    return risa_map_get(&object->data, key, value);
+    if(object->shape == NULL)
+        return risa_map_get(&object->data, key, value);
+
+    uint32_t slot;
+
+    if(!risa_shape_find(object->shape, key, &slot))
+        return false;
+
+    *value = object->slots[slot];
+    return true;
 }
 
 void risa_dense_object_set(RisaDenseObject* object, RisaDenseString* key, RisaValue value) {
-    risa_map_set(&object->data, key, value);
+    if(object->shape == NULL) {
+        risa_map_set(&object->data, key, value);
+        return;
+    }
+
+    uint32_t slot;
+
+    if(risa_shape_find(object->shape, key, &slot)) {
+        object->slots[slot] = value;
+        return;
+    }
+
+    RisaShape* next = risa_shape_transition(object->shape, key);
+
+    if(next == NULL) {
+        risa_dense_object_make_dictionary(object);
+        risa_map_set(&object->data, key, value);
+        return;
+    }
+
+    risa_dense_object_transition(object, next, value);
+}
+
+bool risa_dense_object_get_cached(RisaDenseObject* object, RisaDenseString* key, RisaValue* value, RisaInlineCache* cache) {
+    if(object->shape == NULL)
+        return risa_map_get(&object->data, key, value);
+
+    for(uint32_t i = 0; i < RISA_VM_INLINE_CACHE_SIZE; ++i) {
+        RisaInlineCacheEntry* entry = &cache->entries[i];
+
+        if(entry->shape == object->shape && entry->transition == NULL) {
+            *value = object->slots[entry->slot];
+            return true;
+        }
+    }
+
+    uint32_t slot;
+
+    if(!risa_shape_find(object->shape, key, &slot))
+        return false;
+
+    risa_dense_object_cache_insert(cache, object->shape, NULL, slot);
+
+    *value = object->slots[slot];
+    return true;
+}
+
+void risa_dense_object_set_cached(RisaDenseObject* object, RisaDenseString* key, RisaValue value, RisaInlineCache* cache) {
+    if(object->shape == NULL) {
+        risa_map_set(&object->data, key, value);
+        return;
+    }
+
+    for(uint32_t i = 0; i < RISA_VM_INLINE_CACHE_SIZE; ++i) {
+        RisaInlineCacheEntry* entry = &cache->entries[i];
+
+        if(entry->shape == object->shape) {
+            if(entry->transition == NULL)
+                object->slots[entry->slot] = value;
+            else risa_dense_object_transition(object, entry->transition, value);
+            return;
+        }
+    }
+
+    uint32_t slot;
+
+    if(risa_shape_find(object->shape, key, &slot)) {
+        risa_dense_object_cache_insert(cache, object->shape, NULL, slot);
+        object->slots[slot] = value;
+        return;
+    }
+
+    RisaShape* next = risa_shape_transition(object->shape, key);
+
+    if(next == NULL) {
+        risa_dense_object_make_dictionary(object);
+        risa_map_set(&object->data, key, value);
+        return;
+    }
+
+    risa_dense_object_cache_insert(cache, object->shape, next, next->count - 1);
+    risa_dense_object_transition(object, next, value);
+}
+
+static void risa_dense_object_make_dictionary(RisaDenseObject* object) {
+    for(RisaShape* shape = object->shape; shape->parent != NULL; shape = shape->parent)
+        risa_map_set(&object->data, shape->key, object->slots[shape->count - 1]);
+
+    risa_shape_release(object->shape);
+    RISA_MEM_FREE(object->slots);
+
+    object->shape = NULL;
+    object->slots = NULL;
+    object->slotCapacity = 0;
+}
+
+// Moves the object to a child of its shape, and stores the value of the new property.
+static void risa_dense_object_transition(RisaDenseObject* object, RisaShape* shape, RisaValue value) {
+    if(shape->count > object->slotCapacity) {
+        // Objects built the same way as before get all of their slots at once.
+        object->slotCapacity = shape->capacityHint;
+        object->slots = (RisaValue*) RISA_MEM_REALLOC(object->slots, object->slotCapacity, sizeof(RisaValue));
+    }
+
+    risa_shape_retain(shape);
+    risa_shape_release(object->shape);
+
+    object->shape = shape;
+    object->slots[shape->count - 1] = value;
+}
+
+// The newest entry goes first, and the oldest one is evicted.
+static void risa_dense_object_cache_insert(RisaInlineCache* cache, RisaShape* shape, RisaShape* transition, uint32_t slot) {
+    RisaInlineCacheEntry* last = &cache->entries[RISA_VM_INLINE_CACHE_SIZE - 1];
+
+    risa_shape_release(last->shape);
+    risa_shape_release(last->transition);
+
+    for(uint32_t i = RISA_VM_INLINE_CACHE_SIZE - 1; i > 0; --i)
+        cache->entries[i] = cache->entries[i - 1];
+
+    risa_shape_retain(shape);
+
+    if(transition != NULL)
+        risa_shape_retain(transition);
+
+    cache->entries[0].shape = shape;
+    cache->entries[0].transition = transition;
+    cache->entries[0].slot = slot;
 }
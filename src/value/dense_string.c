@@ -11,17 +11,23 @@ uint32_t risa_dense_string_hash(RisaDenseString* string) {
 
 RisaDenseString* risa_dense_string_prepare(const char* chars, uint32_t length) {
     RisaDenseString* string = RISA_MEM_ALLOC(sizeof(RisaDenseString) + length + 1);
+    string->dense.slab = 0;
 
+    risa_dense_string_init(string, length);
+    memcpy(string->chars, chars, length);
+
+    return string;
+}
+
+void risa_dense_string_init(RisaDenseString* string, uint32_t length) {
     string->dense.type = RISA_DVAL_STRING;
     string->dense.link = NULL;
     string->dense.marked = false;
+    string->dense.registered = false;
+    string->dense.remembered = false;
 
     string->length = length;
-
-    memcpy(string->chars, chars, length);
     string->chars[length] = '\0';
-
-    return string;
 }
 
 RisaDenseString* risa_dense_string_from(const char* chars, uint32_t length) {
@@ -40,20 +46,19 @@ RisaDenseString* risa_dense_string_concat(RisaDenseString* left, RisaDenseString
     uint32_t length = left->length + right->length;
 
     RisaDenseString* string = RISA_MEM_ALLOC(sizeof(RisaDenseString) + length + 1);
+    string->dense.slab = 0;
 
-    string->dense.type = RISA_DVAL_STRING;
-    string->dense.link = NULL;
-    string->dense.marked = false;
-    
-    string->length = length;
+    risa_dense_string_init(string, length);
+    risa_dense_string_concat_into(string, left, right);
 
+    return string;
+}
+
+void risa_dense_string_concat_into(RisaDenseString* string, RisaDenseString* left, RisaDenseString* right) {
     memcpy(string->chars, left->chars, left->length);
     memcpy(string->chars + left->length, right->chars, right->length);
-    string->chars[length] = '\0';
 
     risa_dense_string_hash_inplace(string);
-
-    return string;
 }
 
 void risa_dense_string_hash_inplace(RisaDenseString* string) {
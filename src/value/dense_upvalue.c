@@ -2,12 +2,19 @@
 
 RisaDenseUpvalue* risa_dense_upvalue_create(RisaValue* value) {
     RisaDenseUpvalue* upvalue = RISA_MEM_ALLOC(sizeof(RisaDenseUpvalue));
+    upvalue->dense.slab = 0;
+
+    risa_dense_upvalue_init(upvalue, value);
+    return upvalue;
+}
+
+void risa_dense_upvalue_init(RisaDenseUpvalue* upvalue, RisaValue* value) {
     upvalue->dense.type = RISA_DVAL_UPVALUE;
     upvalue->dense.link = NULL;
     upvalue->dense.marked = false;
+    upvalue->dense.registered = false;
+    upvalue->dense.remembered = false;
 
     upvalue->ref = value;
     upvalue->closed = risa_value_from_null();
-
-    return upvalue;
 }
\ No newline at end of file
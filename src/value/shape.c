@@ -0,0 +1,96 @@
+#include "shape.h"
+
+#include "../mem/mem.h"
+#include "../def/def.h"
+
+static RisaShape* risa_shape_create(RisaShape* parent, RisaDenseStringPtr key);
+
+RisaShape* risa_shape_create_root() {
+    RisaShape* root = risa_shape_create(NULL, NULL);
+
+    risa_shape_retain(root);
+    return root;
+}
+
+void risa_shape_retain(RisaShape* shape) {
+    ++shape->refs;
+}
+
+void risa_shape_release(RisaShape* shape) {
+    while(shape != NULL && --shape->refs == 0) {
+        RisaShape* parent = shape->parent;
+
+        if(parent != NULL) {
+            for(uint32_t i = 0; i < parent->transitionCount; ++i) {
+                if(parent->transitions[i] == shape) {
+                    parent->transitions[i] = parent->transitions[--parent->transitionCount];
+                    break;
+                }
+            }
+        }
+
+        RISA_MEM_FREE(shape->transitions);
+        RISA_MEM_FREE(shape);
+
+        // The shape held a reference to its parent.
+        shape = parent;
+    }
+}
+
+bool risa_shape_find(RisaShape* shape, RisaDenseStringPtr key, uint32_t* slot) {
+    for(; shape->parent != NULL; shape = shape->parent) {
+        if(shape->key == key) {
+            *slot = shape->count - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+RisaShape* risa_shape_transition(RisaShape* shape, RisaDenseStringPtr key) {
+    for(uint32_t i = 0; i < shape->transitionCount; ++i)
+        if(shape->transitions[i]->key == key)
+            return shape->transitions[i];
+
+    if(shape->count >= RISA_SHAPE_MAX_PROPERTIES || shape->transitionCount >= RISA_SHAPE_MAX_TRANSITIONS)
+        return NULL;
+
+    if(shape->transitionCount == shape->transitionCapacity)
+        shape->transitions = (RisaShape**) RISA_MEM_EXPAND(shape->transitions, &shape->transitionCapacity, sizeof(RisaShape*));
+
+    // The child starts without references; it is freed as soon as the last object using it releases it.
+    RisaShape* child = risa_shape_create(shape, key);
+
+    for(RisaShape* ancestor = shape; ancestor != NULL && ancestor->capacityHint < child->count; ancestor = ancestor->parent)
+        ancestor->capacityHint = child->count;
+
+    shape->transitions[shape->transitionCount++] = child;
+
+    return child;
+}
+
+RisaShape* risa_shape_get_ancestor(RisaShape* shape, uint32_t slot) {
+    while(shape->count > slot + 1)
+        shape = shape->parent;
+
+    return shape;
+}
+
+static RisaShape* risa_shape_create(RisaShape* parent, RisaDenseStringPtr key) {
+    RisaShape* shape = (RisaShape*) RISA_MEM_ALLOC(sizeof(RisaShape));
+
+    shape->parent = parent;
+    shape->key = key;
+    shape->count = parent == NULL ? 0 : parent->count + 1;
+    shape->refs = 0;
+    shape->capacityHint = shape->count;
+    shape->transitions = NULL;
+    shape->transitionCount = 0;
+    shape->transitionCapacity = 0;
+
+    if(parent != NULL)
+        risa_shape_retain(parent);
+
+    return shape;
+}
@@ -0,0 +1,33 @@
+#ifndef RISA_SHAPE_H_GUARD
+#define RISA_SHAPE_H_GUARD
+
+#include "../api.h"
+#include "../def/types.h"
+#include "../data/map.h"
+
+// A shape describes the layout of an object: the keys it has, and the order in which they were added. Objects that
+// receive the same keys in the same order share a shape, and only store their values in a slot array.
+//
+// Shapes form a tree. Every shape except the root adds one key to its parent, and that key lives in the slot
+// 'count - 1'. Children hold a reference to their parent, while the parent only keeps a weak list of transitions.
+typedef struct RisaShape {
+    struct RisaShape* parent;
+    RisaDenseStringPtr key;
+
+    uint32_t count;
+    uint32_t refs;
+    uint32_t capacityHint; // The largest count among the shape and its descendants, used to size the slot arrays.
+
+    struct RisaShape** transitions;
+    uint32_t transitionCount;
+    uint32_t transitionCapacity;
+} RisaShape;
+
+RISA_API RisaShape* risa_shape_create_root  (); // The root is returned with one reference.
+RISA_API void       risa_shape_retain       (RisaShape* shape);
+RISA_API void       risa_shape_release      (RisaShape* shape);
+RISA_API bool       risa_shape_find         (RisaShape* shape, RisaDenseStringPtr key, uint32_t* slot);
+RISA_API RisaShape* risa_shape_transition   (RisaShape* shape, RisaDenseStringPtr key); // NULL if the object should become a dictionary.
+RISA_API RisaShape* risa_shape_get_ancestor (RisaShape* shape, uint32_t slot); // The shape that added the key in 'slot'.
+
+#endif
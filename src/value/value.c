@@ -7,7 +7,7 @@
 #include <string.h>
 
 void risa_value_print(RisaIO* io, RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
         case RISA_VAL_NULL:
             RISA_OUT((*io), "null");
             break;
@@ -35,7 +35,7 @@ void risa_value_print(RisaIO* io, RisaValue value) {
 char* risa_value_to_string(RisaValue value) {
     char* data;
 
-    switch(value.type) {
+    switch(risa_value_type(value)) {
         case RISA_VAL_NULL: {
             data = RISA_MEM_ALLOC(sizeof("null"));
             memcpy(data, "null\0", sizeof("null"));
@@ -93,7 +93,7 @@ char* risa_value_to_string(RisaValue value) {
 }
 
 RisaValue risa_value_clone(RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
         case RISA_VAL_NULL:
         case RISA_VAL_BOOL:
         case RISA_VAL_BYTE:
@@ -108,7 +108,7 @@ RisaValue risa_value_clone(RisaValue value) {
 }
 
 RisaValue risa_value_clone_register(void* vm, RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
         case RISA_VAL_NULL:
         case RISA_VAL_BOOL:
         case RISA_VAL_BYTE:
@@ -123,7 +123,7 @@ RisaValue risa_value_clone_register(void* vm, RisaValue value) {
 }
 
 bool risa_value_is_truthy(RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
         case RISA_VAL_NULL:
             return false;
         case RISA_VAL_BOOL:
@@ -146,7 +146,7 @@ bool risa_value_is_falsy(RisaValue value) {
 }
 
 bool risa_value_equals(RisaValue left, RisaValue right) {
-    if(left.type != right.type) {
+    if(risa_value_type(left) != risa_value_type(right)) {
         if(risa_value_is_byte(left)) {
             if(risa_value_is_int(right))
                 return risa_value_as_byte(left) == risa_value_as_int(right);
@@ -168,7 +168,7 @@ bool risa_value_equals(RisaValue left, RisaValue right) {
         } else return false;
     }
 
-    switch(left.type) {
+    switch(risa_value_type(left)) {
         case RISA_VAL_NULL:  return true;
         case RISA_VAL_BOOL:  return risa_value_as_bool(left) == risa_value_as_bool(right);
         case RISA_VAL_BYTE:  return risa_value_as_byte(left) == risa_value_as_byte(right);
@@ -180,12 +180,12 @@ bool risa_value_equals(RisaValue left, RisaValue right) {
 }
 
 bool risa_value_strict_equals(RisaValue left, RisaValue right) {
-    if(left.type != right.type)
+    if(risa_value_type(left) != risa_value_type(right))
         return false;
-    if(left.type == RISA_VAL_DENSE && risa_value_as_dense(left)->type != risa_value_as_dense(right)->type)
+    if(value_is_dense(left) && risa_value_as_dense(left)->type != risa_value_as_dense(right)->type)
         return false;
 
-    switch(left.type) {
+    switch(risa_value_type(left)) {
         case RISA_VAL_NULL:  return true;
         case RISA_VAL_BOOL:  return risa_value_as_bool(left) == risa_value_as_bool(right);
         case RISA_VAL_BYTE:  return risa_value_as_byte(left) == risa_value_as_byte(right);
@@ -200,6 +200,146 @@ bool risa_value_is_dense_of_type(RisaValue value, RisaDenseValueType type) {
     return value_is_dense(value) && risa_value_as_dense(value)->type == type;
 }
 
+#ifdef RISA_VALUE_NAN_BOXING
+
+// Boxes a payload into the NaN that belongs to the type.
+#define RISA_VALUE_NAN_BOX(type, payload) \
+    ((RisaValue) { RISA_VALUE_NAN_TAG_MASK | ((uint64_t) ((type) + 1) << RISA_VALUE_NAN_TYPE_SHIFT) | ((uint64_t) (payload) & RISA_VALUE_NAN_PAYLOAD_MASK) })
+
+#define RISA_VALUE_NAN_PAYLOAD(value) ((value).bits & RISA_VALUE_NAN_PAYLOAD_MASK)
+
+RisaValueType risa_value_type(RisaValue value) {
+    if((value.bits & RISA_VALUE_NAN_TAG_MASK) != RISA_VALUE_NAN_TAG_MASK)
+        return RISA_VAL_FLOAT;
+
+    return (RisaValueType) (((value.bits & RISA_VALUE_NAN_TYPE_MASK) >> RISA_VALUE_NAN_TYPE_SHIFT) - 1);
+}
+
+RisaValue risa_value_from_null() {
+    return RISA_VALUE_NAN_BOX(RISA_VAL_NULL, 0);
+}
+
+RisaValue risa_value_from_bool(bool value) {
+    return RISA_VALUE_NAN_BOX(RISA_VAL_BOOL, value);
+}
+
+RisaValue risa_value_from_byte(uint8_t value) {
+    return RISA_VALUE_NAN_BOX(RISA_VAL_BYTE, value);
+}
+
+RisaValue risa_value_from_int(uint64_t value) {
+    return RISA_VALUE_NAN_BOX(RISA_VAL_INT, value);
+}
+
+RisaValue risa_value_from_float(double value) {
+    RisaValue v;
+
+    // Other NaNs could look like boxed values.
+    if(value != value)
+        v.bits = RISA_VALUE_NAN_CANONICAL;
+    else memcpy(&v.bits, &value, sizeof(double));
+
+    return v;
+}
+
+RisaValue risa_value_from_dense(RisaDenseValue* value) {
+    return RISA_VALUE_NAN_BOX(RISA_VAL_DENSE, (uintptr_t) value);
+}
+
+static int64_t risa_value_nan_int(RisaValue value) {
+    // Sign-extends the 48-bit payload.
+    return ((int64_t) (RISA_VALUE_NAN_PAYLOAD(value) << 16)) >> 16;
+}
+
+static double risa_value_nan_float(RisaValue value) {
+    double d;
+    memcpy(&d, &value.bits, sizeof(double));
+
+    return d;
+}
+
+bool risa_value_as_bool(RisaValue value) {
+    if(risa_value_is_bool(value)) {
+        return RISA_VALUE_NAN_PAYLOAD(value) != 0;
+    }
+
+    return false;
+}
+
+uint8_t risa_value_as_byte(RisaValue value) {
+    if(risa_value_is_byte(value))
+        return (uint8_t) RISA_VALUE_NAN_PAYLOAD(value);
+    if(risa_value_is_int(value))
+        return (uint8_t) risa_value_nan_int(value);
+    if(risa_value_is_float(value))
+        return (uint8_t) risa_value_nan_float(value);
+
+    return 0;
+}
+
+int64_t risa_value_as_int(RisaValue value) {
+    if(risa_value_is_int(value))
+        return risa_value_nan_int(value);
+    if(risa_value_is_byte(value))
+        return (int64_t) RISA_VALUE_NAN_PAYLOAD(value);
+    if(risa_value_is_float(value))
+        return (int64_t) risa_value_nan_float(value);
+
+    return 0;
+}
+
+double risa_value_as_float(RisaValue value) {
+    if(risa_value_is_float(value))
+        return risa_value_nan_float(value);
+    if(risa_value_is_int(value))
+        return (double) risa_value_nan_int(value);
+    if(risa_value_is_byte(value))
+        return (double) RISA_VALUE_NAN_PAYLOAD(value);
+
+    return RISA_VALUE_FLOAT_MIN;
+}
+
+RisaDenseValue* risa_value_as_dense(RisaValue value) {
+    if(value_is_dense(value)) {
+        return (RisaDenseValue*) (uintptr_t) RISA_VALUE_NAN_PAYLOAD(value);
+    }
+
+    return NULL;
+}
+
+bool risa_value_is_null(RisaValue value) {
+    return value.bits == risa_value_from_null().bits;
+}
+
+bool risa_value_is_bool(RisaValue value) {
+    return (value.bits & (RISA_VALUE_NAN_TAG_MASK | RISA_VALUE_NAN_TYPE_MASK)) == RISA_VALUE_NAN_BOX(RISA_VAL_BOOL, 0).bits;
+}
+
+bool risa_value_is_byte(RisaValue value) {
+    return (value.bits & (RISA_VALUE_NAN_TAG_MASK | RISA_VALUE_NAN_TYPE_MASK)) == RISA_VALUE_NAN_BOX(RISA_VAL_BYTE, 0).bits;
+}
+
+bool risa_value_is_int(RisaValue value) {
+    return (value.bits & (RISA_VALUE_NAN_TAG_MASK | RISA_VALUE_NAN_TYPE_MASK)) == RISA_VALUE_NAN_BOX(RISA_VAL_INT, 0).bits;
+}
+
+bool risa_value_is_float(RisaValue value) {
+    return (value.bits & RISA_VALUE_NAN_TAG_MASK) != RISA_VALUE_NAN_TAG_MASK;
+}
+
+bool value_is_dense(RisaValue value) {
+    return (value.bits & (RISA_VALUE_NAN_TAG_MASK | RISA_VALUE_NAN_TYPE_MASK)) == RISA_VALUE_NAN_BOX(RISA_VAL_DENSE, 0).bits;
+}
+
+#undef RISA_VALUE_NAN_PAYLOAD
+#undef RISA_VALUE_NAN_BOX
+
+#else
+
+RisaValueType risa_value_type(RisaValue value) {
+    return value.type;
+}
+
 RisaValue risa_value_from_null() {
     RisaValue value;
     value.type = RISA_VAL_NULL;
@@ -257,7 +397,7 @@ bool risa_value_as_bool(RisaValue value) {
 }
 
 uint8_t risa_value_as_byte(RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
     case RISA_VAL_BYTE:
         return value.as.byte;
     case RISA_VAL_INT:
@@ -270,7 +410,7 @@ uint8_t risa_value_as_byte(RisaValue value) {
 }
 
 int64_t risa_value_as_int(RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
     case RISA_VAL_BYTE:
         return (int64_t) value.as.byte;
     case RISA_VAL_INT:
@@ -283,7 +423,7 @@ int64_t risa_value_as_int(RisaValue value) {
 }
 
 double risa_value_as_float(RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
     case RISA_VAL_BYTE:
         return (double) value.as.byte;
     case RISA_VAL_INT:
@@ -325,4 +465,6 @@ bool risa_value_is_float(RisaValue value) {
 
 bool value_is_dense(RisaValue value) {
     return value.type == RISA_VAL_DENSE;
-}
\ No newline at end of file
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "../api.h"
 #include "../io/io.h"
+#include "../def/def.h"
 #include "../def/types.h"
 
 typedef enum {
@@ -28,19 +29,45 @@ typedef struct RisaDenseValue {
     RisaDenseValueType type;
     struct RisaDenseValue* link;
     bool marked;
+    bool registered; // Whether or not the value is linked into a VM's value list.
+    bool remembered; // Whether or not the value is in the remembered set of the generational GC.
+    uint8_t slab;    // The size class of the value in the slab allocator of its VM, or 0 if it was allocated on its own.
 } RisaDenseValue;
 
-typedef struct {
-    RisaValueType type;
-
-    union {
-        bool boolean;
-        uint8_t byte;
-        int64_t integer;
-        double floating;
-        RisaDenseValue* dense;
-    } as;
-} RisaValue;
+#ifdef RISA_VALUE_NAN_BOXING
+    // Floats are stored as they are, with every NaN turned into the same quiet NaN. The other values are stored in the
+    // negative quiet NaNs: the type (plus 1) goes into bits 48-50, and the payload into the low 48 bits. Ints only
+    // keep 48 bits, so they wrap around in [-2^47, 2^47 - 1]. Dense values are pointers, which fit in 48 bits.
+    #define RISA_VALUE_NAN_TAG_MASK     0xFFF8000000000000ull
+    #define RISA_VALUE_NAN_TYPE_MASK    0x0007000000000000ull
+    #define RISA_VALUE_NAN_PAYLOAD_MASK 0x0000FFFFFFFFFFFFull
+    #define RISA_VALUE_NAN_CANONICAL    0x7FF8000000000000ull
+    #define RISA_VALUE_NAN_TYPE_SHIFT   48
+
+    #define RISA_VALUE_NAN_INT_MIN      (-((int64_t) 1 << 47))
+    #define RISA_VALUE_NAN_INT_MAX      (((int64_t) 1 << 47) - 1)
+
+    typedef struct {
+        uint64_t bits;
+    } RisaValue;
+
+    // Like risa_value_as_dense, but without checking the type.
+    #define RISA_AS_DENSE(value) ((RisaDenseValue*) (uintptr_t) ((value).bits & RISA_VALUE_NAN_PAYLOAD_MASK))
+#else
+    typedef struct {
+        RisaValueType type;
+
+        union {
+            bool boolean;
+            uint8_t byte;
+            int64_t integer;
+            double floating;
+            RisaDenseValue* dense;
+        } as;
+    } RisaValue;
+
+    #define RISA_AS_DENSE(value) ((value).as.dense)
+#endif
 
 typedef struct {
     uint32_t size;
@@ -49,6 +76,8 @@ typedef struct {
     RisaValue* values;
 } RisaValueArray;
 
+RISA_API RisaValueType risa_value_type          (RisaValue value);
+
 RISA_API void      risa_value_print             (RisaIO* io, RisaValue value);
 RISA_API char*     risa_value_to_string         (RisaValue value);
 RISA_API RisaValue risa_value_clone             (RisaValue value);
@@ -34,11 +34,17 @@ static RisaValue value_num_from_string(char* str, uint32_t length) {
         return risa_value_from_null();
     }
 
+    #ifdef RISA_VALUE_NAN_BOXING
+        // Boxed ints only have 48 bits, so larger literals are rejected instead of wrapping around.
+        if(num < RISA_VALUE_NAN_INT_MIN || num > RISA_VALUE_NAN_INT_MAX)
+            return risa_value_from_null();
+    #endif
+
     return risa_value_from_int(num);
 }
 
 bool risa_value_is_num(RisaValue value) {
-    switch(value.type) {
+    switch(risa_value_type(value)) {
         case RISA_VAL_BYTE:
         case RISA_VAL_INT:
         case RISA_VAL_FLOAT:
@@ -55,7 +61,7 @@ RisaValue risa_value_int_from_string(char* str, uint32_t length) {
 RisaValue risa_value_byte_from_string(char* str, uint32_t length) {
     RisaValue result = value_num_from_string(str, length);
 
-    return result.type == RISA_VAL_NULL ? result : risa_value_from_byte((uint8_t) risa_value_as_int(result));
+    return risa_value_is_null(result) ? result : risa_value_from_byte((uint8_t) risa_value_as_int(result));
 }
 
 RisaValue risa_value_float_from_string(char* str) {
@@ -15,19 +15,24 @@
 #ifdef DEBUG
     #define VM_DEBUG_CHECK_STACK                                                          \
         do {                                                                              \
-            if(vm->stack + RISA_VM_STACK_SIZE < vm->stackTop || vm->stackTop < vm->stack) \
+            if(vm->stack + vm->stackCapacity < vm->stackTop || vm->stackTop < vm->stack)  \
                 RISA_PANIC("VM stack top out of bounds");                                 \
         } while(false)
 #else
     #define VM_DEBUG_CHECK_STACK
 #endif
 
+static RisaVMStatus risa_vm_run_loop(RisaVM*, uint32_t);
+
 static bool risa_vm_call_register (RisaVM*, uint8_t, uint8_t);
+static bool risa_vm_call_tail     (RisaVM*, uint8_t, uint8_t);
 static bool risa_vm_call_value    (RisaVM*, RisaValue*, RisaValue, uint8_t, bool);
 static bool risa_vm_call_function (RisaVM*, RisaValue*, RisaValue, uint8_t, bool);
 static bool risa_vm_call_closure  (RisaVM*, RisaValue*, RisaValue, uint8_t, bool);
 static bool risa_vm_call_native   (RisaVM*, RisaValue*, RisaValue, uint8_t, bool);
+static bool risa_vm_call_reserve  (RisaVM*, RisaValue**, RisaDenseFunction*);
 static RisaValue risa_vm_invoke_directly(RisaVM*, RisaValue*, RisaValue, uint8_t);
+static void risa_vm_call_escape   (RisaVM*, uint8_t, uint8_t);
 
 static RisaDenseUpvalue* risa_vm_upvalue_capture    (RisaVM* vm, RisaValue* local);
 static void              risa_vm_upvalue_close_from (RisaVM* vm, RisaValue* slot);
@@ -43,31 +48,89 @@ RisaVM* risa_vm_create() {
 void risa_vm_init(RisaVM* vm) {
     risa_io_init(&vm->io);
 
+    vm->frames = (RisaCallFrame*) RISA_MEM_ALLOC(RISA_VM_CALLFRAME_INITIAL_COUNT * sizeof(RisaCallFrame));
+    vm->frameCapacity = RISA_VM_CALLFRAME_INITIAL_COUNT;
+    vm->frameLimit = RISA_VM_CALLFRAME_COUNT;
+
+    vm->stack = (RisaValue*) RISA_MEM_ALLOC(RISA_VM_STACK_INITIAL_SIZE * sizeof(RisaValue));
+    vm->stackCapacity = RISA_VM_STACK_INITIAL_SIZE;
+    vm->stackLimit = RISA_VM_STACK_SIZE;
+
     risa_vm_stack_reset(vm);
 
     risa_map_init(&vm->strings);
-    risa_map_init(&vm->globals);
+    risa_map_init(&vm->globalSlots);
+
+    vm->globals = NULL;
+    vm->globalCount = 0;
+    vm->globalCapacity = 0;
+
+    vm->shapes = risa_shape_create_root();
+    risa_slab_init(&vm->slabs);
 
     vm->frameCount = 0;
     vm->values = NULL;
+    vm->sweeping = NULL;
     vm->acc = risa_value_from_null();
     vm->options.replMode = false; // TODO: Split compiler and vm options into separate structs.
     vm->heapSize = 0;
     vm->heapThreshold = RISA_VM_HEAP_INITIAL_THRESHOLD;
+    vm->heapLimit = RISA_VM_HEAP_LIMIT;
+
+    vm->gcPacing.growthFactor = RISA_GC_GROWTH_FACTOR;
+    vm->gcPacing.minThreshold = RISA_GC_MIN_THRESHOLD;
+    vm->gcPacing.maxThreshold = RISA_GC_MAX_THRESHOLD;
+    vm->gcPacing.cpuTarget = RISA_GC_CPU_TARGET;
+    vm->gcGrowth = RISA_GC_GROWTH_FACTOR;
+    vm->gcTime = 0;
+    vm->gcCycleStart = clock();
+    vm->gcPacePending = false;
+
+    vm->young = NULL;
+    vm->remembered = NULL;
+    vm->rememberedCount = 0;
+    vm->rememberedCapacity = 0;
+    vm->youngSize = 0;
+
+    vm->grey = NULL;
+    vm->greyCount = 0;
+    vm->greyCapacity = 0;
+    vm->greyOverflow = false;
+    vm->gcMarking = false;
+    vm->gcPauseTarget = RISA_GC_PAUSE_TARGET;
+    vm->gcStepThreshold = 0;
+    vm->gcPool = NULL;
 }
 
 void risa_vm_delete(RisaVM* vm) {
+    risa_gc_stop(vm);
+
     risa_map_delete(&vm->strings);
-    risa_map_delete(&vm->globals);
+    risa_map_delete(&vm->globalSlots);
+
+    RISA_MEM_FREE(vm->globals);
 
-    RisaDenseValue* dense = vm->values;
+    RisaDenseValue* lists[] = { vm->values, vm->young, vm->sweeping };
 
-    while(dense != NULL) {
-        RisaDenseValue* next = dense->link;
-        vm->heapSize -= risa_dense_size(dense);
-        risa_dense_delete(dense);
-        dense = next;
+    for(uint8_t i = 0; i < 3; ++i) {
+        RisaDenseValue* dense = lists[i];
+
+        while(dense != NULL) {
+            RisaDenseValue* next = dense->link;
+            vm->heapSize -= risa_dense_size(dense);
+            risa_vm_dense_free(vm, dense);
+            dense = next;
+        }
     }
+
+    RISA_MEM_FREE(vm->remembered);
+    RISA_MEM_FREE(vm->grey);
+
+    risa_shape_release(vm->shapes);
+    risa_slab_delete(&vm->slabs);
+
+    RISA_MEM_FREE(vm->frames);
+    RISA_MEM_FREE(vm->stack);
 }
 
 void risa_vm_free(RisaVM* vm) {
@@ -77,19 +140,7 @@ void risa_vm_free(RisaVM* vm) {
 }
 
 void risa_vm_clean(RisaVM* vm) {
-    while(vm->frameCount > 1) {
-        RisaCallFrame* frame = &vm->frames[vm->frameCount - 1];
-
-        switch(frame->type) {
-            case RISA_FRAME_FUNCTION:
-                risa_dense_delete((RisaDenseValue *) frame->callee.function);
-                break;
-            case RISA_FRAME_CLOSURE:
-                risa_dense_delete((RisaDenseValue *) frame->callee.closure);
-                break;
-        }
-    }
-
+    // The callees of the dropped frames are owned by the GC, which frees them if nothing else uses them.
     risa_vm_stack_reset(vm);
     risa_gc_run(vm);
 }
@@ -109,7 +160,6 @@ void risa_vm_load_function(RisaVM* vm, RisaDenseFunction* function) {
 
     vm->acc = risa_value_from_null();
     vm->frameCount = 1;
-    vm->stackTop += 250;
 }
 
 void risa_vm_load_strings(RisaVM* vm, RisaMap* strings) {
@@ -132,11 +182,68 @@ void risa_vm_set_repl_mode(RisaVM* vm, bool mode) {
     vm->options.replMode = mode;
 }
 
+void risa_vm_set_limits(RisaVM* vm, uint32_t frameLimit, uint32_t stackLimit) {
+    // The first frame must always fit.
+    vm->frameLimit = frameLimit < 1 ? 1 : frameLimit;
+    vm->stackLimit = stackLimit < RISA_VM_CALLFRAME_STACK_SIZE ? RISA_VM_CALLFRAME_STACK_SIZE : stackLimit;
+}
+
+void risa_vm_set_heap_limit(RisaVM* vm, size_t heapLimit) {
+    vm->heapLimit = heapLimit;
+}
+
+void risa_vm_set_gc_pause_target(RisaVM* vm, uint32_t pauseTarget) {
+    vm->gcPauseTarget = pauseTarget;
+}
+
+void risa_vm_set_gc_pacing(RisaVM* vm, RisaGCPacing pacing) {
+    // A factor of 1 or less would collect at every allocation once the heap is over the minimum.
+    if(pacing.growthFactor < RISA_GC_MIN_GROWTH)
+        pacing.growthFactor = RISA_GC_MIN_GROWTH;
+    if(pacing.maxThreshold != 0 && pacing.maxThreshold < pacing.minThreshold)
+        pacing.maxThreshold = pacing.minThreshold;
+    if(pacing.cpuTarget > 99)
+        pacing.cpuTarget = 99;
+
+    vm->gcPacing = pacing;
+    vm->gcGrowth = pacing.growthFactor;
+
+    // The first threshold isn't set by the pacing, so it is clamped here. A lazy sweep in progress sets it afterwards.
+    if(vm->heapThreshold != SIZE_MAX) {
+        if(vm->heapThreshold < pacing.minThreshold)
+            vm->heapThreshold = pacing.minThreshold;
+        else if(pacing.maxThreshold != 0 && vm->heapThreshold > pacing.maxThreshold)
+            vm->heapThreshold = pacing.maxThreshold;
+    }
+}
+
+RisaGCPacing risa_vm_get_gc_pacing(RisaVM* vm) {
+    return vm->gcPacing;
+}
+
 RisaVMStatus risa_vm_execute(RisaVM* vm) {
     return risa_vm_run(vm, 0);
 }
 
+// Running out of memory while the script runs turns into a runtime error. The VM is left as it was before the
+// allocation, so it can still be deleted.
 RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
+    jmp_buf recovery;
+    jmp_buf* previous = risa_mem_set_recovery(&recovery);
+    RisaVMStatus status;
+
+    if(setjmp(recovery) == 0) {
+        status = risa_vm_run_loop(vm, maxInstr);
+    } else {
+        VM_RUNTIME_ERROR(vm, "Out of memory");
+        status = RISA_VM_STATUS_ERROR;
+    }
+
+    risa_mem_set_recovery(previous);
+    return status;
+}
+
+static RisaVMStatus risa_vm_run_loop(RisaVM* vm, uint32_t maxInstr) {
     RisaCallFrame* frame = &vm->frames[vm->frameCount - 1];
     bool forever = maxInstr == 0;
 
@@ -146,7 +253,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
     #define DEST            (*frame->ip)
     #define LEFT            (frame->ip[1])
     #define RIGHT           (frame->ip[2])
-    #define COMBINED        ((((uint16_t) frame->ip[1]) << 8) | (frame->ip[2]))
+    #define COMBINED        (risa_op_read_word(frame->ip + 1))
 
     #define DEST_CONST      (VM_FRAME_FUNCTION(*frame)->cluster.constants.values[DEST])
     #define LEFT_CONST      (VM_FRAME_FUNCTION(*frame)->cluster.constants.values[LEFT])
@@ -164,6 +271,163 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
     #define SKIP(count)     (frame->ip += count)
     #define BSKIP(count)    (frame->ip -= count)
 
+    // The inline cache of the current instruction. The function allocates its caches on the first use.
+    #define VM_INLINE_CACHE()                                                                                   \
+        (VM_FRAME_FUNCTION(*frame)->caches != NULL                                                              \
+            ? &VM_FRAME_FUNCTION(*frame)->caches[(frame->ip - 1 - VM_FRAME_FUNCTION(*frame)->cluster.bytecode) / 4] \
+            : risa_dense_function_get_cache(VM_FRAME_FUNCTION(*frame), (uint32_t) (frame->ip - 1 - VM_FRAME_FUNCTION(*frame)->cluster.bytecode)))
+
+    // Rewrites the current instruction in place, keeping its operand types.
+    #define VM_QUICKEN(op)  (frame->ip[-1] = (uint8_t) (types | (op)))
+
+    // Turns the current instruction back into its generic form, and executes it again without consuming the budget.
+    #define VM_DEQUICKEN(op)            \
+        do {                            \
+            VM_QUICKEN(op);             \
+            instruction = (op);         \
+            goto _vm_dispatch;          \
+        } while(false)
+
+    // Lets the GC run after an allocation, and fails if the heap is still over the limit of the VM.
+    #define VM_GC_CHECK()                                                               \
+        do {                                                                            \
+            if(!risa_gc_check(vm)) {                                                    \
+                VM_RUNTIME_ERROR(vm, "Heap limit exceeded (%zu bytes)", vm->heapLimit); \
+                return RISA_VM_STATUS_ERROR;                                            \
+            }                                                                           \
+        } while(false)
+
+    // Counts the calls and back jumps of the current function, and switches to its machine code once it is hot.
+    // The code returns when the frame changes, and the interpreter follows into the code of the new frame. Only
+    // unbounded runs use the JIT, since the machine code doesn't count instructions.
+    #ifdef RISA_VM_JIT
+        #define VM_JIT_ENTER()                                                                      \
+            do {                                                                                    \
+                if(!forever)                                                                        \
+                    break;                                                                          \
+                                                                                                    \
+                RisaDenseFunction* jitFunction = VM_FRAME_FUNCTION(*frame);                         \
+                                                                                                    \
+                if(jitFunction->jit == NULL) {                                                      \
+                    if(++jitFunction->heat != RISA_VM_JIT_THRESHOLD)                                \
+                        break;                                                                      \
+                                                                                                    \
+                    jitFunction->jit = risa_vm_jit_compile(jitFunction);                            \
+                }                                                                                   \
+                                                                                                    \
+                while(jitFunction->jit != NULL) {                                                   \
+                    RisaJitExit exit = risa_vm_jit_enter(vm, jitFunction->jit, frame);              \
+                                                                                                    \
+                    if(exit == RISA_JIT_EXIT_ERROR)                                                 \
+                        return RISA_VM_STATUS_ERROR;                                                \
+                    if(exit == RISA_JIT_EXIT_HALT)                                                  \
+                        return RISA_VM_STATUS_OK;                                                   \
+                                                                                                    \
+                    frame = &vm->frames[vm->frameCount - 1];                                        \
+                                                                                                    \
+                    if(exit == RISA_JIT_EXIT_NONE)                                                  \
+                        break;                                                                      \
+                                                                                                    \
+                    jitFunction = VM_FRAME_FUNCTION(*frame);                                        \
+                }                                                                                   \
+            } while(false)
+    #else
+        #define VM_JIT_ENTER() do { } while(false)
+    #endif
+
+    // Threaded dispatch: every handler jumps directly to the handler of the next instruction through a label table,
+    // instead of going back to a single switch. This gives the branch predictor one indirect jump per handler.
+    #ifdef RISA_VM_THREADED_DISPATCH
+        #define VM_SWITCH(op)   goto *dispatch[op];
+        #define VM_CASE(op)     _vm_op_##op
+        #define VM_DEFAULT      _vm_op_default
+        #define VM_NEXT()                                                  \
+            do {                                                           \
+                if(!forever && --maxInstr == 0)                            \
+                    return RISA_VM_STATUS_HALTED;                          \
+                                                                           \
+                VM_DEBUG_CHECK_STACK;                                      \
+                                                                           \
+                instruction = NEXT_BYTE();                                 \
+                types = instruction & RISA_TODLR_TYPE_MASK;                \
+                instruction &= RISA_TODLR_INSTRUCTION_MASK;                \
+                                                                           \
+                goto *dispatch[instruction];                               \
+            } while(false)
+
+        static void* dispatch[RISA_TODLR_INSTRUCTION_MASK + 1] = {
+            [RISA_OP_CNST]            = &&VM_CASE(RISA_OP_CNST),
+            [RISA_OP_CNSTW]           = &&VM_CASE(RISA_OP_CNSTW),
+            [RISA_OP_MOV]             = &&VM_CASE(RISA_OP_MOV),
+            [RISA_OP_CLONE]           = &&VM_CASE(RISA_OP_CLONE),
+            [RISA_OP_DGLOB]           = &&VM_CASE(RISA_OP_DGLOB),
+            [RISA_OP_GGLOB]           = &&VM_CASE(RISA_OP_GGLOB),
+            [RISA_OP_SGLOB]           = &&VM_CASE(RISA_OP_SGLOB),
+            [RISA_OP_UPVAL]           = &&VM_CASE(RISA_OP_UPVAL),
+            [RISA_OP_GUPVAL]          = &&VM_CASE(RISA_OP_GUPVAL),
+            [RISA_OP_SUPVAL]          = &&VM_CASE(RISA_OP_SUPVAL),
+            [RISA_OP_CUPVAL]          = &&VM_CASE(RISA_OP_CUPVAL),
+            [RISA_OP_CLSR]            = &&VM_CASE(RISA_OP_CLSR),
+            [RISA_OP_ARR]             = &&VM_CASE(RISA_OP_ARR),
+            [RISA_OP_PARR]            = &&VM_CASE(RISA_OP_PARR),
+            [RISA_OP_LEN]             = &&VM_CASE(RISA_OP_LEN),
+            [RISA_OP_OBJ]             = &&VM_CASE(RISA_OP_OBJ),
+            [RISA_OP_GET]             = &&VM_CASE(RISA_OP_GET),
+            [RISA_OP_SET]             = &&VM_CASE(RISA_OP_SET),
+            [RISA_OP_NULL]            = &&VM_CASE(RISA_OP_NULL),
+            [RISA_OP_TRUE]            = &&VM_CASE(RISA_OP_TRUE),
+            [RISA_OP_FALSE]           = &&VM_CASE(RISA_OP_FALSE),
+            [RISA_OP_NOT]             = &&VM_CASE(RISA_OP_NOT),
+            [RISA_OP_BNOT]            = &&VM_CASE(RISA_OP_BNOT),
+            [RISA_OP_NEG]             = &&VM_CASE(RISA_OP_NEG),
+            [RISA_OP_INC]             = &&VM_CASE(RISA_OP_INC),
+            [RISA_OP_DEC]             = &&VM_CASE(RISA_OP_DEC),
+            [RISA_OP_ADD]             = &&VM_CASE(RISA_OP_ADD),
+            [RISA_OP_SUB]             = &&VM_CASE(RISA_OP_SUB),
+            [RISA_OP_MUL]             = &&VM_CASE(RISA_OP_MUL),
+            [RISA_OP_DIV]             = &&VM_CASE(RISA_OP_DIV),
+            [RISA_OP_MOD]             = &&VM_CASE(RISA_OP_MOD),
+            [RISA_OP_SHL]             = &&VM_CASE(RISA_OP_SHL),
+            [RISA_OP_SHR]             = &&VM_CASE(RISA_OP_SHR),
+            [RISA_OP_LT]              = &&VM_CASE(RISA_OP_LT),
+            [RISA_OP_LTE]             = &&VM_CASE(RISA_OP_LTE),
+            [RISA_OP_EQ]              = &&VM_CASE(RISA_OP_EQ),
+            [RISA_OP_NEQ]             = &&VM_CASE(RISA_OP_NEQ),
+            [RISA_OP_BAND]            = &&VM_CASE(RISA_OP_BAND),
+            [RISA_OP_BXOR]            = &&VM_CASE(RISA_OP_BXOR),
+            [RISA_OP_BOR]             = &&VM_CASE(RISA_OP_BOR),
+            [RISA_OP_TEST]            = &&VM_CASE(RISA_OP_TEST),
+            [RISA_OP_NTEST]           = &&VM_CASE(RISA_OP_NTEST),
+            [RISA_OP_JMP]             = &&VM_CASE(RISA_OP_JMP),
+            [RISA_OP_JMPW]            = &&VM_CASE(RISA_OP_JMPW),
+            [RISA_OP_BJMP]            = &&VM_CASE(RISA_OP_BJMP),
+            [RISA_OP_BJMPW]           = &&VM_CASE(RISA_OP_BJMPW),
+            [RISA_OP_CALL]            = &&VM_CASE(RISA_OP_CALL),
+            [RISA_OP_RET]             = &&VM_CASE(RISA_OP_RET),
+            [RISA_OP_ACC]             = &&VM_CASE(RISA_OP_ACC),
+            [RISA_OP_DIS]             = &&VM_CASE(RISA_OP_DIS),
+            [RISA_OP_TCALL]           = &&VM_CASE(RISA_OP_TCALL),
+            [RISA_OP_ADD_INT_INT]     = &&VM_CASE(RISA_OP_ADD_INT_INT),
+            [RISA_OP_SUB_INT_INT]     = &&VM_CASE(RISA_OP_SUB_INT_INT),
+            [RISA_OP_MUL_INT_INT]     = &&VM_CASE(RISA_OP_MUL_INT_INT),
+            [RISA_OP_LT_INT_INT]      = &&VM_CASE(RISA_OP_LT_INT_INT),
+            [RISA_OP_LTE_INT_INT]     = &&VM_CASE(RISA_OP_LTE_INT_INT),
+            [RISA_OP_ADD_FLOAT_FLOAT] = &&VM_CASE(RISA_OP_ADD_FLOAT_FLOAT),
+            [RISA_OP_SUB_FLOAT_FLOAT] = &&VM_CASE(RISA_OP_SUB_FLOAT_FLOAT),
+            [RISA_OP_MUL_FLOAT_FLOAT] = &&VM_CASE(RISA_OP_MUL_FLOAT_FLOAT),
+            [RISA_OP_LT_FLOAT_FLOAT]  = &&VM_CASE(RISA_OP_LT_FLOAT_FLOAT),
+            [RISA_OP_LTE_FLOAT_FLOAT] = &&VM_CASE(RISA_OP_LTE_FLOAT_FLOAT),
+            [RISA_OP_GGLOB_SLOT]      = &&VM_CASE(RISA_OP_GGLOB_SLOT),
+            [RISA_OP_SGLOB_SLOT]      = &&VM_CASE(RISA_OP_SGLOB_SLOT),
+            [RISA_OP_SGLOB_SLOT + 1 ... RISA_TODLR_INSTRUCTION_MASK] = &&VM_DEFAULT
+        };
+    #else
+        #define VM_SWITCH(op)   switch(op)
+        #define VM_CASE(op)     case op
+        #define VM_DEFAULT      default
+        #define VM_NEXT()       break
+    #endif
+
     while(1) {
         VM_DEBUG_CHECK_STACK;
 
@@ -171,69 +435,84 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
         uint8_t types = instruction & RISA_TODLR_TYPE_MASK;
         instruction &= RISA_TODLR_INSTRUCTION_MASK;
 
-        switch(instruction) {
-            case RISA_OP_CNST: {
+    _vm_dispatch:
+
+        VM_SWITCH(instruction) {
+            VM_CASE(RISA_OP_CNST): {
                 DEST_REG = LEFT_CONST;
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_CNSTW: {
+            VM_CASE(RISA_OP_CNSTW): {
                 DEST_REG = COMBINED_CONST;
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_MOV: {
+            VM_CASE(RISA_OP_MOV): {
                 DEST_REG = LEFT_REG;
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_CLONE: {
+            VM_CASE(RISA_OP_CLONE): {
                 DEST_REG = risa_value_clone_register(vm, LEFT_REG);
 
-                risa_gc_check(vm);
+                VM_GC_CHECK();
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_DGLOB: {
-                risa_map_set(&vm->globals, RISA_AS_STRING(DEST_CONST), LEFT_BY_TYPE);
-                risa_gc_check(vm);
+            VM_CASE(RISA_OP_DGLOB): {
+                risa_vm_global_define(vm, RISA_AS_STRING(DEST_CONST), LEFT_BY_TYPE);
+                VM_GC_CHECK();
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_GGLOB: {
-                RisaValue value;
+            VM_CASE(RISA_OP_GGLOB): {
+                uint32_t slot;
 
-                if(!risa_map_get(&vm->globals, RISA_AS_STRING(LEFT_CONST), &value)) {
+                if(!risa_vm_global_slot(vm, RISA_AS_STRING(LEFT_CONST), &slot)) {
                     VM_RUNTIME_ERROR(vm, "Undefined variable '%s'", RISA_AS_CSTRING(LEFT_CONST));
                     return RISA_VM_STATUS_ERROR;
                 }
 
-                DEST_REG = value;
+                DEST_REG = vm->globals[slot].value;
+
+                // Cache the slot in the unused operand.
+                if(slot <= UINT8_MAX) {
+                    RIGHT = (uint8_t) slot;
+                    VM_QUICKEN(RISA_OP_GGLOB_SLOT);
+                }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_SGLOB: {
-                if(risa_map_set(&vm->globals, RISA_AS_STRING(DEST_CONST), LEFT_BY_TYPE)) {
-                    risa_map_erase(&vm->globals, RISA_AS_STRING(DEST_CONST));
+            VM_CASE(RISA_OP_SGLOB): {
+                uint32_t slot;
 
+                if(!risa_vm_global_slot(vm, RISA_AS_STRING(DEST_CONST), &slot)) {
                     VM_RUNTIME_ERROR(vm, "Undefined variable '%s'", RISA_AS_CSTRING(DEST_CONST));
                     return RISA_VM_STATUS_ERROR;
                 }
 
+                vm->globals[slot].value = LEFT_BY_TYPE;
+
+                if(slot <= UINT8_MAX) {
+                    RIGHT = (uint8_t) slot;
+                    VM_QUICKEN(RISA_OP_SGLOB_SLOT);
+                }
+
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_UPVAL: {
+            VM_CASE(RISA_OP_UPVAL): {
                 VM_RUNTIME_ERROR(vm, "Illegal instruction 'UPVAL'; must be after 'CLSR'");
                 return RISA_VM_STATUS_ERROR;
             }
-            case RISA_OP_GUPVAL: {
+            VM_CASE(RISA_OP_GUPVAL): {
                 if(frame->type != RISA_FRAME_CLOSURE) {
                     VM_RUNTIME_ERROR(vm, "Frame not of type 'closure'");
                     return RISA_VM_STATUS_ERROR;
@@ -242,31 +521,32 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 DEST_REG = *(frame->callee.closure->upvalues[LEFT]->ref);
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_SUPVAL: {
+            VM_CASE(RISA_OP_SUPVAL): {
                 if(frame->type != RISA_FRAME_CLOSURE) {
                     VM_RUNTIME_ERROR(vm, "Frame not of type 'closure'");
                     return RISA_VM_STATUS_ERROR;
                 }
 
-                *frame->callee.closure->upvalues[DEST]->ref = LEFT_REG;
+                RisaDenseUpvalue* upvalue = frame->callee.closure->upvalues[DEST];
+
+                RISA_GC_BARRIER(vm, (RisaDenseValue*) upvalue);
+                *upvalue->ref = LEFT_REG;
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_CUPVAL: {
+            VM_CASE(RISA_OP_CUPVAL): {
                 risa_vm_upvalue_close_from(vm, &DEST_REG);
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_CLSR: {
+            VM_CASE(RISA_OP_CLSR): {
                 // TODO: Check if right reg is a dense function, in case someone injects bytecode with a CLSR instruction.
                 RisaDenseFunction* function = (RisaDenseFunction*) risa_value_as_dense(LEFT_REG);
-                RisaDenseClosure* closure = risa_dense_closure_create(function, RIGHT);
-
-                risa_vm_register_dense(vm, (RisaDenseValue *) closure);
+                RisaDenseClosure* closure = risa_vm_closure_create(vm, function, RIGHT);
 
                 DEST_REG = risa_value_from_dense((RisaDenseValue*) closure);
 
@@ -278,7 +558,10 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                     uint8_t index = DEST;
                     bool local = LEFT;
 
-                    if(local)
+                    // The compiler proved that the closure never outlives this frame, so the register can be used directly.
+                    if(local && RIGHT)
+                        risa_dense_closure_capture(closure, i, frame->regs + index);
+                    else if(local)
                         closure->upvalues[i] = risa_vm_upvalue_capture(vm, frame->regs + index);
                     else {
                         if(frame->type != RISA_FRAME_CLOSURE) {
@@ -290,13 +573,15 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                     }
                 }
 
-                risa_gc_check(vm);
+                // Registered after the captures, so the size includes the direct cells.
+                risa_vm_register_dense(vm, (RisaDenseValue *) closure);
+                VM_GC_CHECK();
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_LEN: {
-                switch(LEFT_REG.type) {
+            VM_CASE(RISA_OP_LEN): {
+                switch(risa_value_type(LEFT_REG)) {
                     case RISA_VAL_DENSE:
                         switch(risa_value_as_dense(LEFT_REG)->type) {
                             case RISA_DVAL_ARRAY:
@@ -317,17 +602,17 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
             _op_len_success:
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_ARR: {
-                DEST_REG = risa_value_from_dense((RisaDenseValue*) risa_dense_array_create());
+            VM_CASE(RISA_OP_ARR): {
+                DEST_REG = risa_value_from_dense((RisaDenseValue*) risa_vm_array_create(vm));
                 risa_vm_register_dense(vm, risa_value_as_dense(DEST_REG));
-                risa_gc_check(vm);
+                VM_GC_CHECK();
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_PARR: {
+            VM_CASE(RISA_OP_PARR): {
                 if(!risa_value_is_dense_of_type(DEST_REG, RISA_DVAL_ARRAY)) {
                     VM_RUNTIME_ERROR(vm, "Destination must be an array");
                     return RISA_VM_STATUS_ERROR;
@@ -340,22 +625,23 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                     return RISA_VM_STATUS_ERROR;
                 }
 
+                RISA_GC_BARRIER(vm, (RisaDenseValue*) array);
                 risa_value_array_write(&array->data, LEFT_BY_TYPE);
-                risa_gc_check(vm);
+                VM_GC_CHECK();
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_OBJ: {
-                DEST_REG = risa_value_from_dense((RisaDenseValue*) risa_dense_object_create());
+            VM_CASE(RISA_OP_OBJ): {
+                DEST_REG = risa_value_from_dense((RisaDenseValue*) risa_vm_object_create(vm));
                 risa_vm_register_dense(vm, risa_value_as_dense(DEST_REG));
-                risa_gc_check(vm);
+                VM_GC_CHECK();
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_GET: {
-                switch(LEFT_REG.type) {
+            VM_CASE(RISA_OP_GET): {
+                switch(risa_value_type(LEFT_REG)) {
                     case RISA_VAL_DENSE:
                         switch(risa_value_as_dense(LEFT_REG)->type) {
                             case RISA_DVAL_ARRAY: {
@@ -392,7 +678,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
 
                                 DEST_REG = risa_value_from_dense((RisaDenseValue*) risa_vm_string_create(vm, str->chars + index, 1));
 
-                                risa_gc_check(vm);
+                                VM_GC_CHECK();
 
                                 goto _op_get_success;
                             }
@@ -406,8 +692,23 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                                 RisaDenseString* key = RISA_AS_STRING(RIGHT_BY_TYPE);
 
                                 RisaValue value;
+                                bool found;
 
-                                if(!risa_dense_object_get(object, key, &value)) {
+                                // Constant keys get an inline cache; the first entry is checked here to avoid a call.
+                                if(types & RISA_TODLR_TYPE_RIGHT_MASK) {
+                                    RisaInlineCache* cache = VM_INLINE_CACHE();
+                                    RisaInlineCacheEntry* entry = &cache->entries[0];
+
+                                    if(entry->shape == object->shape && object->shape != NULL && entry->transition == NULL) {
+                                        DEST_REG = object->slots[entry->slot];
+                                        goto _op_get_success;
+                                    }
+
+                                    RISA_GC_BARRIER(vm, (RisaDenseValue*) VM_FRAME_FUNCTION(*frame));
+                                    found = risa_dense_object_get_cached(object, key, &value, cache);
+                                } else found = risa_dense_object_get(object, key, &value);
+
+                                if(!found) {
                                     VM_RUNTIME_ERROR(vm, "Object property does not exist");
                                     return RISA_VM_STATUS_ERROR;
                                 }
@@ -428,10 +729,10 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
             _op_get_success:
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_SET: {
-                switch(DEST_REG.type) {
+            VM_CASE(RISA_OP_SET): {
+                switch(risa_value_type(DEST_REG)) {
                     case RISA_VAL_DENSE:
                         switch(risa_value_as_dense(DEST_REG)->type) {
                             case RISA_DVAL_ARRAY: {
@@ -443,6 +744,8 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                                 RisaDenseArray* array = RISA_AS_ARRAY(DEST_REG);
                                 int64_t index = risa_value_as_int(LEFT_BY_TYPE);
 
+                                RISA_GC_BARRIER(vm, (RisaDenseValue*) array);
+
                                 if(index < 0 || index > array->data.size) {
                                     VM_RUNTIME_ERROR(vm, "Index out of bounds");
                                     return RISA_VM_STATUS_ERROR;
@@ -453,7 +756,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                                     }
 
                                     risa_value_array_write(&array->data, RIGHT_BY_TYPE);
-                                    risa_gc_check(vm);
+                                    VM_GC_CHECK();
                                 } else risa_dense_array_set(array, (uint32_t) index, RIGHT_BY_TYPE);
 
                                 goto _op_set_success;
@@ -521,9 +824,23 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                                 RisaDenseObject* object = RISA_AS_OBJECT(DEST_REG);
                                 RisaDenseString* key = RISA_AS_STRING(LEFT_BY_TYPE);
 
-                                risa_dense_object_set(object, key, RIGHT_BY_TYPE);
+                                RISA_GC_BARRIER(vm, (RisaDenseValue*) object);
 
-                                risa_gc_check(vm);
+                                if(types & RISA_TODLR_TYPE_LEFT_MASK) {
+                                    RisaInlineCache* cache = VM_INLINE_CACHE();
+                                    RisaInlineCacheEntry* entry = &cache->entries[0];
+
+                                    if(entry->shape == object->shape && object->shape != NULL && entry->transition == NULL) {
+                                        object->slots[entry->slot] = RIGHT_BY_TYPE;
+                                        goto _op_set_success;
+                                    }
+
+                                    // The cache may get new shapes, whose keys are kept alive by the function.
+                                    RISA_GC_BARRIER(vm, (RisaDenseValue*) VM_FRAME_FUNCTION(*frame));
+                                    risa_dense_object_set_cached(object, key, RIGHT_BY_TYPE, cache);
+                                } else risa_dense_object_set(object, key, RIGHT_BY_TYPE);
+
+                                VM_GC_CHECK();
 
                                 goto _op_set_success;
                             }
@@ -539,33 +856,33 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
             _op_set_success:
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_NULL: {
+            VM_CASE(RISA_OP_NULL): {
                 DEST_REG = risa_value_from_null();
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_TRUE: {
+            VM_CASE(RISA_OP_TRUE): {
                 DEST_REG = risa_value_from_bool(true);
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_FALSE: {
+            VM_CASE(RISA_OP_FALSE): {
                 DEST_REG = risa_value_from_bool(false);
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_NOT: {
+            VM_CASE(RISA_OP_NOT): {
                 DEST_REG = risa_value_from_bool(risa_value_is_falsy(LEFT_BY_TYPE));
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_BNOT: {
+            VM_CASE(RISA_OP_BNOT): {
                 RisaValue left = LEFT_BY_TYPE;
 
                 if(risa_value_is_byte(left))
@@ -578,9 +895,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_NEG: {
+            VM_CASE(RISA_OP_NEG): {
                 RisaValue left = LEFT_BY_TYPE;
 
                 if(risa_value_is_byte(left))
@@ -595,43 +912,43 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_INC: {
+            VM_CASE(RISA_OP_INC): {
                 RisaValue dest = DEST_REG;
 
                 if(risa_value_is_byte(dest))
-                    ++DEST_REG.as.byte;
+                    DEST_REG = risa_value_from_byte((uint8_t) (risa_value_as_byte(dest) + 1));
                 else if(risa_value_is_int(dest))
-                    ++DEST_REG.as.integer;
+                    DEST_REG = risa_value_from_int(risa_value_as_int(dest) + 1);
                 else if(risa_value_is_float(dest))
-                    ++DEST_REG.as.floating;
+                    DEST_REG = risa_value_from_float(risa_value_as_float(dest) + 1);
                 else {
                     VM_RUNTIME_ERROR(vm, "Operand must be either byte, int or float");
                     return RISA_VM_STATUS_ERROR;
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_DEC: {
+            VM_CASE(RISA_OP_DEC): {
                 RisaValue dest = DEST_REG;
 
                 if(risa_value_is_byte(dest))
-                    --DEST_REG.as.byte;
+                    DEST_REG = risa_value_from_byte((uint8_t) (risa_value_as_byte(dest) - 1));
                 else if(risa_value_is_int(dest))
-                    --DEST_REG.as.integer;
+                    DEST_REG = risa_value_from_int(risa_value_as_int(dest) - 1);
                 else if(risa_value_is_float(dest))
-                    --DEST_REG.as.floating;
+                    DEST_REG = risa_value_from_float(risa_value_as_float(dest) - 1);
                 else {
                     VM_RUNTIME_ERROR(vm, "Operand must be either byte, int or float");
                     return RISA_VM_STATUS_ERROR;
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_ADD: {
+            VM_CASE(RISA_OP_ADD): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -651,6 +968,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_int(risa_value_as_int(left) + risa_value_as_byte(right));
                     } else if(risa_value_is_int(right)) {
                         DEST_REG = risa_value_from_int(risa_value_as_int(left) + risa_value_as_int(right));
+                        VM_QUICKEN(RISA_OP_ADD_INT_INT);
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_float(risa_value_as_int(left) + risa_value_as_float(right));
                     } else {
@@ -664,25 +982,17 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_float(risa_value_as_float(left) + risa_value_as_int(right));
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_float(risa_value_as_float(left) + risa_value_as_float(right));
+                        VM_QUICKEN(RISA_OP_ADD_FLOAT_FLOAT);
                     } else {
                         VM_RUNTIME_ERROR(vm, "Right operand must be either int or float");
                         return RISA_VM_STATUS_ERROR;
                     }
                 } else if(risa_value_is_dense_of_type(left, RISA_DVAL_STRING)) {
                     if(risa_value_is_dense_of_type(right, RISA_DVAL_STRING)) {
-                        RisaDenseString* result = risa_dense_string_concat(RISA_AS_STRING(left), RISA_AS_STRING(right));
-                        RisaDenseString* interned = risa_map_find(&vm->strings, result->chars, result->length, result->hash);
-
-                        if(interned != NULL) {
-                            RISA_MEM_FREE(result);
-                            result = interned;
-                            DEST_REG = risa_value_from_dense((RisaDenseValue*) result);
-                        } else {
-                            risa_vm_register_string(vm, result);
-                            risa_vm_register_dense(vm, (RisaDenseValue *) result);
-                            DEST_REG = risa_value_from_dense((RisaDenseValue*) result);
-                            risa_gc_check(vm);
-                        }
+                        RisaDenseString* result = risa_vm_string_concat(vm, RISA_AS_STRING(left), RISA_AS_STRING(right));
+
+                        DEST_REG = risa_value_from_dense((RisaDenseValue*) result);
+                        VM_GC_CHECK();
                     } else {
                         VM_RUNTIME_ERROR(vm, "Left operand must be string");
                         return RISA_VM_STATUS_ERROR;
@@ -693,9 +1003,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_SUB: {
+            VM_CASE(RISA_OP_SUB): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -715,6 +1025,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_int(risa_value_as_int(left) - risa_value_as_byte(right));
                     } else if(risa_value_is_int(right)) {
                         DEST_REG = risa_value_from_int(risa_value_as_int(left) - risa_value_as_int(right));
+                        VM_QUICKEN(RISA_OP_SUB_INT_INT);
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_float(risa_value_as_int(left) - risa_value_as_float(right));
                     } else {
@@ -728,6 +1039,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_float(risa_value_as_float(left) - risa_value_as_int(right));
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_float(risa_value_as_float(left) - risa_value_as_float(right));
+                        VM_QUICKEN(RISA_OP_SUB_FLOAT_FLOAT);
                     } else {
                         VM_RUNTIME_ERROR(vm, "Right operand must be either byte, int or float");
                         return RISA_VM_STATUS_ERROR;
@@ -738,9 +1050,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_MUL: {
+            VM_CASE(RISA_OP_MUL): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -760,6 +1072,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_int(risa_value_as_int(left) * risa_value_as_byte(right));
                     } else if(risa_value_is_int(right)) {
                         DEST_REG = risa_value_from_int(risa_value_as_int(left) * risa_value_as_int(right));
+                        VM_QUICKEN(RISA_OP_MUL_INT_INT);
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_float(risa_value_as_int(left) * risa_value_as_float(right));
                     } else {
@@ -773,6 +1086,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_float(risa_value_as_float(left) * risa_value_as_int(right));
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_float(risa_value_as_float(left) * risa_value_as_float(right));
+                        VM_QUICKEN(RISA_OP_MUL_FLOAT_FLOAT);
                     } else {
                         VM_RUNTIME_ERROR(vm, "Right operand must be either byte, int or float");
                         return RISA_VM_STATUS_ERROR;
@@ -783,9 +1097,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_DIV: {
+            VM_CASE(RISA_OP_DIV): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -828,9 +1142,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_MOD: {
+            VM_CASE(RISA_OP_MOD): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -858,9 +1172,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_SHL: {
+            VM_CASE(RISA_OP_SHL): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -903,9 +1217,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_SHR: {
+            VM_CASE(RISA_OP_SHR): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -948,9 +1262,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_LT: {
+            VM_CASE(RISA_OP_LT): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -970,6 +1284,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_bool(risa_value_as_int(left) < risa_value_as_byte(right));
                     } else if(risa_value_is_int(right)) {
                         DEST_REG = risa_value_from_bool(risa_value_as_int(left) < risa_value_as_int(right));
+                        VM_QUICKEN(RISA_OP_LT_INT_INT);
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_bool(risa_value_as_int(left) < risa_value_as_float(right));
                     } else {
@@ -983,6 +1298,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_bool(risa_value_as_float(left) < risa_value_as_int(right));
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_bool(risa_value_as_float(left) < risa_value_as_float(right));
+                        VM_QUICKEN(RISA_OP_LT_FLOAT_FLOAT);
                     } else {
                         VM_RUNTIME_ERROR(vm, "Right operand must be either int or float");
                         return RISA_VM_STATUS_ERROR;
@@ -993,9 +1309,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_LTE: {
+            VM_CASE(RISA_OP_LTE): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -1015,6 +1331,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_bool(risa_value_as_int(left) <= risa_value_as_byte(right));
                     } else if(risa_value_is_int(right)) {
                         DEST_REG = risa_value_from_bool(risa_value_as_int(left) <= risa_value_as_int(right));
+                        VM_QUICKEN(RISA_OP_LTE_INT_INT);
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_bool(risa_value_as_int(left) <= risa_value_as_float(right));
                     } else {
@@ -1028,6 +1345,7 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                         DEST_REG = risa_value_from_bool(risa_value_as_float(left) <= risa_value_as_int(right));
                     } else if(risa_value_is_float(right)) {
                         DEST_REG = risa_value_from_bool(risa_value_as_float(left) <= risa_value_as_float(right));
+                        VM_QUICKEN(RISA_OP_LTE_FLOAT_FLOAT);
                     } else {
                         VM_RUNTIME_ERROR(vm, "Right operand must be either int or float");
                         return RISA_VM_STATUS_ERROR;
@@ -1038,27 +1356,27 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_EQ: {
+            VM_CASE(RISA_OP_EQ): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
                 DEST_REG = risa_value_from_bool(risa_value_equals(left, right));
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_NEQ: {
+            VM_CASE(RISA_OP_NEQ): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
                 DEST_REG = risa_value_from_bool(!risa_value_equals(left, right));
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_BAND: {
+            VM_CASE(RISA_OP_BAND): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -1086,9 +1404,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_BXOR: {
+            VM_CASE(RISA_OP_BXOR): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -1116,9 +1434,9 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_BOR: {
+            VM_CASE(RISA_OP_BOR): {
                 RisaValue left = LEFT_BY_TYPE;
                 RisaValue right = RIGHT_BY_TYPE;
 
@@ -1146,56 +1464,89 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 }
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_TEST: {
+            VM_CASE(RISA_OP_TEST): {
                 if(risa_value_is_truthy(DEST_REG))
                     SKIP(4);
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_NTEST: {
+            VM_CASE(RISA_OP_NTEST): {
                 if(risa_value_is_falsy(DEST_REG))
                     SKIP(4);
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_JMP: {
+            VM_CASE(RISA_OP_JMP): {
                 SKIP(DEST * 4);
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_JMPW: {
-                uint16_t amount = *((uint16_t*) &frame->ip); // This takes DEST and LEFT as 16 bits.
+            VM_CASE(RISA_OP_JMPW): {
+                uint16_t amount = risa_op_read_word(frame->ip); // This takes DEST and LEFT as 16 bits.
 
                 SKIP(amount * 4);
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_BJMP: {
+            VM_CASE(RISA_OP_BJMP): {
                 BSKIP(DEST * 4);
                 BSKIP(1);
-                break;
+                VM_JIT_ENTER();
+                VM_NEXT();
             }
-            case RISA_OP_BJMPW: {
-                uint16_t amount = *((uint16_t*) &frame->ip); // This takes DEST and LEFT as 16 bits.
+            VM_CASE(RISA_OP_BJMPW): {
+                uint16_t amount = risa_op_read_word(frame->ip); // This takes DEST and LEFT as 16 bits.
 
                 BSKIP(amount * 4);
                 BSKIP(1);
-                break;
+                VM_JIT_ENTER();
+                VM_NEXT();
             }
-            case RISA_OP_CALL: {
+            VM_CASE(RISA_OP_CALL): {
+                uint32_t frameCount = vm->frameCount;
+
+                if(RIGHT)
+                    risa_vm_call_escape(vm, DEST, LEFT);
+
                 if(!risa_vm_call_register(vm, DEST, LEFT))
                     return RISA_VM_STATUS_ERROR;
 
+                // The frame array may have been reallocated by the call.
+                frame = &vm->frames[vm->frameCount - 1];
+
                 // Native function.
-                if(frame == &vm->frames[vm->frameCount - 1])
+                if(vm->frameCount == frameCount)
                     SKIP(3);
-                else frame = &vm->frames[vm->frameCount - 1];
+                else VM_JIT_ENTER();
 
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_RET: {
+            VM_CASE(RISA_OP_TCALL): {
+                if(RIGHT)
+                    risa_vm_call_escape(vm, DEST, LEFT);
+
+                // Natives have no frame to take over, so they are called normally and the next RET returns the result.
+                if(risa_value_is_dense_of_type(DEST_REG, RISA_DVAL_NATIVE)) {
+                    if(!risa_vm_call_register(vm, DEST, LEFT))
+                        return RISA_VM_STATUS_ERROR;
+
+                    frame = &vm->frames[vm->frameCount - 1];
+
+                    SKIP(3);
+                    VM_NEXT();
+                }
+
+                if(!risa_vm_call_tail(vm, DEST, LEFT))
+                    return RISA_VM_STATUS_ERROR;
+
+                frame = &vm->frames[vm->frameCount - 1];
+
+                VM_JIT_ENTER();
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_RET): {
                 risa_vm_upvalue_close_from(vm, frame->regs);
 
                 --vm->frameCount;
@@ -1210,25 +1561,26 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                     *frame->base = risa_value_from_null();
                 else *frame->base = DEST_REG;
 
-                vm->stackTop -= 251; // = frame->base + 1;
-
                 frame = &vm->frames[vm->frameCount - 1];
 
+                // Shrink the stack back to the registers of the caller.
+                vm->stackTop = frame->regs + VM_FRAME_FUNCTION(*frame)->cluster.registerCount;
+
                 // If the frame is isolated, halt the RisaVM.
                 if(vm->frames[vm->frameCount].isolated) {
                     return RISA_VM_STATUS_OK;
                 }
 
                 SKIP(3); // Skip the CALL args.
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_ACC: {
+            VM_CASE(RISA_OP_ACC): {
                 vm->acc = DEST_BY_TYPE;
 
                 SKIP(3);
-                break;
+                VM_NEXT();
             }
-            case RISA_OP_DIS: {
+            VM_CASE(RISA_OP_DIS): {
                 RisaDenseFunction* func;
 
                 if(DEST > 249)
@@ -1256,9 +1608,148 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
                 RISA_OUT(vm->io, "\n\n");
 
                 SKIP(3);
-                break;
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_ADD_INT_INT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_int(left) || !risa_value_is_int(right))
+                    VM_DEQUICKEN(RISA_OP_ADD);
+
+                DEST_REG = risa_value_from_int(risa_value_as_int(left) + risa_value_as_int(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_SUB_INT_INT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_int(left) || !risa_value_is_int(right))
+                    VM_DEQUICKEN(RISA_OP_SUB);
+
+                DEST_REG = risa_value_from_int(risa_value_as_int(left) - risa_value_as_int(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_MUL_INT_INT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_int(left) || !risa_value_is_int(right))
+                    VM_DEQUICKEN(RISA_OP_MUL);
+
+                DEST_REG = risa_value_from_int(risa_value_as_int(left) * risa_value_as_int(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_LT_INT_INT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_int(left) || !risa_value_is_int(right))
+                    VM_DEQUICKEN(RISA_OP_LT);
+
+                DEST_REG = risa_value_from_bool(risa_value_as_int(left) < risa_value_as_int(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_LTE_INT_INT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_int(left) || !risa_value_is_int(right))
+                    VM_DEQUICKEN(RISA_OP_LTE);
+
+                DEST_REG = risa_value_from_bool(risa_value_as_int(left) <= risa_value_as_int(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_ADD_FLOAT_FLOAT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_float(left) || !risa_value_is_float(right))
+                    VM_DEQUICKEN(RISA_OP_ADD);
+
+                DEST_REG = risa_value_from_float(risa_value_as_float(left) + risa_value_as_float(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_SUB_FLOAT_FLOAT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_float(left) || !risa_value_is_float(right))
+                    VM_DEQUICKEN(RISA_OP_SUB);
+
+                DEST_REG = risa_value_from_float(risa_value_as_float(left) - risa_value_as_float(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_MUL_FLOAT_FLOAT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_float(left) || !risa_value_is_float(right))
+                    VM_DEQUICKEN(RISA_OP_MUL);
+
+                DEST_REG = risa_value_from_float(risa_value_as_float(left) * risa_value_as_float(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_LT_FLOAT_FLOAT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_float(left) || !risa_value_is_float(right))
+                    VM_DEQUICKEN(RISA_OP_LT);
+
+                DEST_REG = risa_value_from_bool(risa_value_as_float(left) < risa_value_as_float(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_LTE_FLOAT_FLOAT): {
+                RisaValue left = LEFT_BY_TYPE;
+                RisaValue right = RIGHT_BY_TYPE;
+
+                if(!risa_value_is_float(left) || !risa_value_is_float(right))
+                    VM_DEQUICKEN(RISA_OP_LTE);
+
+                DEST_REG = risa_value_from_bool(risa_value_as_float(left) <= risa_value_as_float(right));
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_GGLOB_SLOT): {
+                // The cluster may be executed by another VM, in which the slot belongs to another global.
+                if(RIGHT >= vm->globalCount || vm->globals[RIGHT].name != RISA_AS_STRING(LEFT_CONST))
+                    VM_DEQUICKEN(RISA_OP_GGLOB);
+
+                DEST_REG = vm->globals[RIGHT].value;
+
+                SKIP(3);
+                VM_NEXT();
+            }
+            VM_CASE(RISA_OP_SGLOB_SLOT): {
+                if(RIGHT >= vm->globalCount || vm->globals[RIGHT].name != RISA_AS_STRING(DEST_CONST))
+                    VM_DEQUICKEN(RISA_OP_SGLOB);
+
+                vm->globals[RIGHT].value = LEFT_BY_TYPE;
+
+                SKIP(3);
+                VM_NEXT();
             }
-            default: {
+            VM_DEFAULT: {
                 VM_RUNTIME_ERROR(vm, "Illegal instruction");
                 return RISA_VM_STATUS_ERROR;
             }
@@ -1275,6 +1766,17 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
 
     return RISA_VM_STATUS_HALTED;
 
+    #undef VM_NEXT
+    #undef VM_DEFAULT
+    #undef VM_CASE
+    #undef VM_SWITCH
+
+    #undef VM_JIT_ENTER
+    #undef VM_GC_CHECK
+    #undef VM_DEQUICKEN
+    #undef VM_QUICKEN
+    #undef VM_INLINE_CACHE
+
     #undef BSKIP
     #undef SKIP
 
@@ -1300,12 +1802,16 @@ RisaVMStatus risa_vm_run(RisaVM* vm, uint32_t maxInstr) {
 }
 
 RisaValue risa_vm_invoke(RisaVM* vm, RisaValue* base, RisaValue callee, uint8_t argc, ...) {
-    // Check the frame count before pushing anything on the stack.
-    if(vm->frameCount == RISA_VM_CALLFRAME_COUNT) {
+    // Check the limits before pushing anything on the stack.
+    size_t offset = base - vm->stack;
+
+    if(vm->frameCount == vm->frameLimit || !risa_vm_stack_ensure(vm, offset + 1 + argc)) {
         VM_RUNTIME_ERROR(vm, "Stack overflow");
         return risa_value_from_null();
     }
 
+    base = vm->stack + offset;
+
     RisaValue* ptr = base + 1;
     RisaValue* end = ptr + argc;
 
@@ -1324,12 +1830,16 @@ RisaValue risa_vm_invoke(RisaVM* vm, RisaValue* base, RisaValue callee, uint8_t
 }
 
 RisaValue risa_vm_invoke_args(RisaVM* vm, RisaValue* base, RisaValue callee, uint8_t argc, RisaValue* args) {
-    // Check the frame count before pushing anything on the stack.
-    if(vm->frameCount == RISA_VM_CALLFRAME_COUNT) {
+    // Check the limits before pushing anything on the stack.
+    size_t offset = base - vm->stack;
+
+    if(vm->frameCount == vm->frameLimit || !risa_vm_stack_ensure(vm, offset + 1 + argc)) {
         VM_RUNTIME_ERROR(vm, "Stack overflow");
         return risa_value_from_null();
     }
 
+    base = vm->stack + offset;
+
     RisaValue* ptr = base + 1;
     RisaValue* end = ptr + argc;
 
@@ -1342,6 +1852,9 @@ RisaValue risa_vm_invoke_args(RisaVM* vm, RisaValue* base, RisaValue callee, uin
 }
 
 static RisaValue risa_vm_invoke_directly(RisaVM* vm, RisaValue* base, RisaValue callee, uint8_t argc) {
+    // The result is read through the offset, as the stack may have moved.
+    size_t offset = base - vm->stack;
+
     if(value_is_dense(callee)) {
         switch(risa_value_as_dense(callee)->type) {
             case RISA_DVAL_FUNCTION: {
@@ -1359,13 +1872,13 @@ static RisaValue risa_vm_invoke_directly(RisaVM* vm, RisaValue* base, RisaValue
                 if(risa_vm_run(vm, 0) == RISA_VM_STATUS_ERROR)
                     return risa_value_from_null();
 
-                return *base;
+                return vm->stack[offset];
             }
             case RISA_DVAL_NATIVE: {
                 if(!risa_vm_call_native(vm, base, callee, argc, true))
                     return risa_value_from_null();
 
-                return *base;
+                return vm->stack[offset];
             }
             default: ;
         }
@@ -1381,6 +1894,60 @@ static bool risa_vm_call_register(RisaVM* vm, uint8_t reg, uint8_t argc) {
     return risa_vm_call_value(vm, callee, *callee, argc, false);
 }
 
+static void risa_vm_call_escape(RisaVM* vm, uint8_t reg, uint8_t argc) {
+    // Some arguments are lambdas whose captures use the registers of this frame directly. Only a borrowing native can
+    // receive them as they are; any other callee may keep them, so their upvalues are moved to the heap first.
+    RisaValue* callee = &vm->frames[vm->frameCount - 1].regs[reg];
+
+    if(risa_value_is_dense_of_type(*callee, RISA_DVAL_NATIVE) && RISA_AS_NATIVE(*callee)->borrowing)
+        return;
+
+    for(uint8_t i = 1; i <= argc; ++i) {
+        if(!risa_value_is_dense_of_type(callee[i], RISA_DVAL_CLOSURE))
+            continue;
+
+        RisaDenseClosure* closure = RISA_AS_CLOSURE(callee[i]);
+
+        for(uint8_t j = 0; j < closure->upvalueCount; ++j) {
+            if(risa_dense_closure_is_direct(closure, j)) {
+                RISA_GC_BARRIER(vm, (RisaDenseValue*) closure);
+                closure->upvalues[j] = risa_vm_upvalue_capture(vm, closure->cells[j].ref);
+            }
+        }
+    }
+}
+
+static bool risa_vm_call_tail(RisaVM* vm, uint8_t reg, uint8_t argc) {
+    RisaCallFrame* frame = &vm->frames[vm->frameCount - 1];
+    RisaValue* callee = &frame->regs[reg];
+    RisaDenseFunction* function;
+
+    if(risa_value_is_dense_of_type(*callee, RISA_DVAL_FUNCTION))
+        function = RISA_AS_FUNCTION(*callee);
+    else if(risa_value_is_dense_of_type(*callee, RISA_DVAL_CLOSURE))
+        function = RISA_AS_CLOSURE(*callee)->function;
+    else return risa_vm_call_value(vm, callee, *callee, argc, false); // Reports the error.
+
+    // Check before the frame is dropped, so the error points to the call.
+    if(argc != function->arity) {
+        VM_RUNTIME_ERROR(vm, "Expected %x args, got %x", function->arity, argc);
+        return false;
+    }
+
+    risa_vm_upvalue_close_from(vm, frame->regs);
+
+    // Move the callee and its args to the base of the frame, as if the caller had called the callee directly.
+    RisaValue* base = frame->base;
+    bool isolated = frame->isolated;
+
+    for(uint16_t i = 0; i <= argc; ++i)
+        base[i] = callee[i];
+
+    --vm->frameCount;
+
+    return risa_vm_call_value(vm, base, *base, argc, isolated);
+}
+
 static bool risa_vm_call_value(RisaVM* vm, RisaValue* base, RisaValue callee, uint8_t argc, bool isolated) {
     if(value_is_dense(callee)) {
         switch(risa_value_as_dense(callee)->type) {
@@ -1406,15 +1973,12 @@ static bool risa_vm_call_function(RisaVM* vm, RisaValue* base, RisaValue callee,
         return false;
     }
 
-    if(vm->frameCount == RISA_VM_CALLFRAME_COUNT) {
-        VM_RUNTIME_ERROR(vm, "Stack overflow");
+    if(!risa_vm_call_reserve(vm, &base, function))
         return false;
-    }
 
     ++vm->frameCount;
 
     vm->frames[vm->frameCount - 1] = risa_vm_frame_from_function(vm, base, function, isolated);
-    vm->stackTop += 251;
 
     return true;
 }
@@ -1428,15 +1992,12 @@ static bool risa_vm_call_closure(RisaVM* vm, RisaValue* base, RisaValue callee,
         return false;
     }
 
-    if(vm->frameCount == RISA_VM_CALLFRAME_COUNT) {
-        VM_RUNTIME_ERROR(vm, "Stack overflow");
+    if(!risa_vm_call_reserve(vm, &base, function))
         return false;
-    }
 
     ++vm->frameCount;
 
     vm->frames[vm->frameCount - 1] = risa_vm_frame_from_closure(vm, base, closure, isolated);
-    vm->stackTop += 251;
 
     return true;
 }
@@ -1444,7 +2005,30 @@ static bool risa_vm_call_closure(RisaVM* vm, RisaValue* base, RisaValue callee,
 static bool risa_vm_call_native(RisaVM* vm, RisaValue* base, RisaValue callee, uint8_t argc, bool isolated) {
     RisaDenseNative* native = RISA_AS_NATIVE(callee);
 
-    *base = native->function(vm, argc, base + 1);
+    size_t offset = base - vm->stack;
+    RisaValue result = native->function(vm, argc, base + 1);
+
+    vm->stack[offset] = result;
+
+    // Natives allocate without checking the heap.
+    if(!risa_gc_check(vm)) {
+        VM_RUNTIME_ERROR(vm, "Heap limit exceeded (%zu bytes)", vm->heapLimit);
+        return false;
+    }
+
+    return true;
+}
+
+// Makes room for one more frame, and for the registers of the function. 'base' is moved along with the stack.
+static bool risa_vm_call_reserve(RisaVM* vm, RisaValue** base, RisaDenseFunction* function) {
+    size_t offset = *base - vm->stack;
+
+    if(!risa_vm_frames_ensure(vm, vm->frameCount + 1) || !risa_vm_stack_ensure(vm, offset + 1 + function->cluster.registerCount)) {
+        VM_RUNTIME_ERROR(vm, "Stack overflow");
+        return false;
+    }
+
+    *base = vm->stack + offset;
 
     return true;
 }
@@ -1461,7 +2045,7 @@ static RisaDenseUpvalue* risa_vm_upvalue_capture(RisaVM* vm, RisaValue* local) {
     if(upvalue != NULL && upvalue->ref == local)
         return upvalue;
 
-    RisaDenseUpvalue* created = risa_dense_upvalue_create(local);
+    RisaDenseUpvalue* created = risa_vm_upvalue_create(vm, local);
     created->next = upvalue;
 
     if(prev == NULL)
@@ -1476,6 +2060,8 @@ static RisaDenseUpvalue* risa_vm_upvalue_capture(RisaVM* vm, RisaValue* local) {
 static void risa_vm_upvalue_close_from(RisaVM* vm, RisaValue* slot) {
     while(vm->upvalues != NULL && vm->upvalues->ref >= slot) {
         RisaDenseUpvalue* head = vm->upvalues;
+
+        RISA_GC_BARRIER(vm, (RisaDenseValue*) head);
         head->closed = *head->ref;
         head->ref = &head->closed;
         vm->upvalues = head->next;
@@ -6,9 +6,12 @@
 #include "../cluster/cluster.h"
 #include "../def/def.h"
 #include "../data/map.h"
+#include "../mem/slab.h"
 #include "../value/dense.h"
 #include "../options/options.h"
 
+#include <time.h>
+
 // This is also used in 'mem/gc.c'
 #define VM_FRAME_FUNCTION(frame) ((frame).type == RISA_FRAME_FUNCTION ? (frame).callee.function : (frame).callee.closure->function)
 
@@ -33,26 +36,114 @@ typedef struct {
     bool isolated;
 } RisaCallFrame;
 
+typedef struct {
+    RisaDenseString* name;
+    RisaValue value;
+} RisaGlobal;
+
+// A value whose children still have to be marked by the GC. Large arrays are marked in chunks, starting at 'start'.
+typedef struct {
+    RisaDenseValue* dense;
+    uint32_t start;
+} RisaGreyValue;
+
+// How the heap threshold grows after a full collection. See RISA_GC_GROWTH_FACTOR in 'def/def.h'.
+typedef struct {
+    double growthFactor;  // The threshold is the size of the live values times this factor.
+    size_t minThreshold;
+    size_t maxThreshold;  // 0 means no maximum.
+    uint32_t cpuTarget;   // The share of time spent collecting (a percentage) to adjust the growth factor for, or 0.
+} RisaGCPacing;
+
+#ifdef RISA_VM_JIT
+    // Machine code for a hot function. Every instruction has an entry, so the interpreter can switch to the code
+    // anywhere. The code handles the common cases itself, and runs everything else one instruction at a time
+    // through the interpreter.
+    typedef struct RisaJitCode {
+        RisaDenseFunction* function;
+
+        uint8_t* memory;
+        size_t size;
+
+        void** entries;  // One for every instruction.
+        void* exits[3];  // One for every RisaJitExit, except RISA_JIT_EXIT_NONE.
+    } RisaJitCode;
+
+    typedef enum {
+        RISA_JIT_EXIT_RESUME, // The frame changed; the interpreter continues at its instruction.
+        RISA_JIT_EXIT_HALT,   // An isolated frame returned.
+        RISA_JIT_EXIT_ERROR,
+        RISA_JIT_EXIT_NONE    // The code was not entered.
+    } RisaJitExit;
+#endif
+
 typedef struct {
     RisaIO io;
-    RisaCallFrame frames[RISA_VM_CALLFRAME_COUNT];
+    RisaCallFrame* frames;
     uint32_t frameCount;
+    uint32_t frameCapacity;
+    uint32_t frameLimit;
 
-    RisaValue  stack[RISA_VM_STACK_SIZE];
+    // The stack can be reallocated when a call needs more registers, so pointers into it
+    // must not be kept across calls. Use offsets from 'stack' instead.
+    RisaValue* stack;
     RisaValue* stackTop;
+    uint32_t stackCapacity;
+    uint32_t stackLimit;
 
     RisaMap strings;
-    RisaMap globals;
+    RisaMap globalSlots; // Maps the name of every global to its index in 'globals'.
+
+    // Globals are never removed, so their slots are stable and can be cached in the bytecode.
+    RisaGlobal* globals;
+    uint32_t globalCount;
+    uint32_t globalCapacity;
+
+    RisaShape* shapes; // The root of the shape tree shared by the objects created in this VM.
+
+    RisaSlabAllocator slabs; // Holds the small values created by the VM, with RISA_VM_SLABS.
 
     RisaDenseValue* values;
+    RisaDenseValue* sweeping; // With RISA_GC_LAZY_SWEEP, the values left to sweep after a collection.
     RisaDenseUpvalue* upvalues;
 
+    // Only used by the generational GC (RISA_GC_GENERATIONAL). New values go to 'young' instead of 'values', and the
+    // old values that may point to young ones are kept in the remembered set. The incremental GC (RISA_GC_INCREMENTAL)
+    // keeps the marked values that were written to in the remembered set, and marks their children again at the end.
+    RisaDenseValue* young;
+    RisaDenseValue** remembered;
+    uint32_t rememberedCount;
+    uint32_t rememberedCapacity;
+
+    // The marked values whose children may still be unmarked. The stack doesn't grow past RISA_GC_MARK_STACK_SIZE, and
+    // 'greyOverflow' is set if it had to. While 'gcMarking' is set, an incremental collection (RISA_GC_INCREMENTAL) is
+    // in progress.
+    RisaGreyValue* grey;
+    uint32_t greyCount;
+    uint32_t greyCapacity;
+    bool greyOverflow;
+    bool gcMarking;
+    uint32_t gcPauseTarget; // The maximum time of a marking step, in microseconds.
+
+    // The heap threshold is set by the pacing once the values that survived a full collection are known. 'gcGrowth' is
+    // the growth factor it used last, which the CPU target adjusts. 'gcTime' is the time spent collecting since then.
+    RisaGCPacing gcPacing;
+    double gcGrowth;
+    clock_t gcTime;
+    clock_t gcCycleStart;
+    bool gcPacePending; // Set when a collection ends while it's being timed; the pacing runs once the time is counted.
+
+    struct RisaGCPool* gcPool; // The worker threads of the parallel GC (RISA_GC_PARALLEL), started by the first collection.
+
     RisaOptions options;
 
     RisaValue acc; // The accumulator, used in REPL mode to store the lastReg value.
 
-    size_t heapSize;
-    size_t heapThreshold;
+    size_t heapSize;      // Includes 'youngSize'.
+    size_t heapThreshold; // The size of the old generation that triggers a full collection.
+    size_t heapLimit;     // The heap size over which allocating is a runtime error, or 0 for no limit.
+    size_t youngSize;
+    size_t gcStepThreshold; // The heap size that triggers the next incremental step.
 } RisaVM;
 
 typedef enum {
@@ -71,6 +162,11 @@ RISA_API RisaMap*         risa_vm_get_strings              (RisaVM* vm);
 RISA_API RisaIO*          risa_vm_get_io                   (RisaVM* vm);
 RISA_API RisaValue        risa_vm_get_acc                  (RisaVM* vm);
 RISA_API void             risa_vm_set_repl_mode            (RisaVM* vm, bool mode);
+RISA_API void             risa_vm_set_limits               (RisaVM* vm, uint32_t frameLimit, uint32_t stackLimit); // Call this before loading a function.
+RISA_API void             risa_vm_set_heap_limit           (RisaVM* vm, size_t heapLimit); // 0 means no limit.
+RISA_API void             risa_vm_set_gc_pause_target      (RisaVM* vm, uint32_t pauseTarget); // In microseconds, with RISA_GC_INCREMENTAL.
+RISA_API void             risa_vm_set_gc_pacing            (RisaVM* vm, RisaGCPacing pacing);
+RISA_API RisaGCPacing     risa_vm_get_gc_pacing            (RisaVM* vm);
 RISA_API void             risa_vm_delete                   (RisaVM* vm);
 RISA_API void             risa_vm_free                     (RisaVM* vm);
 
@@ -88,13 +184,34 @@ RISA_API void             risa_vm_register_dense_unchecked (RisaVM* vm, RisaDens
 RISA_API RisaCallFrame    risa_vm_frame_from_function      (RisaVM* vm, RisaValue* base, RisaDenseFunction* function, bool isolated);
 RISA_API RisaCallFrame    risa_vm_frame_from_closure       (RisaVM* vm, RisaValue* base, RisaDenseClosure* closure, bool isolated);
 
+RISA_API void*            risa_vm_dense_alloc              (RisaVM* vm, uint32_t size); // Sets the size class of the value.
+RISA_API void             risa_vm_dense_free               (RisaVM* vm, RisaDenseValue* dense);
+RISA_API RisaDenseArray*  risa_vm_array_create             (RisaVM* vm);
+RISA_API RisaDenseObject* risa_vm_object_create            (RisaVM* vm);
+RISA_API RisaDenseClosure* risa_vm_closure_create         (RisaVM* vm, RisaDenseFunction* function, uint8_t upvalueCount);
+RISA_API RisaDenseUpvalue* risa_vm_upvalue_create         (RisaVM* vm, RisaValue* value);
+
 RISA_API RisaDenseString* risa_vm_string_create            (RisaVM* vm, const char* str, uint32_t length);
+RISA_API RisaDenseString* risa_vm_string_concat            (RisaVM* vm, RisaDenseString* left, RisaDenseString* right);
 RISA_API RisaDenseString* risa_vm_string_internalize       (RisaVM* vm, RisaDenseString* str);
 
+RISA_API bool             risa_vm_global_slot              (RisaVM* vm, RisaDenseString* name, uint32_t* slot);
+RISA_API bool             risa_vm_global_get               (RisaVM* vm, RisaDenseString* name, RisaValue* value);
+RISA_API uint32_t         risa_vm_global_define            (RisaVM* vm, RisaDenseString* name, RisaValue value);
 RISA_API void             risa_vm_global_set               (RisaVM* vm, const char* str, uint32_t length, RisaValue value);
 RISA_API void             risa_vm_global_set_native        (RisaVM* vm, const char* str, uint32_t length, RisaNativeFunction fn);
+// For natives that never keep their arguments, to which lambdas can be passed without moving their upvalues to the heap.
+RISA_API void             risa_vm_global_set_borrowing_native(RisaVM* vm, const char* str, uint32_t length, RisaNativeFunction fn);
+
+#ifdef RISA_VM_JIT
+    RISA_API RisaJitCode* risa_vm_jit_compile              (RisaDenseFunction* function); // NULL if the function can't be compiled.
+    RISA_API RisaJitExit  risa_vm_jit_enter                (RisaVM* vm, RisaJitCode* code, RisaCallFrame* frame);
+    RISA_API void         risa_vm_jit_free                 (RisaJitCode* code);
+#endif
 
 RISA_API void             risa_vm_stack_reset              (RisaVM* vm);
+RISA_API bool             risa_vm_stack_ensure             (RisaVM* vm, size_t size); // False if 'size' values exceed the limit.
+RISA_API bool             risa_vm_frames_ensure            (RisaVM* vm, uint32_t count);
 RISA_API void             risa_vm_stack_push               (RisaVM* vm, RisaValue value);
 RISA_API RisaValue        risa_vm_stack_pop                (RisaVM* vm);
 RISA_API RisaValue        risa_vm_stack_peek               (RisaVM* vm, size_t range);
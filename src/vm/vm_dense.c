@@ -0,0 +1,68 @@
+#include "vm.h"
+#include "../mem/mem.h"
+
+void* risa_vm_dense_alloc(RisaVM* vm, uint32_t size) {
+    RisaDenseValue* dense;
+
+    #ifdef RISA_VM_SLABS
+        uint8_t sizeClass = risa_slab_class(size);
+
+        if(sizeClass != 0)
+            dense = (RisaDenseValue*) risa_slab_alloc(&vm->slabs, sizeClass);
+        else dense = (RisaDenseValue*) RISA_MEM_ALLOC(size);
+
+        dense->slab = sizeClass;
+    #else
+        (void) vm;
+
+        dense = (RisaDenseValue*) RISA_MEM_ALLOC(size);
+        dense->slab = 0;
+    #endif
+
+    return dense;
+}
+
+void risa_vm_dense_free(RisaVM* vm, RisaDenseValue* dense) {
+    // Deleting the contents resets the value, but not its size class.
+    uint8_t sizeClass = dense->slab;
+
+    if(sizeClass == 0) {
+        risa_dense_delete(dense);
+        return;
+    }
+
+    risa_dense_delete_contents(dense);
+    risa_slab_free(&vm->slabs, dense, sizeClass);
+}
+
+RisaDenseArray* risa_vm_array_create(RisaVM* vm) {
+    RisaDenseArray* array = (RisaDenseArray*) risa_vm_dense_alloc(vm, sizeof(RisaDenseArray));
+
+    risa_dense_array_init(array);
+    return array;
+}
+
+RisaDenseObject* risa_vm_object_create(RisaVM* vm) {
+    RisaDenseObject* object = (RisaDenseObject*) risa_vm_dense_alloc(vm, sizeof(RisaDenseObject));
+
+    risa_dense_object_init(object);
+
+    risa_shape_retain(vm->shapes);
+    object->shape = vm->shapes;
+
+    return object;
+}
+
+RisaDenseClosure* risa_vm_closure_create(RisaVM* vm, RisaDenseFunction* function, uint8_t upvalueCount) {
+    RisaDenseClosure* closure = (RisaDenseClosure*) risa_vm_dense_alloc(vm, sizeof(RisaDenseClosure));
+
+    risa_dense_closure_init(closure, function, upvalueCount);
+    return closure;
+}
+
+RisaDenseUpvalue* risa_vm_upvalue_create(RisaVM* vm, RisaValue* value) {
+    RisaDenseUpvalue* upvalue = (RisaDenseUpvalue*) risa_vm_dense_alloc(vm, sizeof(RisaDenseUpvalue));
+
+    risa_dense_upvalue_init(upvalue, value);
+    return upvalue;
+}
@@ -1,11 +1,17 @@
 #include "vm.h"
 
-static void vm_frame_base(RisaVM* vm, RisaCallFrame* frame, RisaValue* base) {
+static void vm_frame_base(RisaVM* vm, RisaCallFrame* frame, RisaValue* base, RisaDenseFunction* function) {
     if(base == NULL)
         frame->base = vm->stackTop++;
     else frame->base = base;
 
     frame->regs = frame->base + 1;
+
+    // The frame may start inside the registers of the caller, so the stack only grows if the new registers go past it.
+    RisaValue* top = frame->regs + function->cluster.registerCount;
+
+    if(top > vm->stackTop)
+        vm->stackTop = top;
 }
 
 RisaCallFrame risa_vm_frame_from_function(RisaVM* vm, RisaValue* base, RisaDenseFunction* function, bool isolated) {
@@ -16,7 +22,7 @@ RisaCallFrame risa_vm_frame_from_function(RisaVM* vm, RisaValue* base, RisaDense
     frame.ip = frame.callee.function->cluster.bytecode;
     frame.isolated = isolated;
 
-    vm_frame_base(vm, &frame, base);
+    vm_frame_base(vm, &frame, base, function);
 
     return frame;
 }
@@ -29,7 +35,7 @@ RisaCallFrame risa_vm_frame_from_closure(RisaVM* vm, RisaValue* base, RisaDenseC
     frame.ip = closure->function->cluster.bytecode;
     frame.isolated = isolated;
 
-    vm_frame_base(vm, &frame, base);
+    vm_frame_base(vm, &frame, base, closure->function);
 
     return frame;
 }
\ No newline at end of file
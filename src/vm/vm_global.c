@@ -1,12 +1,60 @@
 #include "vm.h"
 
+bool risa_vm_global_slot(RisaVM* vm, RisaDenseString* name, uint32_t* slot) {
+    RisaValue index;
+
+    if(!risa_map_get(&vm->globalSlots, name, &index))
+        return false;
+
+    *slot = (uint32_t) risa_value_as_int(index);
+    return true;
+}
+
+bool risa_vm_global_get(RisaVM* vm, RisaDenseString* name, RisaValue* value) {
+    uint32_t slot;
+
+    if(!risa_vm_global_slot(vm, name, &slot))
+        return false;
+
+    *value = vm->globals[slot].value;
+    return true;
+}
+
+uint32_t risa_vm_global_define(RisaVM* vm, RisaDenseString* name, RisaValue value) {
+    uint32_t slot;
+
+    if(risa_vm_global_slot(vm, name, &slot)) {
+        vm->globals[slot].value = value;
+        return slot;
+    }
+
+    while(vm->globalCapacity <= vm->globalCount)
+        vm->globals = (RisaGlobal*) RISA_MEM_EXPAND(vm->globals, &vm->globalCapacity, sizeof(RisaGlobal));
+
+    slot = vm->globalCount++;
+
+    vm->globals[slot].name = name;
+    vm->globals[slot].value = value;
+
+    risa_map_set(&vm->globalSlots, name, risa_value_from_int(slot));
+
+    return slot;
+}
+
 void risa_vm_global_set(RisaVM* vm, const char* str, uint32_t length, RisaValue value) {
-    risa_map_set(&vm->globals, risa_vm_string_create(vm, str, length), value);
+    risa_vm_global_define(vm, risa_vm_string_create(vm, str, length), value);
 
-    if(value.type == RISA_VAL_DENSE)
+    if(value_is_dense(value))
         risa_vm_register_dense(vm, risa_value_as_dense(value));
 }
 
 void risa_vm_global_set_native(RisaVM* vm, const char* str, uint32_t length, RisaNativeFunction fn) {
     risa_vm_global_set(vm, str, length, risa_dense_native_value(fn));
+}
+
+void risa_vm_global_set_borrowing_native(RisaVM* vm, const char* str, uint32_t length, RisaNativeFunction fn) {
+    RisaDenseNative* native = risa_dense_native_create(fn);
+    native->borrowing = true;
+
+    risa_vm_global_set(vm, str, length, risa_value_from_dense((RisaDenseValue*) native));
 }
\ No newline at end of file
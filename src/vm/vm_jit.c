@@ -0,0 +1,594 @@
+#include "vm.h"
+
+#ifdef RISA_VM_JIT
+
+#include "../cluster/bytecode.h"
+#include "../data/buffer.h"
+#include "../mem/mem.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// The machine code keeps the registers of the frame in RBX and the VM in R12. RAX and RCX hold the operands.
+#define RISA_JIT_RAX 0
+#define RISA_JIT_RCX 1
+
+#define RISA_JIT_TYPE(reg)  ((uint32_t) ((reg) * sizeof(RisaValue) + offsetof(RisaValue, type)))
+#define RISA_JIT_VALUE(reg) ((uint32_t) ((reg) * sizeof(RisaValue) + offsetof(RisaValue, as)))
+
+#define RISA_JIT_GLOBAL(slot, field) ((uint32_t) ((slot) * sizeof(RisaGlobal) + offsetof(RisaGlobal, field)))
+
+#define RISA_JIT_MAX_GUARDS 4
+
+typedef uint32_t (*RisaJitEntry)(RisaVM* vm, RisaValue* regs, void* target);
+
+typedef struct {
+    RisaJitCode* code;
+    RisaBuffer output;
+    RisaBuffer patches; // Pairs of the offset of a rel32 and the instruction it jumps to.
+    uint32_t* labels;   // The offset of every instruction in the output.
+
+    uint32_t guards[RISA_JIT_MAX_GUARDS]; // The type checks of the current instruction, which jump to its slow path.
+    uint8_t guardCount;
+} RisaJitEmitter;
+
+static void  risa_vm_jit_emit_instruction (RisaJitEmitter* emitter, uint32_t index);
+static void  risa_vm_jit_emit_step        (RisaJitEmitter* emitter, uint32_t index);
+static void  risa_vm_jit_emit_exit        (RisaJitEmitter* emitter, RisaJitExit exit);
+static void  risa_vm_jit_emit_set         (RisaJitEmitter* emitter, uint8_t reg, RisaValue value);
+static bool  risa_vm_jit_emit_load        (RisaJitEmitter* emitter, uint8_t operand, bool constant, uint8_t target, RisaValueType type);
+static void  risa_vm_jit_emit_result      (RisaJitEmitter* emitter, uint8_t reg, RisaValueType type);
+static void  risa_vm_jit_emit_global      (RisaJitEmitter* emitter, uint8_t slot, RisaValue name);
+static void  risa_vm_jit_emit_guard       (RisaJitEmitter* emitter, uint8_t reg, RisaValueType type);
+static void  risa_vm_jit_emit_slow        (RisaJitEmitter* emitter, const char* opcode, uint8_t length);
+static void  risa_vm_jit_emit_memory      (RisaJitEmitter* emitter, const char* opcode, uint8_t length, uint8_t modrm, uint32_t displacement);
+static void  risa_vm_jit_emit_jump        (RisaJitEmitter* emitter, const char* opcode, uint8_t length, uint32_t target);
+static void  risa_vm_jit_emit             (RisaJitEmitter* emitter, const char* bytes, uint8_t length);
+static void  risa_vm_jit_emit_uint64      (RisaJitEmitter* emitter, uint64_t value);
+static void* risa_vm_jit_step             (RisaVM* vm, RisaJitCode* code, uint32_t offset, RisaValue** regs);
+
+RisaJitCode* risa_vm_jit_compile(RisaDenseFunction* function) {
+    RisaCluster* cluster = &function->cluster;
+    uint32_t count = cluster->size / RISA_TODLR_INSTRUCTION_SIZE;
+
+    // The machine code is written for 16-byte values, with the type and the payload in separate words.
+    if(count == 0 || sizeof(RisaValue) != 16)
+        return NULL;
+
+    RisaJitCode* code = (RisaJitCode*) RISA_MEM_ALLOC(sizeof(RisaJitCode));
+
+    code->function = function;
+    code->entries = (void**) RISA_MEM_ALLOC(count * sizeof(void*));
+
+    RisaJitEmitter emitter;
+
+    emitter.code = code;
+    emitter.labels = (uint32_t*) RISA_MEM_ALLOC((count + 1) * sizeof(uint32_t));
+    emitter.guardCount = 0;
+
+    risa_buffer_init(&emitter.output);
+    risa_buffer_init(&emitter.patches);
+
+    // push rbp; push rbx; push r12; sub rsp, 16; mov r12, rdi; mov rbx, rsi; jmp rdx
+    // The stack stays aligned to 16 bytes for the calls, and [rsp] receives the registers from 'step'.
+    risa_vm_jit_emit(&emitter, "\x55\x53\x41\x54\x48\x83\xEC\x10\x49\x89\xFC\x48\x89\xF3\xFF\xE2", 16);
+
+    uint32_t exits[3];
+
+    for(uint8_t i = 0; i < 3; ++i) {
+        exits[i] = emitter.output.size;
+        risa_vm_jit_emit_exit(&emitter, (RisaJitExit) i);
+    }
+
+    for(uint32_t i = 0; i < count; ++i) {
+        emitter.labels[i] = emitter.output.size;
+        risa_vm_jit_emit_instruction(&emitter, i);
+    }
+
+    // Nothing can run past the last instruction; ud2.
+    emitter.labels[count] = emitter.output.size;
+    risa_vm_jit_emit(&emitter, "\x0F\x0B", 2);
+
+    for(uint32_t i = 0; i + 2 * sizeof(uint32_t) <= emitter.patches.size; i += 2 * sizeof(uint32_t)) {
+        uint32_t at;
+        uint32_t target;
+
+        memcpy(&at, emitter.patches.data + i, sizeof(uint32_t));
+        memcpy(&target, emitter.patches.data + i + sizeof(uint32_t), sizeof(uint32_t));
+
+        risa_buffer_write_uint32_at(&emitter.output, emitter.labels[target] - (at + sizeof(uint32_t)), at);
+    }
+
+    code->size = emitter.output.size;
+    code->memory = mmap(NULL, code->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(code->memory != MAP_FAILED) {
+        memcpy(code->memory, emitter.output.data, code->size);
+
+        if(mprotect(code->memory, code->size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(code->memory, code->size);
+            code->memory = MAP_FAILED;
+        }
+    }
+
+    if(code->memory == MAP_FAILED) {
+        RISA_MEM_FREE(code->entries);
+        RISA_MEM_FREE(code);
+
+        code = NULL;
+    } else {
+        for(uint32_t i = 0; i < count; ++i)
+            code->entries[i] = code->memory + emitter.labels[i];
+
+        for(uint8_t i = 0; i < 3; ++i)
+            code->exits[i] = code->memory + exits[i];
+    }
+
+    RISA_MEM_FREE(emitter.labels);
+    risa_buffer_delete(&emitter.output);
+    risa_buffer_delete(&emitter.patches);
+
+    return code;
+}
+
+RisaJitExit risa_vm_jit_enter(RisaVM* vm, RisaJitCode* code, RisaCallFrame* frame) {
+    uint32_t offset = (uint32_t) (frame->ip - code->function->cluster.bytecode);
+
+    if(offset % RISA_TODLR_INSTRUCTION_SIZE != 0 || offset >= code->function->cluster.size)
+        return RISA_JIT_EXIT_NONE;
+
+    RisaJitEntry entry = (RisaJitEntry) (void*) code->memory;
+
+    return (RisaJitExit) entry(vm, frame->regs, code->entries[offset / RISA_TODLR_INSTRUCTION_SIZE]);
+}
+
+void risa_vm_jit_free(RisaJitCode* code) {
+    if(code == NULL)
+        return;
+
+    munmap(code->memory, code->size);
+
+    RISA_MEM_FREE(code->entries);
+    RISA_MEM_FREE(code);
+}
+
+static void risa_vm_jit_emit_instruction(RisaJitEmitter* emitter, uint32_t index) {
+    RisaCluster* cluster = &emitter->code->function->cluster;
+    uint32_t count = cluster->size / RISA_TODLR_INSTRUCTION_SIZE;
+
+    uint8_t* instruction = &cluster->bytecode[index * RISA_TODLR_INSTRUCTION_SIZE];
+    uint8_t types = instruction[0] & RISA_TODLR_TYPE_MASK;
+    uint8_t raw = instruction[0] & RISA_TODLR_INSTRUCTION_MASK;
+    uint8_t op = risa_op_dequicken(raw);
+
+    uint8_t dest = instruction[1];
+    uint8_t left = instruction[2];
+    uint8_t right = instruction[3];
+
+    uint32_t start = emitter->output.size;
+    uint32_t patches = emitter->patches.size;
+    bool handled = true;
+
+    emitter->guardCount = 0;
+
+    // Registers are checked, so malformed bytecode (e.g. from inline asm) is left to the interpreter.
+    if(dest >= RISA_TODLR_REGISTER_COUNT && op != RISA_OP_JMP && op != RISA_OP_JMPW && op != RISA_OP_BJMP && op != RISA_OP_BJMPW)
+        op = RISA_OP_DIS;
+
+    switch(op) {
+        case RISA_OP_CNST:
+        case RISA_OP_CNSTW: {
+            uint16_t constant = op == RISA_OP_CNST ? left : risa_op_read_word(instruction + 2);
+
+            if(constant < cluster->constants.size)
+                risa_vm_jit_emit_set(emitter, dest, cluster->constants.values[constant]);
+            else handled = false;
+
+            break;
+        }
+        case RISA_OP_MOV:
+            if(left >= RISA_TODLR_REGISTER_COUNT) {
+                handled = false;
+                break;
+            }
+
+            // mov rax, [rbx + left]; mov rcx, [rbx + left + 8]; mov [rbx + dest], rax; mov [rbx + dest + 8], rcx
+            risa_vm_jit_emit_memory(emitter, "\x48\x8B", 2, 0x83, (uint32_t) (left * sizeof(RisaValue)));
+            risa_vm_jit_emit_memory(emitter, "\x48\x8B", 2, 0x8B, (uint32_t) (left * sizeof(RisaValue) + 8));
+            risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x83, (uint32_t) (dest * sizeof(RisaValue)));
+            risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x8B, (uint32_t) (dest * sizeof(RisaValue) + 8));
+            break;
+        case RISA_OP_NULL:
+            risa_vm_jit_emit_set(emitter, dest, risa_value_from_null());
+            break;
+        case RISA_OP_TRUE:
+            risa_vm_jit_emit_set(emitter, dest, risa_value_from_bool(true));
+            break;
+        case RISA_OP_FALSE:
+            risa_vm_jit_emit_set(emitter, dest, risa_value_from_bool(false));
+            break;
+        case RISA_OP_GGLOB:
+            if(raw != RISA_OP_GGLOB_SLOT || left >= cluster->constants.size) {
+                handled = false;
+                break;
+            }
+
+            risa_vm_jit_emit_global(emitter, right, cluster->constants.values[left]);
+
+            // mov rcx, [rax + value]; mov [rbx + dest], rcx; mov rcx, [rax + value + 8]; mov [rbx + dest + 8], rcx
+            risa_vm_jit_emit_memory(emitter, "\x48\x8B", 2, 0x88, RISA_JIT_GLOBAL(right, value));
+            risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x8B, (uint32_t) (dest * sizeof(RisaValue)));
+            risa_vm_jit_emit_memory(emitter, "\x48\x8B", 2, 0x88, RISA_JIT_GLOBAL(right, value) + 8);
+            risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x8B, (uint32_t) (dest * sizeof(RisaValue) + 8));
+            break;
+        case RISA_OP_SGLOB:
+            if(raw != RISA_OP_SGLOB_SLOT || dest >= cluster->constants.size || (types & RISA_TODLR_TYPE_LEFT_MASK ? left >= cluster->constants.size : left >= RISA_TODLR_REGISTER_COUNT)) {
+                handled = false;
+                break;
+            }
+
+            risa_vm_jit_emit_global(emitter, right, cluster->constants.values[dest]);
+
+            if(types & RISA_TODLR_TYPE_LEFT_MASK) {
+                RisaValue value = cluster->constants.values[left];
+                uint64_t payload;
+
+                memcpy(&payload, &value.as, sizeof(uint64_t));
+
+                // mov dword [rax + type], type; mov rcx, payload; mov [rax + value], rcx
+                risa_vm_jit_emit_memory(emitter, "\xC7", 1, 0x80, RISA_JIT_GLOBAL(right, value) + offsetof(RisaValue, type));
+                risa_buffer_write_uint32(&emitter->output, (uint32_t) value.type);
+
+                risa_vm_jit_emit(emitter, "\x48\xB9", 2);
+                risa_vm_jit_emit_uint64(emitter, payload);
+
+                risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x88, RISA_JIT_GLOBAL(right, value) + offsetof(RisaValue, as));
+            } else {
+                // mov rcx, [rbx + left]; mov [rax + value], rcx; mov rcx, [rbx + left + 8]; mov [rax + value + 8], rcx
+                risa_vm_jit_emit_memory(emitter, "\x48\x8B", 2, 0x8B, (uint32_t) (left * sizeof(RisaValue)));
+                risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x88, RISA_JIT_GLOBAL(right, value));
+                risa_vm_jit_emit_memory(emitter, "\x48\x8B", 2, 0x8B, (uint32_t) (left * sizeof(RisaValue) + 8));
+                risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x88, RISA_JIT_GLOBAL(right, value) + 8);
+            }
+            break;
+        case RISA_OP_NOT:
+            if(types & RISA_TODLR_TYPE_LEFT_MASK || left >= RISA_TODLR_REGISTER_COUNT) {
+                handled = false;
+                break;
+            }
+
+            // movzx eax, byte [rbx + left]; xor eax, 1
+            risa_vm_jit_emit_guard(emitter, left, RISA_VAL_BOOL);
+            risa_vm_jit_emit_memory(emitter, "\x0F\xB6", 2, 0x83, RISA_JIT_VALUE(left));
+            risa_vm_jit_emit(emitter, "\x83\xF0\x01", 3);
+            risa_vm_jit_emit_result(emitter, dest, RISA_VAL_BOOL);
+            break;
+        case RISA_OP_NEG:
+            if(!risa_vm_jit_emit_load(emitter, left, types & RISA_TODLR_TYPE_LEFT_MASK, RISA_JIT_RAX, RISA_VAL_INT)) {
+                handled = false;
+                break;
+            }
+
+            risa_vm_jit_emit(emitter, "\x48\xF7\xD8", 3); // neg rax
+            risa_vm_jit_emit_result(emitter, dest, RISA_VAL_INT);
+            break;
+        case RISA_OP_INC:
+        case RISA_OP_DEC:
+            // inc/dec qword [rbx + dest]
+            risa_vm_jit_emit_guard(emitter, dest, RISA_VAL_INT);
+            risa_vm_jit_emit_memory(emitter, "\x48\xFF", 2, op == RISA_OP_INC ? 0x83 : 0x8B, RISA_JIT_VALUE(dest));
+            break;
+        case RISA_OP_ADD:
+        case RISA_OP_SUB:
+        case RISA_OP_MUL:
+        case RISA_OP_DIV:
+        case RISA_OP_MOD:
+        case RISA_OP_LT:
+        case RISA_OP_LTE:
+        case RISA_OP_EQ:
+        case RISA_OP_NEQ:
+        case RISA_OP_BAND:
+        case RISA_OP_BXOR:
+        case RISA_OP_BOR: {
+            // The code is specialized for the operand types seen by the interpreter, which are known from the quickened
+            // instruction. Other types, including the ones that cause errors, go through the interpreter.
+            bool floating = (raw >= RISA_OP_ADD_FLOAT_FLOAT && raw <= RISA_OP_LTE_FLOAT_FLOAT) || op == RISA_OP_DIV;
+
+            if(!risa_vm_jit_emit_load(emitter, left, types & RISA_TODLR_TYPE_LEFT_MASK, RISA_JIT_RAX, floating ? RISA_VAL_FLOAT : RISA_VAL_INT)
+            || !risa_vm_jit_emit_load(emitter, right, types & RISA_TODLR_TYPE_RIGHT_MASK, RISA_JIT_RCX, floating ? RISA_VAL_FLOAT : RISA_VAL_INT)) {
+                handled = false;
+                break;
+            }
+
+            if(floating) {
+                switch(op) {
+                    case RISA_OP_ADD:
+                        risa_vm_jit_emit(emitter, "\xF2\x0F\x58\xC1", 4); // addsd xmm0, xmm1
+                        risa_vm_jit_emit_result(emitter, dest, RISA_VAL_FLOAT);
+                        break;
+                    case RISA_OP_SUB:
+                        risa_vm_jit_emit(emitter, "\xF2\x0F\x5C\xC1", 4); // subsd xmm0, xmm1
+                        risa_vm_jit_emit_result(emitter, dest, RISA_VAL_FLOAT);
+                        break;
+                    case RISA_OP_MUL:
+                        risa_vm_jit_emit(emitter, "\xF2\x0F\x59\xC1", 4); // mulsd xmm0, xmm1
+                        risa_vm_jit_emit_result(emitter, dest, RISA_VAL_FLOAT);
+                        break;
+                    case RISA_OP_DIV:
+                        risa_vm_jit_emit(emitter, "\xF2\x0F\x5E\xC1", 4); // divsd xmm0, xmm1
+                        risa_vm_jit_emit_result(emitter, dest, RISA_VAL_FLOAT);
+                        break;
+                    case RISA_OP_LT:
+                        // ucomisd xmm1, xmm0; seta al; movzx eax, al (false if either is NaN)
+                        risa_vm_jit_emit(emitter, "\x66\x0F\x2E\xC8\x0F\x97\xC0\x0F\xB6\xC0", 10);
+                        risa_vm_jit_emit_result(emitter, dest, RISA_VAL_BOOL);
+                        break;
+                    default:
+                        risa_vm_jit_emit(emitter, "\x66\x0F\x2E\xC8\x0F\x93\xC0\x0F\xB6\xC0", 10); // setae
+                        risa_vm_jit_emit_result(emitter, dest, RISA_VAL_BOOL);
+                        break;
+                }
+
+                break;
+            }
+
+            switch(op) {
+                case RISA_OP_ADD:
+                    risa_vm_jit_emit(emitter, "\x48\x01\xC8", 3);     // add rax, rcx
+                    break;
+                case RISA_OP_SUB:
+                    risa_vm_jit_emit(emitter, "\x48\x29\xC8", 3);     // sub rax, rcx
+                    break;
+                case RISA_OP_MUL:
+                    risa_vm_jit_emit(emitter, "\x48\x0F\xAF\xC1", 4); // imul rax, rcx
+                    break;
+                case RISA_OP_MOD:
+                    // test rcx, rcx; jz slow; cqo; idiv rcx; mov rax, rdx
+                    risa_vm_jit_emit(emitter, "\x48\x85\xC9", 3);
+                    risa_vm_jit_emit_slow(emitter, "\x0F\x84", 2);
+                    risa_vm_jit_emit(emitter, "\x48\x99\x48\xF7\xF9\x48\x89\xD0", 8);
+                    break;
+                case RISA_OP_BAND:
+                    risa_vm_jit_emit(emitter, "\x48\x21\xC8", 3);     // and rax, rcx
+                    break;
+                case RISA_OP_BXOR:
+                    risa_vm_jit_emit(emitter, "\x48\x31\xC8", 3);     // xor rax, rcx
+                    break;
+                case RISA_OP_BOR:
+                    risa_vm_jit_emit(emitter, "\x48\x09\xC8", 3);     // or rax, rcx
+                    break;
+                case RISA_OP_LT:
+                    risa_vm_jit_emit(emitter, "\x48\x39\xC8\x0F\x9C\xC0\x0F\xB6\xC0", 9); // cmp rax, rcx; setl al; movzx eax, al
+                    break;
+                case RISA_OP_LTE:
+                    risa_vm_jit_emit(emitter, "\x48\x39\xC8\x0F\x9E\xC0\x0F\xB6\xC0", 9); // setle
+                    break;
+                case RISA_OP_EQ:
+                    risa_vm_jit_emit(emitter, "\x48\x39\xC8\x0F\x94\xC0\x0F\xB6\xC0", 9); // sete
+                    break;
+                default:
+                    risa_vm_jit_emit(emitter, "\x48\x39\xC8\x0F\x95\xC0\x0F\xB6\xC0", 9); // setne
+                    break;
+            }
+
+            risa_vm_jit_emit_result(emitter, dest, op >= RISA_OP_LT && op <= RISA_OP_NEQ ? RISA_VAL_BOOL : RISA_VAL_INT);
+            break;
+        }
+        case RISA_OP_TEST:
+        case RISA_OP_NTEST:
+            if(index + 2 > count) {
+                handled = false;
+                break;
+            }
+
+            // cmp byte [rbx + dest], 0; then skip the next instruction if the bool matches.
+            risa_vm_jit_emit_guard(emitter, dest, RISA_VAL_BOOL);
+            risa_vm_jit_emit_memory(emitter, "\x80", 1, 0xBB, RISA_JIT_VALUE(dest));
+            risa_vm_jit_emit(emitter, "\x00", 1);
+            risa_vm_jit_emit_jump(emitter, op == RISA_OP_TEST ? "\x0F\x85" : "\x0F\x84", 2, index + 2);
+            break;
+        case RISA_OP_JMP:
+        case RISA_OP_JMPW:
+        case RISA_OP_BJMP:
+        case RISA_OP_BJMPW: {
+            uint32_t amount = (op == RISA_OP_JMP || op == RISA_OP_BJMP) ? dest : risa_op_read_word(instruction + 1);
+            uint32_t target = (op == RISA_OP_JMP || op == RISA_OP_JMPW) ? index + 1 + amount : (index >= amount ? index - amount : count);
+
+            if(target < count)
+                risa_vm_jit_emit_jump(emitter, "\xE9", 1, target);
+            else handled = false;
+
+            break;
+        }
+        default:
+            handled = false;
+            break;
+    }
+
+    if(!handled) {
+        emitter->output.size = start;
+        emitter->patches.size = patches;
+
+        risa_vm_jit_emit_step(emitter, index);
+        return;
+    }
+
+    if(emitter->guardCount > 0) {
+        risa_vm_jit_emit_jump(emitter, "\xE9", 1, index + 1);
+
+        for(uint8_t i = 0; i < emitter->guardCount; ++i)
+            risa_buffer_write_uint32_at(&emitter->output, emitter->output.size - (emitter->guards[i] + sizeof(uint32_t)), emitter->guards[i]);
+
+        risa_vm_jit_emit_step(emitter, index);
+    }
+}
+
+static void risa_vm_jit_emit_step(RisaJitEmitter* emitter, uint32_t index) {
+    // mov rdi, r12; mov rsi, code; mov edx, offset; mov rcx, rsp; mov rax, step; call rax; mov rbx, [rsp]; jmp rax
+    risa_vm_jit_emit(emitter, "\x4C\x89\xE7\x48\xBE", 5);
+    risa_vm_jit_emit_uint64(emitter, (uint64_t) (uintptr_t) emitter->code);
+
+    risa_vm_jit_emit(emitter, "\xBA", 1);
+    risa_buffer_write_uint32(&emitter->output, index * RISA_TODLR_INSTRUCTION_SIZE);
+
+    risa_vm_jit_emit(emitter, "\x48\x89\xE1\x48\xB8", 5);
+    risa_vm_jit_emit_uint64(emitter, (uint64_t) (uintptr_t) &risa_vm_jit_step);
+
+    risa_vm_jit_emit(emitter, "\xFF\xD0\x48\x8B\x1C\x24\xFF\xE0", 8);
+}
+
+static void risa_vm_jit_emit_exit(RisaJitEmitter* emitter, RisaJitExit exit) {
+    // mov eax, exit; add rsp, 16; pop r12; pop rbx; pop rbp; ret
+    risa_vm_jit_emit(emitter, "\xB8", 1);
+    risa_buffer_write_uint32(&emitter->output, (uint32_t) exit);
+    risa_vm_jit_emit(emitter, "\x48\x83\xC4\x10\x41\x5C\x5B\x5D\xC3", 9);
+}
+
+static void risa_vm_jit_emit_set(RisaJitEmitter* emitter, uint8_t reg, RisaValue value) {
+    uint64_t payload;
+    memcpy(&payload, &value.as, sizeof(uint64_t));
+
+    // mov dword [rbx + type], type; mov rax, payload; mov [rbx + value], rax
+    risa_vm_jit_emit_memory(emitter, "\xC7", 1, 0x83, RISA_JIT_TYPE(reg));
+    risa_buffer_write_uint32(&emitter->output, (uint32_t) value.type);
+
+    risa_vm_jit_emit(emitter, "\x48\xB8", 2);
+    risa_vm_jit_emit_uint64(emitter, payload);
+
+    risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x83, RISA_JIT_VALUE(reg));
+}
+
+static bool risa_vm_jit_emit_load(RisaJitEmitter* emitter, uint8_t operand, bool constant, uint8_t target, RisaValueType type) {
+    RisaCluster* cluster = &emitter->code->function->cluster;
+
+    // Ints are loaded into RAX/RCX, and floats into XMM0/XMM1.
+    if(constant) {
+        if(operand >= cluster->constants.size || cluster->constants.values[operand].type != type)
+            return false;
+
+        uint64_t payload;
+        memcpy(&payload, &cluster->constants.values[operand].as, sizeof(uint64_t));
+
+        // mov rax/rcx, constant
+        risa_vm_jit_emit(emitter, target == RISA_JIT_RAX ? "\x48\xB8" : "\x48\xB9", 2);
+        risa_vm_jit_emit_uint64(emitter, payload);
+
+        // movq xmm0, rax / movq xmm1, rcx
+        if(type == RISA_VAL_FLOAT)
+            risa_vm_jit_emit(emitter, target == RISA_JIT_RAX ? "\x66\x48\x0F\x6E\xC0" : "\x66\x48\x0F\x6E\xC9", 5);
+
+        return true;
+    }
+
+    if(operand >= RISA_TODLR_REGISTER_COUNT)
+        return false;
+
+    risa_vm_jit_emit_guard(emitter, operand, type);
+
+    // mov rax/rcx, [rbx + operand] or movsd xmm0/xmm1, [rbx + operand]
+    if(type == RISA_VAL_FLOAT)
+        risa_vm_jit_emit_memory(emitter, "\xF2\x0F\x10", 3, target == RISA_JIT_RAX ? 0x83 : 0x8B, RISA_JIT_VALUE(operand));
+    else risa_vm_jit_emit_memory(emitter, "\x48\x8B", 2, target == RISA_JIT_RAX ? 0x83 : 0x8B, RISA_JIT_VALUE(operand));
+
+    return true;
+}
+
+static void risa_vm_jit_emit_result(RisaJitEmitter* emitter, uint8_t reg, RisaValueType type) {
+    // mov [rbx + value], rax or movsd [rbx + value], xmm0; mov dword [rbx + type], type
+    if(type == RISA_VAL_FLOAT)
+        risa_vm_jit_emit_memory(emitter, "\xF2\x0F\x11", 3, 0x83, RISA_JIT_VALUE(reg));
+    else risa_vm_jit_emit_memory(emitter, "\x48\x89", 2, 0x83, RISA_JIT_VALUE(reg));
+
+    risa_vm_jit_emit_memory(emitter, "\xC7", 1, 0x83, RISA_JIT_TYPE(reg));
+    risa_buffer_write_uint32(&emitter->output, (uint32_t) type);
+}
+
+static void risa_vm_jit_emit_global(RisaJitEmitter* emitter, uint8_t slot, RisaValue name) {
+    // The same checks as GGLOB_SLOT and SGLOB_SLOT; the slot has to exist and belong to the same name.
+    // cmp dword [r12 + globalCount], slot; jbe slow
+    risa_vm_jit_emit(emitter, "\x41\x81\xBC\x24", 4);
+    risa_buffer_write_uint32(&emitter->output, (uint32_t) offsetof(RisaVM, globalCount));
+    risa_buffer_write_uint32(&emitter->output, slot);
+    risa_vm_jit_emit_slow(emitter, "\x0F\x86", 2);
+
+    // mov rax, [r12 + globals]
+    risa_vm_jit_emit(emitter, "\x49\x8B\x84\x24", 4);
+    risa_buffer_write_uint32(&emitter->output, (uint32_t) offsetof(RisaVM, globals));
+
+    // mov rcx, name; cmp [rax + name], rcx; jne slow
+    risa_vm_jit_emit(emitter, "\x48\xB9", 2);
+    risa_vm_jit_emit_uint64(emitter, (uint64_t) (uintptr_t) name.as.dense);
+
+    risa_vm_jit_emit_memory(emitter, "\x48\x39", 2, 0x88, RISA_JIT_GLOBAL(slot, name));
+    risa_vm_jit_emit_slow(emitter, "\x0F\x85", 2);
+}
+
+static void risa_vm_jit_emit_guard(RisaJitEmitter* emitter, uint8_t reg, RisaValueType type) {
+    // cmp dword [rbx + type], type; jne slow
+    risa_vm_jit_emit_memory(emitter, "\x81", 1, 0xBB, RISA_JIT_TYPE(reg));
+    risa_buffer_write_uint32(&emitter->output, (uint32_t) type);
+
+    risa_vm_jit_emit_slow(emitter, "\x0F\x85", 2);
+}
+
+static void risa_vm_jit_emit_slow(RisaJitEmitter* emitter, const char* opcode, uint8_t length) {
+    risa_vm_jit_emit(emitter, opcode, length);
+
+    emitter->guards[emitter->guardCount++] = emitter->output.size;
+    risa_buffer_write_uint32(&emitter->output, 0);
+}
+
+static void risa_vm_jit_emit_memory(RisaJitEmitter* emitter, const char* opcode, uint8_t length, uint8_t modrm, uint32_t displacement) {
+    // The ModRM byte selects [rbx + disp32].
+    risa_vm_jit_emit(emitter, opcode, length);
+    risa_buffer_write_uint8(&emitter->output, modrm);
+    risa_buffer_write_uint32(&emitter->output, displacement);
+}
+
+static void risa_vm_jit_emit_jump(RisaJitEmitter* emitter, const char* opcode, uint8_t length, uint32_t target) {
+    risa_vm_jit_emit(emitter, opcode, length);
+
+    risa_buffer_write_uint32(&emitter->patches, emitter->output.size);
+    risa_buffer_write_uint32(&emitter->patches, target);
+
+    risa_buffer_write_uint32(&emitter->output, 0);
+}
+
+static void risa_vm_jit_emit(RisaJitEmitter* emitter, const char* bytes, uint8_t length) {
+    risa_buffer_write(&emitter->output, (const uint8_t*) bytes, length);
+}
+
+static void risa_vm_jit_emit_uint64(RisaJitEmitter* emitter, uint64_t value) {
+    risa_buffer_write(&emitter->output, (uint8_t*) &value, sizeof(uint64_t));
+}
+
+// Runs one instruction in the interpreter, and returns where the machine code continues.
+static void* risa_vm_jit_step(RisaVM* vm, RisaJitCode* code, uint32_t offset, RisaValue** regs) {
+    RisaCluster* cluster = &code->function->cluster;
+    uint32_t frameCount = vm->frameCount;
+
+    vm->frames[frameCount - 1].ip = cluster->bytecode + offset;
+
+    switch(risa_vm_run(vm, 1)) {
+        case RISA_VM_STATUS_ERROR:
+            return code->exits[RISA_JIT_EXIT_ERROR];
+        case RISA_VM_STATUS_OK:
+            return code->exits[RISA_JIT_EXIT_HALT];
+        default:
+            break;
+    }
+
+    RisaCallFrame* frame = &vm->frames[vm->frameCount - 1];
+
+    // Calls, returns and tail calls go back to the interpreter, which switches to the code of the new frame.
+    if(vm->frameCount != frameCount || VM_FRAME_FUNCTION(*frame) != code->function || frame->ip >= cluster->bytecode + cluster->size)
+        return code->exits[RISA_JIT_EXIT_RESUME];
+
+    // The stack may have moved, e.g. if a native called a function.
+    *regs = frame->regs;
+
+    return code->entries[(frame->ip - cluster->bytecode) / RISA_TODLR_INSTRUCTION_SIZE];
+}
+
+#endif
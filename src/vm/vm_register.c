@@ -6,26 +6,27 @@ void risa_vm_register_string(RisaVM* vm, RisaDenseString* string) {
 }
 
 void risa_vm_register_dense(RisaVM* vm, RisaDenseValue* dense) {
-    if(dense == NULL)
+    if(dense == NULL || dense->registered)
         return;
 
-    RisaDenseValue* it = vm->values;
-
-    while(it != NULL) {
-        if(it == dense)
-            return;
-
-        it = it->link;
-    }
-
     risa_vm_register_dense_unchecked(vm, dense);
 }
 
 void risa_vm_register_dense_unchecked(RisaVM* vm, RisaDenseValue* dense) {
-    dense->link = vm->values;
-    vm->values = dense;
+    size_t size = risa_dense_size(dense);
+
+    dense->registered = true;
+
+    #ifdef RISA_GC_GENERATIONAL
+        dense->link = vm->young;
+        vm->young = dense;
+        vm->youngSize += size;
+    #else
+        dense->link = vm->values;
+        vm->values = dense;
+    #endif
 
-    vm->heapSize += risa_dense_size(dense);
+    vm->heapSize += size;
 
     switch(dense->type) {
         case RISA_DVAL_FUNCTION: {
@@ -40,14 +41,8 @@ void risa_vm_register_dense_unchecked(RisaVM* vm, RisaDenseValue* dense) {
             break;
         }
         case RISA_DVAL_CLOSURE: {
-            risa_vm_register_dense(vm, (RisaDenseValue *) ((RisaDenseClosure *) dense)->function->name);
-
-            RisaValueArray *constants = &((RisaDenseClosure *) dense)->function->cluster.constants;
-
-            for(size_t i = 0; i < constants->size; ++i)
-                if(value_is_dense(constants->values[i]))
-                    risa_vm_register_dense(vm, risa_value_as_dense(constants->values[i]));
-
+            // The function registers its own name and constants, only once.
+            risa_vm_register_dense(vm, (RisaDenseValue *) ((RisaDenseClosure *) dense)->function);
             break;
         }
         default:
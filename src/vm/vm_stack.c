@@ -1,8 +1,13 @@
 #include "vm.h"
 
+#include "../mem/mem.h"
+
 #include <stdio.h>
+
+static void risa_vm_stack_rebase_cells(RisaDenseClosure* closure, RisaValue* from, size_t size, RisaValue* to);
+
 void risa_vm_stack_reset(RisaVM* vm) {
-    for(size_t i = 0; i < sizeof(vm->stack) / sizeof(vm->stack[0]); ++i) {
+    for(size_t i = 0; i < vm->stackCapacity; ++i) {
         vm->stack[i] = risa_value_from_null();
     }
 
@@ -11,7 +16,75 @@ void risa_vm_stack_reset(RisaVM* vm) {
     vm->upvalues = NULL;
 }
 
+bool risa_vm_stack_ensure(RisaVM* vm, size_t size) {
+    if(size <= vm->stackCapacity)
+        return true;
+    if(size > vm->stackLimit)
+        return false;
+
+    size_t capacity = vm->stackCapacity;
+
+    while(capacity < size)
+        capacity *= 2;
+
+    if(capacity > vm->stackLimit)
+        capacity = vm->stackLimit;
+
+    RisaValue* stack = (RisaValue*) RISA_MEM_ALLOC(capacity * sizeof(RisaValue));
+
+    for(size_t i = 0; i < vm->stackCapacity; ++i)
+        stack[i] = vm->stack[i];
+    for(size_t i = vm->stackCapacity; i < capacity; ++i)
+        stack[i] = risa_value_from_null();
+
+    // Everything that points into the old stack is moved to the same offset in the new one.
+    for(uint32_t i = 0; i < vm->frameCount; ++i) {
+        vm->frames[i].base = stack + (vm->frames[i].base - vm->stack);
+        vm->frames[i].regs = stack + (vm->frames[i].regs - vm->stack);
+    }
+
+    for(RisaDenseUpvalue* upvalue = vm->upvalues; upvalue != NULL; upvalue = upvalue->next)
+        upvalue->ref = stack + (upvalue->ref - vm->stack);
+
+    // Closures with direct upvalues never leave the stack, so scanning it finds all of them.
+    for(size_t i = 0; i < vm->stackCapacity; ++i)
+        if(risa_value_is_dense_of_type(stack[i], RISA_DVAL_CLOSURE))
+            risa_vm_stack_rebase_cells((RisaDenseClosure*) risa_value_as_dense(stack[i]), vm->stack, vm->stackCapacity, stack);
+
+    vm->stackTop = stack + (vm->stackTop - vm->stack);
+
+    RISA_MEM_FREE(vm->stack);
+
+    vm->stack = stack;
+    vm->stackCapacity = (uint32_t) capacity;
+
+    return true;
+}
+
+bool risa_vm_frames_ensure(RisaVM* vm, uint32_t count) {
+    if(count <= vm->frameCapacity)
+        return true;
+    if(count > vm->frameLimit)
+        return false;
+
+    uint32_t capacity = vm->frameCapacity;
+
+    while(capacity < count)
+        capacity *= 2;
+
+    if(capacity > vm->frameLimit)
+        capacity = vm->frameLimit;
+
+    vm->frames = (RisaCallFrame*) RISA_MEM_REALLOC(vm->frames, capacity, sizeof(RisaCallFrame));
+    vm->frameCapacity = capacity;
+
+    return true;
+}
+
 void risa_vm_stack_push(RisaVM* vm, RisaValue value) {
+    if(!risa_vm_stack_ensure(vm, vm->stackTop - vm->stack + 1))
+        return;
+
     *vm->stackTop = value;
     ++vm->stackTop;
 }
@@ -24,3 +97,16 @@ RisaValue risa_vm_stack_pop(RisaVM* vm) {
 RisaValue risa_vm_stack_peek(RisaVM* vm, size_t range) {
     return *(vm->stackTop - range);
 }
+
+static void risa_vm_stack_rebase_cells(RisaDenseClosure* closure, RisaValue* from, size_t size, RisaValue* to) {
+    if(closure->cells == NULL)
+        return;
+
+    // The same closure can be found in several registers, so only refs that still point into the old stack are moved.
+    for(uint8_t i = 0; i < closure->upvalueCount; ++i) {
+        RisaDenseUpvalue* cell = &closure->cells[i];
+
+        if(risa_dense_closure_is_direct(closure, i) && cell->ref >= from && cell->ref < from + size)
+            cell->ref = to + (cell->ref - from);
+    }
+}
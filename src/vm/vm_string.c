@@ -1,16 +1,33 @@
 #include "vm.h"
 
+#include <string.h>
+
 RisaDenseString* risa_vm_string_create(RisaVM* vm, const char* str, uint32_t length) {
     RisaDenseString* string = risa_map_find(&vm->strings, str, length, risa_map_hash(str, length));
 
     if(string == NULL) {
-        string = risa_dense_string_from(str, length);
+        string = (RisaDenseString*) risa_vm_dense_alloc(vm, sizeof(RisaDenseString) + length + 1);
+
+        risa_dense_string_init(string, length);
+        memcpy(string->chars, str, length);
+        risa_dense_string_hash_inplace(string);
+
         risa_vm_register_string(vm, string);
     }
 
     return string;
 }
 
+RisaDenseString* risa_vm_string_concat(RisaVM* vm, RisaDenseString* left, RisaDenseString* right) {
+    uint32_t length = left->length + right->length;
+    RisaDenseString* string = (RisaDenseString*) risa_vm_dense_alloc(vm, sizeof(RisaDenseString) + length + 1);
+
+    risa_dense_string_init(string, length);
+    risa_dense_string_concat_into(string, left, right);
+
+    return risa_vm_string_internalize(vm, string);
+}
+
 RisaDenseString* risa_vm_string_internalize(RisaVM* vm, RisaDenseString* str) {
     RisaDenseString* string = risa_map_find(&vm->strings, str->chars, str->length, str->hash);
 
@@ -18,8 +35,8 @@ RisaDenseString* risa_vm_string_internalize(RisaVM* vm, RisaDenseString* str) {
         string = str;
         risa_vm_register_string(vm, string);
     } else {
-        risa_dense_delete((RisaDenseValue *) str);
+        risa_vm_dense_free(vm, (RisaDenseValue *) str);
     }
 
     return string;
-}
\ No newline at end of file
+}